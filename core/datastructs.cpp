@@ -78,6 +78,95 @@ static const schar icvPower2ShiftTab[] =
 *            Functions for manipulating memory storage - list of memory blocks           *
 \****************************************************************************************/
 
+/* The blocks of the released root storages are kept in a process-wide pool (up to
+   CV_MEM_BLOCK_POOL_MAX_SIZE bytes), so the storages created and released per call
+   do not go to the heap each time. The pool has a bucket per block size. */
+#define CV_MEM_BLOCK_POOL_BUCKETS   8
+#define CV_MEM_BLOCK_POOL_MAX_SIZE  (1 << 25)
+
+typedef struct CvMemBlockPoolBucket
+{
+    int block_size;
+    int count;
+    CvMemBlock* free_list;
+}
+CvMemBlockPoolBucket;
+
+static CvMemBlockPoolBucket icvMemBlockPool[CV_MEM_BLOCK_POOL_BUCKETS];
+static size_t icvMemBlockPoolSize = 0;
+
+#ifndef _TI66X
+static cv::Mutex& icvMemBlockPoolMutex()
+{
+    static cv::Mutex* mutex = new cv::Mutex;
+    return *mutex;
+}
+#endif
+
+static CvMemBlock*
+icvAllocMemBlock( int block_size )
+{
+    CvMemBlock* block = 0;
+    {
+#ifndef _TI66X
+        cv::AutoLock lock( icvMemBlockPoolMutex() );
+#endif
+        for( int i = 0; i < CV_MEM_BLOCK_POOL_BUCKETS; i++ )
+        {
+            CvMemBlockPoolBucket* bucket = &icvMemBlockPool[i];
+            if( bucket->block_size == block_size && bucket->free_list )
+            {
+                block = bucket->free_list;
+                bucket->free_list = block->next;
+                bucket->count--;
+                icvMemBlockPoolSize -= block_size;
+                break;
+            }
+        }
+    }
+
+    if( !block )
+        block = (CvMemBlock*)cvAlloc( block_size );
+    return block;
+}
+
+static void
+icvFreeMemBlock( CvMemBlock* block, int block_size )
+{
+    {
+#ifndef _TI66X
+        cv::AutoLock lock( icvMemBlockPoolMutex() );
+#endif
+        if( icvMemBlockPoolSize + block_size <= CV_MEM_BLOCK_POOL_MAX_SIZE )
+        {
+            CvMemBlockPoolBucket* bucket = 0;
+            for( int i = 0; i < CV_MEM_BLOCK_POOL_BUCKETS; i++ )
+            {
+                CvMemBlockPoolBucket* b = &icvMemBlockPool[i];
+                if( b->block_size == block_size )
+                {
+                    bucket = b;
+                    break;
+                }
+                if( !bucket && b->count == 0 )
+                    bucket = b;
+            }
+
+            if( bucket )
+            {
+                bucket->block_size = block_size;
+                block->next = bucket->free_list;
+                bucket->free_list = block;
+                bucket->count++;
+                icvMemBlockPoolSize += block_size;
+                return;
+            }
+        }
+    }
+
+    cvFree( &block );
+}
+
 /* Initialize allocated storage: */
 static void
 icvInitMemStorage( CvMemStorage* storage, int block_size )
@@ -160,7 +249,7 @@ icvDestroyMemStorage( CvMemStorage* storage )
         }
         else
         {
-            cvFree( &temp );
+            icvFreeMemBlock( temp, storage->block_size );
         }
     }
 
@@ -217,7 +306,7 @@ icvGoNextMemBlock( CvMemStorage * storage )
 
         if( !(storage->parent) )
         {
-            block = (CvMemBlock *)cvAlloc( storage->block_size );
+            block = icvAllocMemBlock( storage->block_size );
         }
         else
         {
@@ -312,6 +401,36 @@ cvRestoreMemStoragePos( CvMemStorage * storage, CvMemStoragePos * pos )
 }
 
 
+/* The storage owned by the calling thread, for temporary allocations: */
+#ifndef _TI66X
+struct CvThreadMemStorage
+{
+    CvThreadMemStorage() : storage(cvCreateMemStorage(0)) {}
+    ~CvThreadMemStorage() { cvReleaseMemStorage( &storage ); }
+    CvMemStorage* storage;
+};
+
+static cv::TLSData<CvThreadMemStorage>& icvThreadMemStorage()
+{
+    static cv::TLSData<CvThreadMemStorage>* data = new cv::TLSData<CvThreadMemStorage>;
+    return *data;
+}
+#endif
+
+CV_IMPL CvMemStorage*
+cvGetThreadMemStorage( void )
+{
+#ifndef _TI66X
+    return icvThreadMemStorage().get()->storage;
+#else
+    static CvMemStorage* storage = 0;
+    if( !storage )
+        storage = cvCreateMemStorage(0);
+    return storage;
+#endif
+}
+
+
 /* Allocate continuous buffer of the specified size in the storage: */
 CV_IMPL void*
 cvMemStorageAlloc( CvMemStorage* storage, size_t size )
@@ -4055,6 +4174,17 @@ void  seqInsertSlice( CvSeq* seq, int before_index, const CvArr* from_arr )
     cvSeqInsertSlice(seq, before_index, from_arr);
 }
 
+ThreadMemStorage::ThreadMemStorage()
+{
+    storage = cvGetThreadMemStorage();
+    cvSaveMemStoragePos(storage, &pos);
+}
+
+ThreadMemStorage::~ThreadMemStorage()
+{
+    cvRestoreMemStoragePos(storage, &pos);
+}
+
 }
 
 /* End of file. */
@@ -4057,7 +4057,9 @@ public:
         FORMAT_MASK=(7<<3),
         FORMAT_AUTO=0,
         FORMAT_XML=(1<<3),
-        FORMAT_YAML=(2<<3)
+        FORMAT_YAML=(2<<3),
+        FORMAT_BINARY=(3<<3), //! aligned binary records; matrices are read directly from the file mapping
+        BASE64=64 //! numeric arrays are written as base64 chunks in the text formats
     };
     enum
     {
@@ -4083,6 +4085,8 @@ public:
     CV_WRAP virtual void release();
     //! closes the file, releases all the memory buffers and returns the text string
     CV_WRAP string releaseAndGetString();
+    //! writes the buffered data to the file
+    CV_WRAP void flush();
 
     //! returns the first element of the top-level mapping
     CV_WRAP FileNode getFirstTopLevelNode() const;
@@ -4251,12 +4255,80 @@ public:
     size_t remaining;
 };
 
+/*!
+ File Node Handler
+
+ The interface for reading file storages as a stream of events (see cv::readFileStorage()).
+ Only the nodes on the path from the root to the current node are kept in memory,
+ so arbitrarily large storages can be processed.
+ */
+class CV_EXPORTS FileNodeHandler
+{
+public:
+    virtual ~FileNodeHandler();
+    //! called when a sequence or a mapping starts. If it returns false, the whole collection is read and passed to node().
+    //! By default only the registered types (matrices etc.) are read as a whole
+    virtual bool startCollection(const string& name, int type, const string& typeName);
+    //! called when the collection, for which startCollection() returned true, ends
+    virtual void endCollection();
+    //! called for each scalar and each collection read as a whole. The node is only valid within the call
+    virtual void node(const string& name, const FileNode& node);
+};
+
+/*!
+ Writes the events of the streaming reader to the file storage opened for writing.
+
+ The output is flushed after every node of the top flushLevel levels of the hierarchy
+ (the top-level mapping is level 0).
+ */
+class CV_EXPORTS FileNodeWriter : public FileNodeHandler
+{
+public:
+    FileNodeWriter(FileStorage& fs, int flushLevel=1);
+    virtual bool startCollection(const string& name, int type, const string& typeName);
+    virtual void endCollection();
+    virtual void node(const string& name, const FileNode& node);
+
+protected:
+    FileStorage* fs;
+    int level;
+    int flushLevel;
+    int nstreams;
+};
+
+//! reads the file storage passing the nodes to the handler as they are parsed
+CV_EXPORTS void readFileStorage(const string& source, FileNodeHandler& handler,
+                                int flags=FileStorage::READ);
+
 ////////////// convenient wrappers for operating old-style dynamic structures //////////////
 
 template<typename _Tp> class SeqIterator;
 
 typedef Ptr<CvMemStorage> MemStorage;
 
+/*!
+ Scoped use of the calling thread's memory storage (see cvGetThreadMemStorage).
+
+ Everything allocated from the storage while the object exists is released by the destructor,
+ while the memory blocks stay with the thread, so the per-call temporary sequences do not
+ touch the heap once the storage has grown to the working size.
+*/
+class CV_EXPORTS ThreadMemStorage
+{
+public:
+    ThreadMemStorage();
+    ~ThreadMemStorage();
+    operator CvMemStorage*() const { return storage; }
+
+protected:
+    CvMemStorage* storage;
+    CvMemStoragePos pos;
+
+private:
+    ThreadMemStorage(const ThreadMemStorage&);
+    ThreadMemStorage& operator = (const ThreadMemStorage&);
+};
+
 /*!
  Template Sequence Class derived from CvSeq
 
@@ -936,6 +936,10 @@ CVAPI(void)  cvReleaseMemStorage( CvMemStorage** storage );
    A child storage returns all the blocks to the parent when it is cleared */
 CVAPI(void)  cvClearMemStorage( CvMemStorage* storage );
 
+/* Returns the memory storage owned by the calling thread. It is meant for temporary data:
+   save the position before using it and restore the position afterwards */
+CVAPI(CvMemStorage*)  cvGetThreadMemStorage( void );
+
 /* Remember a storage "free memory" position */
 CVAPI(void)  cvSaveMemStoragePos( const CvMemStorage* storage, CvMemStoragePos* pos );
 
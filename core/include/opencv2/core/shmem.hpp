@@ -0,0 +1,152 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#ifndef __OPENCV_CORE_SHMEM_HPP__
+#define __OPENCV_CORE_SHMEM_HPP__
+
+#ifdef __cplusplus
+
+#include "opencv2/core/core.hpp"
+
+namespace cv
+{
+
+/*!
+   Mat allocator on top of a named POSIX shared memory segment.
+
+   The segment (created with shm_open/mmap) is split into a fixed number of equally sized
+   frame slots. Every slot starts with a header block that holds the matrix reference counter
+   and geometry; the counter is the one Mat::refcount points to, so Mat copies made in any
+   process that maps the segment update the same counter, and the slot becomes free again
+   once the last header in the last process is released.
+
+   One process creates the segment, the others open it by name. The mapping lives as long
+   as the allocator object, so all the matrices allocated from it or attached to it must be
+   released before the allocator is destroyed. The creator unlinks the segment on destruction.
+*/
+class CV_EXPORTS SharedMatAllocator : public MatAllocator
+{
+public:
+    enum { MAX_CONSUMERS = 16 };
+
+    //! the default constructor; use create() or open() afterwards
+    SharedMatAllocator();
+    //! creates a new segment with nslots frames of up to slotSize bytes each
+    SharedMatAllocator(const string& name, int nslots, size_t slotSize, int nconsumers=1);
+    //! maps a segment previously created by another process
+    explicit SharedMatAllocator(const string& name);
+    virtual ~SharedMatAllocator();
+
+    //! creates a new segment, see the constructor description
+    void create(const string& name, int nslots, size_t slotSize, int nconsumers=1);
+    //! maps an existing segment
+    void open(const string& name);
+    //! unmaps the segment; unlinks it if it was created by this object
+    void close();
+    bool isOpened() const;
+
+    //! the number of frame slots
+    int slots() const;
+    //! the maximum frame size in bytes
+    size_t slotSize() const;
+    //! the number of consumers the frame ring was created for
+    int consumers() const;
+
+    //! returns the slot index of the matrix data or -1 if it does not belong to the segment
+    int slotIndex(const Mat& m) const;
+    //! makes a new matrix header for the frame stored in the slot (the reference counter is incremented)
+    Mat attach(int slot);
+
+    virtual void allocate(int dims, const int* sizes, int type, int*& refcount,
+                          uchar*& datastart, uchar*& data, size_t* step);
+    virtual void deallocate(int* refcount, uchar* datastart, uchar* data);
+
+private:
+    friend class SharedFrameRing;
+    struct Impl;
+    Impl* impl;
+
+    SharedMatAllocator(const SharedMatAllocator&);
+    SharedMatAllocator& operator = (const SharedMatAllocator&);
+};
+
+/*!
+   Lock-free single-producer/multi-consumer ring of frames stored in a SharedMatAllocator segment.
+
+   The producer allocates a frame from the allocator (by setting Mat::allocator before create()),
+   fills it and publishes it with push(). Every consumer (identified by an index in
+   [0, consumers()) that the processes agree on) receives every published frame through pop()
+   as a matrix header sharing the slot data, so no pixel is copied. The slot is recycled
+   after the producer and all the consumers have released their headers.
+
+   The ring state lives in the segment, so any number of SharedFrameRing objects in different
+   processes can be constructed on top of allocators mapping the same segment. Only one of them
+   may call push().
+*/
+class CV_EXPORTS SharedFrameRing
+{
+public:
+    SharedFrameRing();
+    explicit SharedFrameRing(const Ptr<SharedMatAllocator>& allocator);
+
+    //! the allocator the frames must be created with
+    Ptr<SharedMatAllocator> allocator() const;
+
+    //! allocates a new frame in the segment
+    void createFrame(int rows, int cols, int type, Mat& frame) const;
+    //! publishes the frame to all the consumers; returns false if the slowest consumer is a full ring behind
+    bool push(const Mat& frame);
+    //! retrieves the next frame for the consumer; returns false if there is no new frame
+    bool pop(int consumer, Mat& frame);
+    //! the number of frames published, but not yet retrieved by the consumer
+    int pending(int consumer) const;
+
+protected:
+    Ptr<SharedMatAllocator> alloc;
+};
+
+}
+
+#endif // __cplusplus
+
+#endif // __OPENCV_CORE_SHMEM_HPP__
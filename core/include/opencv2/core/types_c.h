@@ -1764,6 +1764,8 @@ typedef struct CvFileStorage CvFileStorage;
 #define CV_STORAGE_FORMAT_AUTO   0
 #define CV_STORAGE_FORMAT_XML    8
 #define CV_STORAGE_FORMAT_YAML  16
+#define CV_STORAGE_FORMAT_BINARY 24
+#define CV_STORAGE_BASE64       64
 
 /* List of attributes: */
 typedef struct CvAttrList
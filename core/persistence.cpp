@@ -73,6 +73,14 @@
 #  include <zlib.h>
 #endif
 
+#if !defined _TI66X && (defined __linux__ || defined __APPLE__)
+#  define HAVE_MMAP 1
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 /****************************************************************************************\
 *                            Common macros and type definitions                          *
 \****************************************************************************************/
@@ -277,10 +285,25 @@ typedef struct CvFileStorage
     size_t strbufsize, strbufpos;
     std::deque<char>* outbuf;
 
+    size_t bin_pos;
+    struct CvFSMapping* mapping;
+    int base64;
+
+    cv::FileNodeHandler* handler;
+    CvSeq* stream_stack;
+    const CvStringHashNode* stream_key;
+    CvTypeInfo* stream_info;
+
     bool is_opened;
 }
 CvFileStorage;
 
+static void icvFSReleaseMapping( struct CvFSMapping** pm );
+static void icvBinPushRawData( CvSeq* seq, const char* dt, const uchar* data, size_t size );
+static void icvCalcRawLayout( const int* fmt_pairs, int fmt_pair_count, int* stride, int* extent, int* comps );
+static int icvDecodeFormat( const char* dt, int* fmt_pairs, int max_len );
+static void icvFSExpandRawSeq( const CvFileNode* node );
+
 static void icvPuts( CvFileStorage* fs, const char* str )
 {
     if( fs->outbuf )
@@ -370,6 +393,7 @@ static void icvRewind( CvFileStorage* fs )
 #define CV_XML_INDENT  2
 #define CV_YML_INDENT_FLOW  1
 #define CV_FS_MAX_LEN 4096
+#define CV_FS_MAX_FMT_PAIRS  128
 
 #define CV_FILE_STORAGE ('Y' + ('A' << 8) + ('M' << 16) + ('L' << 24))
 #define CV_IS_FILE_STORAGE(fs) ((fs) != 0 && (fs)->flags == CV_FILE_STORAGE)
@@ -439,6 +463,159 @@ icvParseError( CvFileStorage* fs, const char* func_name,
 }
 
 
+/*
+   Streaming mode (fs->handler != 0). Every element of a streamed collection is registered
+   in fs->stream_stack when its parsing starts and is removed from the parent collection
+   as soon as it is passed to the handler, and the memory storage is rolled back to the state
+   it had before the element. So only the path from the root to the current element is kept
+   in memory. The collections the handler wants to get as a whole are parsed as usual
+   and passed to the handler once they are complete.
+*/
+typedef struct CvFSStreamRecord
+{
+    CvFileNode* elem;
+    CvMemStoragePos pos;
+    int state; // 0 - not a collection yet, 1 - streamed collection, 2 - collection read as a whole
+}
+CvFSStreamRecord;
+
+static void
+icvFSRemoveLastElem( CvFileStorage* fs, CvFileNode* collection, CvFileNode* elem )
+{
+    if( !collection )
+        cvSeqPop( fs->roots, 0 );
+    else if( CV_NODE_IS_MAP(collection->tag) )
+    {
+        CvFileNodeHash* map = collection->data.map;
+        CvFileMapNode* node = (CvFileMapNode*)elem;
+        int i, tab_size = map->tab_size;
+
+        if( (tab_size & (tab_size - 1)) == 0 )
+            i = (int)(node->key->hashval & (tab_size - 1));
+        else
+            i = (int)(node->key->hashval % tab_size);
+
+        // the element was added last, so it is the head of its hash chain
+        assert( map->table[i] == node );
+        map->table[i] = node->next;
+        cvSetRemoveByPtr( (CvSet*)map, node );
+    }
+    else
+        cvSeqPop( collection->data.seq, 0 );
+}
+
+/* called when the element of the collection is about to be parsed */
+static void
+icvFSStreamStart( CvFileStorage* fs, CvFileNode* elem, const CvStringHashNode* key,
+                  CvTypeInfo* info CV_DEFAULT(0), const CvMemStoragePos* pos CV_DEFAULT(0) )
+{
+    if( !fs->handler )
+        return;
+
+    CvSeq* stack = fs->stream_stack;
+    if( stack->total > 0 && ((CvFSStreamRecord*)cvGetSeqElem( stack, -1 ))->state != 1 )
+        return;
+
+    CvFSStreamRecord* rec = (CvFSStreamRecord*)cvSeqPush( stack, 0 );
+    rec->elem = elem;
+    rec->state = 0;
+    if( pos )
+        rec->pos = *pos;
+    else
+        cvSaveMemStoragePos( fs->memstorage, &rec->pos );
+    fs->stream_key = key;
+    fs->stream_info = info;
+}
+
+/* called when the element parsing is finished */
+static void
+icvFSStreamEnd( CvFileStorage* fs, CvFileNode* collection, CvFileNode* elem )
+{
+    if( !fs->handler )
+        return;
+
+    CvSeq* stack = fs->stream_stack;
+    CvFSStreamRecord rec;
+    if( stack->total == 0 || ((CvFSStreamRecord*)cvGetSeqElem( stack, -1 ))->elem != elem )
+        return;
+    cvSeqPop( stack, &rec );
+
+    if( rec.state == 1 )
+        fs->handler->endCollection();
+    else if( collection || CV_NODE_TYPE(elem->tag) != CV_NODE_NONE )
+    {
+        const char* name = collection && CV_NODE_IS_MAP(collection->tag) ?
+            ((CvFileMapNode*)elem)->key->str.ptr : "";
+        fs->handler->node( name, cv::FileNode(fs, elem) );
+    }
+
+    icvFSRemoveLastElem( fs, collection, elem );
+    cvRestoreMemStoragePos( fs->memstorage, &rec.pos );
+}
+
+/* called when the element being streamed turns out to be a collection */
+static void
+icvFSStreamCollection( CvFileStorage* fs, CvFileNode* collection )
+{
+    CvSeq* stack = fs->stream_stack;
+    CvFSStreamRecord* rec;
+    if( stack->total == 0 ||
+        (rec = (CvFSStreamRecord*)cvGetSeqElem( stack, -1 ))->elem != collection || rec->state != 0 )
+        return;
+
+    CvTypeInfo* info = collection->info ? collection->info : fs->stream_info;
+    const char* name = fs->stream_key ? fs->stream_key->str.ptr : "";
+    bool streamed = fs->handler->startCollection( name, CV_NODE_TYPE(collection->tag),
+                                                  info ? info->type_name : "" );
+    rec->state = streamed ? 1 : 2;
+    if( !streamed )
+        return;
+
+    // in XML the scalar read before the collection type was known becomes its first element
+    if( CV_NODE_IS_SEQ(collection->tag) && collection->data.seq->total > 0 )
+        fs->handler->node( "", cv::FileNode(fs, (CvFileNode*)cvGetSeqElem( collection->data.seq, 0 )) );
+
+    // allocate the collection storage now, so the elements can be rolled back individually
+    if( CV_NODE_IS_MAP(collection->tag) )
+        cvSetRemoveByPtr( (CvSet*)collection->data.map, cvSetNew( (CvSet*)collection->data.map ) );
+    else
+    {
+        if( collection->data.seq->total == 0 )
+            cvSeqPush( collection->data.seq, 0 );
+        cvSeqPop( collection->data.seq, 0 );
+    }
+}
+
+/* passes the already parsed tree to the handler (used for the binary storages) */
+static void
+icvFSStreamTree( CvFileStorage* fs, const char* name, CvFileNode* node )
+{
+    if( !CV_NODE_IS_COLLECTION(node->tag) ||
+        !fs->handler->startCollection( name, CV_NODE_TYPE(node->tag),
+                                       node->info ? node->info->type_name : "" ) )
+    {
+        fs->handler->node( name, cv::FileNode(fs, node) );
+        return;
+    }
+
+    int i, total = node->data.seq->total;
+    int elem_size = node->data.seq->elem_size;
+    int is_map = CV_NODE_IS_MAP(node->tag);
+    CvSeqReader reader;
+
+    icvFSExpandRawSeq( node );
+    cvStartReadSeq( node->data.seq, &reader, 0 );
+    for( i = 0; i < total; i++ )
+    {
+        CvFileMapNode* elem = (CvFileMapNode*)reader.ptr;
+        if( !is_map || CV_IS_SET_ELEM(elem) )
+            icvFSStreamTree( fs, is_map ? elem->key->str.ptr : "", &elem->value );
+        CV_NEXT_SEQ_ELEM( elem_size, reader );
+    }
+    fs->handler->endCollection();
+}
+
+
 static void
 icvFSCreateCollection( CvFileStorage* fs, int tag, CvFileNode* collection )
 {
@@ -467,6 +644,9 @@ icvFSCreateCollection( CvFileStorage* fs, int tag, CvFileNode* collection )
 
     collection->tag = tag;
     cvSetSeqBlockSize( collection->data.seq, 8 );
+
+    if( fs->handler )
+        icvFSStreamCollection( fs, collection );
 }
 
 
@@ -572,7 +752,8 @@ icvClose( CvFileStorage* fs, std::string* out )
                 while( fs->write_stack->total > 0 )
                     cvEndWriteStruct(fs);
             }
-            icvFSFlush(fs);
+            if( fs->fmt != CV_STORAGE_FORMAT_BINARY )
+                icvFSFlush(fs);
             if( fs->fmt == CV_STORAGE_FORMAT_XML )
                 icvPuts( fs, "</opencv_storage>\n" );
         }
@@ -605,6 +786,7 @@ cvReleaseFileStorage( CvFileStorage** p_fs )
         cvReleaseMemStorage( &fs->strstorage );
         cvFree( &fs->buffer_start );
         cvReleaseMemStorage( &fs->memstorage );
+        icvFSReleaseMapping( &fs->mapping );
 
         if( fs->outbuf )
             delete fs->outbuf;
@@ -859,6 +1041,238 @@ cvGetFileNodeFromSeq( CvFileStorage* fs,
 }*/
 
 
+/*
+   Shortest round-trip formatting of the floating-point numbers (Grisu2 algorithm by F. Loitsch,
+   "Printing Floating-Point Numbers Quickly and Accurately with Integers").
+   The produced digits are always read back to the same value, and in the vast majority of cases
+   there is no shorter representation.
+*/
+typedef struct CvDiyFp
+{
+    uint64 f;
+    int e;
+}
+CvDiyFp;
+
+static inline CvDiyFp icvDiyFp( uint64 f, int e )
+{
+    CvDiyFp r;
+    r.f = f;
+    r.e = e;
+    return r;
+}
+
+static inline CvDiyFp icvDiyFpMul( CvDiyFp x, CvDiyFp y )
+{
+    const uint64 M32 = 0xFFFFFFFF;
+    uint64 a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64 ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+    uint64 tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1U << 31);
+    return icvDiyFp( ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 );
+}
+
+static inline CvDiyFp icvDiyFpNormalize( CvDiyFp x )
+{
+    while( !(x.f & CV_BIG_UINT(0x8000000000000000)) )
+    {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/* normalized 10^k for k = -348, -340, ..., 340 */
+static const uint64 icvCachedPowersF[] =
+{
+    CV_BIG_UINT(0xfa8fd5a0081c0288), CV_BIG_UINT(0xbaaee17fa23ebf76),
+    CV_BIG_UINT(0x8b16fb203055ac76), CV_BIG_UINT(0xcf42894a5dce35ea),
+    CV_BIG_UINT(0x9a6bb0aa55653b2d), CV_BIG_UINT(0xe61acf033d1a45df),
+    CV_BIG_UINT(0xab70fe17c79ac6ca), CV_BIG_UINT(0xff77b1fcbebcdc4f),
+    CV_BIG_UINT(0xbe5691ef416bd60c), CV_BIG_UINT(0x8dd01fad907ffc3c),
+    CV_BIG_UINT(0xd3515c2831559a83), CV_BIG_UINT(0x9d71ac8fada6c9b5),
+    CV_BIG_UINT(0xea9c227723ee8bcb), CV_BIG_UINT(0xaecc49914078536d),
+    CV_BIG_UINT(0x823c12795db6ce57), CV_BIG_UINT(0xc21094364dfb5637),
+    CV_BIG_UINT(0x9096ea6f3848984f), CV_BIG_UINT(0xd77485cb25823ac7),
+    CV_BIG_UINT(0xa086cfcd97bf97f4), CV_BIG_UINT(0xef340a98172aace5),
+    CV_BIG_UINT(0xb23867fb2a35b28e), CV_BIG_UINT(0x84c8d4dfd2c63f3b),
+    CV_BIG_UINT(0xc5dd44271ad3cdba), CV_BIG_UINT(0x936b9fcebb25c996),
+    CV_BIG_UINT(0xdbac6c247d62a584), CV_BIG_UINT(0xa3ab66580d5fdaf6),
+    CV_BIG_UINT(0xf3e2f893dec3f126), CV_BIG_UINT(0xb5b5ada8aaff80b8),
+    CV_BIG_UINT(0x87625f056c7c4a8b), CV_BIG_UINT(0xc9bcff6034c13053),
+    CV_BIG_UINT(0x964e858c91ba2655), CV_BIG_UINT(0xdff9772470297ebd),
+    CV_BIG_UINT(0xa6dfbd9fb8e5b88f), CV_BIG_UINT(0xf8a95fcf88747d94),
+    CV_BIG_UINT(0xb94470938fa89bcf), CV_BIG_UINT(0x8a08f0f8bf0f156b),
+    CV_BIG_UINT(0xcdb02555653131b6), CV_BIG_UINT(0x993fe2c6d07b7fac),
+    CV_BIG_UINT(0xe45c10c42a2b3b06), CV_BIG_UINT(0xaa242499697392d3),
+    CV_BIG_UINT(0xfd87b5f28300ca0e), CV_BIG_UINT(0xbce5086492111aeb),
+    CV_BIG_UINT(0x8cbccc096f5088cc), CV_BIG_UINT(0xd1b71758e219652c),
+    CV_BIG_UINT(0x9c40000000000000), CV_BIG_UINT(0xe8d4a51000000000),
+    CV_BIG_UINT(0xad78ebc5ac620000), CV_BIG_UINT(0x813f3978f8940984),
+    CV_BIG_UINT(0xc097ce7bc90715b3), CV_BIG_UINT(0x8f7e32ce7bea5c70),
+    CV_BIG_UINT(0xd5d238a4abe98068), CV_BIG_UINT(0x9f4f2726179a2245),
+    CV_BIG_UINT(0xed63a231d4c4fb27), CV_BIG_UINT(0xb0de65388cc8ada8),
+    CV_BIG_UINT(0x83c7088e1aab65db), CV_BIG_UINT(0xc45d1df942711d9a),
+    CV_BIG_UINT(0x924d692ca61be758), CV_BIG_UINT(0xda01ee641a708dea),
+    CV_BIG_UINT(0xa26da3999aef774a), CV_BIG_UINT(0xf209787bb47d6b85),
+    CV_BIG_UINT(0xb454e4a179dd1877), CV_BIG_UINT(0x865b86925b9bc5c2),
+    CV_BIG_UINT(0xc83553c5c8965d3d), CV_BIG_UINT(0x952ab45cfa97a0b3),
+    CV_BIG_UINT(0xde469fbd99a05fe3), CV_BIG_UINT(0xa59bc234db398c25),
+    CV_BIG_UINT(0xf6c69a72a3989f5c), CV_BIG_UINT(0xb7dcbf5354e9bece),
+    CV_BIG_UINT(0x88fcf317f22241e2), CV_BIG_UINT(0xcc20ce9bd35c78a5),
+    CV_BIG_UINT(0x98165af37b2153df), CV_BIG_UINT(0xe2a0b5dc971f303a),
+    CV_BIG_UINT(0xa8d9d1535ce3b396), CV_BIG_UINT(0xfb9b7cd9a4a7443c),
+    CV_BIG_UINT(0xbb764c4ca7a44410), CV_BIG_UINT(0x8bab8eefb6409c1a),
+    CV_BIG_UINT(0xd01fef10a657842c), CV_BIG_UINT(0x9b10a4e5e9913129),
+    CV_BIG_UINT(0xe7109bfba19c0c9d), CV_BIG_UINT(0xac2820d9623bf429),
+    CV_BIG_UINT(0x80444b5e7aa7cf85), CV_BIG_UINT(0xbf21e44003acdd2d),
+    CV_BIG_UINT(0x8e679c2f5e44ff8f), CV_BIG_UINT(0xd433179d9c8cb841),
+    CV_BIG_UINT(0x9e19db92b4e31ba9), CV_BIG_UINT(0xeb96bf6ebadf77d9),
+    CV_BIG_UINT(0xaf87023b9bf0ee6b)
+};
+
+static const short icvCachedPowersE[] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901,
+    -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502,
+    -475, -449, -422, -396, -369, -343, -316, -289, -263, -236, -210, -183, -157, -130, -103,
+    -77, -50, -24, 3, 30, 56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402,
+    428, 455, 481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static void
+icvGrisuRound( char* buffer, int len, uint64 delta, uint64 rest, uint64 ten_kappa, uint64 wp_w )
+{
+    while( rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w) )
+    {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void
+icvGrisuDigitGen( CvDiyFp W, CvDiyFp Mp, uint64 delta, char* buffer, int* len, int* K )
+{
+    static const unsigned pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000,
+                                      10000000, 100000000, 1000000000 };
+    const CvDiyFp one = icvDiyFp( (uint64)1 << -Mp.e, Mp.e );
+    const uint64 wp_w = Mp.f - W.f;
+    unsigned p1 = (unsigned)(Mp.f >> -one.e);
+    uint64 p2 = Mp.f & (one.f - 1);
+    int kappa = 10;
+
+    while( kappa > 1 && p1 < pow10[kappa-1] )
+        kappa--;
+
+    *len = 0;
+    while( kappa > 0 )
+    {
+        unsigned d = p1 / pow10[kappa-1];
+        p1 %= pow10[kappa-1];
+        if( d || *len )
+            buffer[(*len)++] = (char)('0' + d);
+        kappa--;
+        uint64 tmp = ((uint64)p1 << -one.e) + p2;
+        if( tmp <= delta )
+        {
+            *K += kappa;
+            icvGrisuRound( buffer, *len, delta, tmp, (uint64)pow10[kappa] << -one.e, wp_w );
+            return;
+        }
+    }
+
+    for(;;)
+    {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if( d || *len )
+            buffer[(*len)++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if( p2 < delta )
+        {
+            *K += kappa;
+            int index = -kappa;
+            icvGrisuRound( buffer, *len, delta, p2, one.f, wp_w*(index < 9 ? pow10[index] : 0) );
+            return;
+        }
+    }
+}
+
+/* produces the shortest digits of the positive number f*2^e, whose significand has
+   the hidden bit "hidden", so that the number is equal to digits*10^K */
+static void
+icvGrisu2( uint64 f, int e, uint64 hidden, char* buffer, int* len, int* K )
+{
+    CvDiyFp plus = icvDiyFpNormalize( icvDiyFp( (f << 1) + 1, e - 1 ));
+    CvDiyFp minus = f == hidden ? icvDiyFp( (f << 2) - 1, e - 2 ) : icvDiyFp( (f << 1) - 1, e - 1 );
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    double dk = (-61 - plus.e)*0.30102999566398114 + 347;
+    int k = (int)dk;
+    if( dk - k > 0.0 )
+        k++;
+    int index = (k >> 3) + 1;
+    CvDiyFp c_mk = icvDiyFp( icvCachedPowersF[index], icvCachedPowersE[index] );
+    *K = -(-348 + index*8);
+
+    CvDiyFp W = icvDiyFpMul( icvDiyFpNormalize( icvDiyFp( f, e )), c_mk );
+    CvDiyFp Wp = icvDiyFpMul( plus, c_mk ), Wm = icvDiyFpMul( minus, c_mk );
+    Wm.f++;
+    Wp.f--;
+    icvGrisuDigitGen( W, Wp, Wp.f - Wm.f, buffer, len, K );
+}
+
+/* writes the number digits*10^K, using the exponential form only for very large or small numbers */
+static char*
+icvFormatDigits( char* buf, int is_neg, const char* digits, int len, int K )
+{
+    char* ptr = buf;
+    int i, kk = len + K; // the position of the decimal point
+
+    if( is_neg )
+        *ptr++ = '-';
+
+    if( 0 < kk && kk <= 17 )
+    {
+        for( i = 0; i < kk; i++ )
+            *ptr++ = i < len ? digits[i] : '0';
+        *ptr++ = '.';
+        for( ; i < len; i++ )
+            *ptr++ = digits[i];
+    }
+    else if( -5 < kk && kk <= 0 )
+    {
+        *ptr++ = '0';
+        *ptr++ = '.';
+        for( i = kk; i < 0; i++ )
+            *ptr++ = '0';
+        for( i = 0; i < len; i++ )
+            *ptr++ = digits[i];
+    }
+    else
+    {
+        int exp10 = kk - 1;
+        *ptr++ = digits[0];
+        *ptr++ = '.';
+        for( i = 1; i < len; i++ )
+            *ptr++ = digits[i];
+        *ptr++ = 'e';
+        *ptr++ = exp10 < 0 ? '-' : '+';
+        exp10 = std::abs(exp10);
+        if( exp10 >= 100 )
+            *ptr++ = (char)('0' + exp10/100);
+        *ptr++ = (char)('0' + exp10/10%10);
+        *ptr++ = (char)('0' + exp10%10);
+    }
+    *ptr = '\0';
+    return buf;
+}
+
+
 static char*
 icvDoubleToString( char* buf, double value )
 {
@@ -872,18 +1286,22 @@ icvDoubleToString( char* buf, double value )
     {
         int ivalue = cvRound(value);
         if( ivalue == value )
-            sprintf( buf, "%d.", ivalue );
+        {
+            strcpy( buf, icv_itoa( ivalue, buf + 24, 10 ));
+            strcat( buf, "." );
+        }
         else
         {
-            static const char* fmt = "%.16e";
-            char* ptr = buf;
-            sprintf( buf, fmt, value );
-            if( *ptr == '+' || *ptr == '-' )
-                ptr++;
-            for( ; cv_isdigit(*ptr); ptr++ )
-                ;
-            if( *ptr == ',' )
-                *ptr = '.';
+            uint64 f = val.u & ((CV_BIG_UINT(1) << 52) - 1), hidden = CV_BIG_UINT(1) << 52;
+            int e = (int)(ieee754_hi >> 20) & 0x7ff;
+            char digits[32];
+            int len, K;
+            if( e != 0 )
+                f += hidden, e -= 1075;
+            else
+                e = -1074;
+            icvGrisu2( f, e, hidden, digits, &len, &K );
+            icvFormatDigits( buf, value < 0, digits, len, K );
         }
     }
     else
@@ -911,18 +1329,22 @@ icvFloatToString( char* buf, float value )
     {
         int ivalue = cvRound(value);
         if( ivalue == value )
-            sprintf( buf, "%d.", ivalue );
+        {
+            strcpy( buf, icv_itoa( ivalue, buf + 24, 10 ));
+            strcat( buf, "." );
+        }
         else
         {
-            static const char* fmt = "%.8e";
-            char* ptr = buf;
-            sprintf( buf, fmt, value );
-            if( *ptr == '+' || *ptr == '-' )
-                ptr++;
-            for( ; cv_isdigit(*ptr); ptr++ )
-                ;
-            if( *ptr == ',' )
-                *ptr = '.';
+            uint64 f = ieee754 & ((1 << 23) - 1), hidden = 1 << 23;
+            int e = (int)(ieee754 >> 23) & 0xff;
+            char digits[32];
+            int len, K;
+            if( e != 0 )
+                f += hidden, e -= 150;
+            else
+                e = -149;
+            icvGrisu2( f, e, hidden, digits, &len, &K );
+            icvFormatDigits( buf, value < 0, digits, len, K );
         }
     }
     else
@@ -966,9 +1388,77 @@ icvProcessSpecialDouble( CvFileStorage* fs, char* buf, double* value, char** end
 }
 
 
+/* parses the decimal number that can be converted exactly with a single multiplication or division
+   (at most 19 significant digits and the power of ten within [-22,22]); returns false otherwise */
+static bool icvFastStrtod( const char* ptr, double* value, char** endptr )
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* p = ptr;
+    uint64 m = 0;
+    int ndigits = 0, exp10 = 0, is_neg = 0;
+
+    if( *p == '-' || *p == '+' )
+        is_neg = *p++ == '-';
+    for( ; cv_isdigit(*p); p++, ndigits++ )
+        m = m*10 + (*p - '0');
+    if( *p == '.' )
+        for( p++; cv_isdigit(*p); p++, ndigits++, exp10-- )
+            m = m*10 + (*p - '0');
+    if( ndigits == 0 || ndigits > 19 )
+        return false;
+    if( *p == 'e' || *p == 'E' )
+    {
+        int e = 0, is_neg_e = 0;
+        p++;
+        if( *p == '-' || *p == '+' )
+            is_neg_e = *p++ == '-';
+        if( !cv_isdigit(*p) )
+            return false;
+        for( ; cv_isdigit(*p) && e < 1000; p++ )
+            e = e*10 + (*p - '0');
+        exp10 += is_neg_e ? -e : e;
+    }
+    if( cv_isalnum(*p) || m > (CV_BIG_UINT(1) << 53) || exp10 < -22 || exp10 > 22 )
+        return false;
+
+    double v = (double)(int64)m;
+    v = exp10 >= 0 ? v*pow10[exp10] : v/pow10[-exp10];
+    *value = is_neg ? -v : v;
+    *endptr = (char*)p;
+    return true;
+}
+
+/* strtol( ptr, endptr, 0 ) with the fast path for the short decimal numbers */
+static int icv_strtol( char* ptr, char** endptr )
+{
+    const char* p = ptr;
+    int is_neg = 0;
+
+    if( *p == '-' || *p == '+' )
+        is_neg = *p++ == '-';
+    // hexadecimal and octal numbers start with 0
+    if( cv_isdigit(*p) && (*p != '0' || !cv_isalnum(p[1])) )
+    {
+        int val = 0, i;
+        for( i = 0; i < 9 && cv_isdigit(*p); i++, p++ )
+            val = val*10 + (*p - '0');
+        if( !cv_isdigit(*p) )
+        {
+            *endptr = (char*)p;
+            return is_neg ? -val : val;
+        }
+    }
+    return (int)strtol( ptr, endptr, 0 );
+}
+
 static double icv_strtod( CvFileStorage* fs, char* ptr, char** endptr )
 {
-    double fval = strtod( ptr, endptr );
+    double fval;
+    if( icvFastStrtod( ptr, &fval, endptr ) )
+        return fval;
+
+    fval = strtod( ptr, endptr );
     if( **endptr == '.' )
     {
         char* dot_pos = *endptr;
@@ -988,6 +1478,198 @@ static double icv_strtod( CvFileStorage* fs, char* ptr, char** endptr )
 }
 
 
+/* bulk path for the numeric arrays: parses the numbers separated by spaces and, optionally,
+   the delimiter, until the end of the line or the first token that is not a plain number.
+   Returns the pointer right after the last parsed number */
+static char*
+icvFSParseNumbers( CvFileStorage* fs, char* ptr, CvSeq* seq, char delim, int* count )
+{
+    const int BUFSZ = 256;
+    CvFileNode buf[BUFSZ];
+    int n = 0, total = 0;
+
+    for(;;)
+    {
+        char* p = ptr;
+        if( total + n > 0 )
+        {
+            while( *p == ' ' )
+                p++;
+            if( delim )
+            {
+                if( *p != delim )
+                    break;
+                for( p++; *p == ' '; p++ )
+                    ;
+            }
+            else if( p == ptr )
+                break;
+        }
+
+        char c = p[0], d = p[1], *endptr = p;
+        if( c == '-' || c == '+' )
+            c = d, d = p[2];
+        if( !cv_isdigit(c) && !(c == '.' && cv_isdigit(d)) )
+            break;
+
+        CvFileNode* node = &buf[n];
+        for( endptr += p[0] == '-' || p[0] == '+'; cv_isdigit(*endptr); endptr++ )
+            ;
+        if( *endptr == '.' || *endptr == 'e' )
+        {
+            node->tag = CV_NODE_REAL;
+            node->data.f = icv_strtod( fs, p, &endptr );
+        }
+        else
+        {
+            node->tag = CV_NODE_INT;
+            node->data.i = icv_strtol( p, &endptr );
+        }
+        node->info = 0;
+
+        // let the generic parser deal with anything unusual
+        c = *endptr;
+        if( endptr == p || !(c == ' ' || c == delim || c == '\0' || c == '\n' || c == '\r' ||
+                             c == ']' || c == '<' || c == '#') )
+            break;
+
+        ptr = endptr;
+        if( ++n == BUFSZ )
+        {
+            cvSeqPushMulti( seq, buf, n );
+            total += n;
+            n = 0;
+        }
+    }
+
+    if( n > 0 )
+        cvSeqPushMulti( seq, buf, n );
+    *count = total + n;
+    return ptr;
+}
+
+
+
+/* base64-encoded raw data: the numeric arrays written with CV_STORAGE_BASE64 are stored as
+   a sequence of "$base64$<dt>$<payload>" strings, each holding an integer number of records */
+static const char icvBase64Prefix[] = "$base64$";
+static const char icvBase64Table[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int
+icvBase64Encode( const uchar* src, int len, char* dst )
+{
+    char* d = dst;
+    int i = 0;
+    for( ; i + 3 <= len; i += 3, d += 4 )
+    {
+        unsigned v = (src[i] << 16) | (src[i+1] << 8) | src[i+2];
+        d[0] = icvBase64Table[v >> 18];
+        d[1] = icvBase64Table[(v >> 12) & 63];
+        d[2] = icvBase64Table[(v >> 6) & 63];
+        d[3] = icvBase64Table[v & 63];
+    }
+    if( i < len )
+    {
+        unsigned v = (src[i] << 16) | (i + 1 < len ? src[i+1] << 8 : 0);
+        d[0] = icvBase64Table[v >> 18];
+        d[1] = icvBase64Table[(v >> 12) & 63];
+        d[2] = i + 1 < len ? icvBase64Table[(v >> 6) & 63] : '=';
+        d[3] = '=';
+        d += 4;
+    }
+    *d = '\0';
+    return (int)(d - dst);
+}
+
+/* returns the number of decoded bytes or -1 if the input is not valid base64 */
+static int
+icvBase64Decode( const char* src, int len, uchar* dst )
+{
+    static schar tab[256];
+    static volatile bool initialized = false;
+    if( !initialized )
+    {
+        memset( tab, -1, sizeof(tab) );
+        for( int k = 0; k < 64; k++ )
+            tab[(uchar)icvBase64Table[k]] = (schar)k;
+        initialized = true;
+    }
+
+    if( len % 4 != 0 )
+        return -1;
+    int pad = len > 0 && src[len-1] == '=' ? (len > 1 && src[len-2] == '=' ? 2 : 1) : 0;
+    uchar* d = dst;
+    for( int i = 0; i < len; i += 4 )
+    {
+        int a = tab[(uchar)src[i]], b = tab[(uchar)src[i+1]];
+        int c = tab[(uchar)src[i+2]], e = tab[(uchar)src[i+3]];
+        if( i + 4 == len && pad > 0 )
+        {
+            e = 0;
+            if( pad == 2 )
+                c = 0;
+        }
+        if( (a | b | c | e) < 0 )
+            return -1;
+        unsigned v = (a << 18) | (b << 12) | (c << 6) | e;
+        *d++ = (uchar)(v >> 16);
+        *d++ = (uchar)(v >> 8);
+        *d++ = (uchar)v;
+    }
+    return (int)(d - dst) - pad;
+}
+
+static int
+icvIsBase64Chunk( const CvFileNode* node )
+{
+    const int prefix_len = (int)sizeof(icvBase64Prefix) - 1;
+    return CV_NODE_TYPE(node->tag) == CV_NODE_STRING && node->data.str.len > prefix_len &&
+           memcmp( node->data.str.ptr, icvBase64Prefix, prefix_len ) == 0;
+}
+
+/* replaces the just parsed element of the sequence with the decoded numbers
+   if the element is a base64 chunk */
+static void
+icvFSDecodeBase64( CvFileStorage* fs, CvFileNode* collection, CvFileNode* elem )
+{
+    const int prefix_len = (int)sizeof(icvBase64Prefix) - 1;
+    if( !elem || !CV_NODE_IS_SEQ(collection->tag) || !icvIsBase64Chunk( elem ) )
+        return;
+
+    // the elements delivered to the handler one by one are passed as they are
+    if( fs->handler && fs->stream_stack->total > 0 )
+    {
+        CvFSStreamRecord* rec = (CvFSStreamRecord*)cvGetSeqElem( fs->stream_stack, -1 );
+        if( rec->elem == elem || (rec->elem == collection && rec->state == 1) )
+            return;
+    }
+
+    const char* str = elem->data.str.ptr + prefix_len;
+    const char* dt_end = strchr( str, '$' );
+    if( !dt_end || dt_end == str || dt_end - str > CV_FS_MAX_LEN )
+        CV_PARSE_ERROR( "Invalid base64 header" );
+
+    char dt[CV_FS_MAX_LEN+1];
+    int fmt_pairs[CV_FS_MAX_FMT_PAIRS*2], stride, extent, comps;
+    memcpy( dt, str, dt_end - str );
+    dt[dt_end - str] = '\0';
+    icvCalcRawLayout( fmt_pairs, icvDecodeFormat( dt, fmt_pairs, CV_FS_MAX_FMT_PAIRS ),
+                      &stride, &extent, &comps );
+
+    const char* payload = dt_end + 1;
+    int len = elem->data.str.len - (int)(payload - elem->data.str.ptr);
+    cv::AutoBuffer<uchar> buf(len/4*3 + 3);
+    int size = icvBase64Decode( payload, len, buf );
+    if( size < extent || (size - extent) % stride != 0 )
+        CV_PARSE_ERROR( "Invalid base64 data" );
+
+    CvSeq* seq = collection->data.seq;
+    cvSeqPop( seq, 0 );
+    icvBinPushRawData( seq, dt, buf, size );
+}
+
+
 /****************************************************************************************\
 *                                       YAML Parser                                      *
 \****************************************************************************************/
@@ -1165,7 +1847,7 @@ force_real:
         else
         {
 force_int:
-            ival = (int)strtol( ptr, &endptr, 0 );
+            ival = icv_strtol( ptr, &endptr );
             node->tag = CV_NODE_INT;
             node->data.i = ival;
         }
@@ -1247,7 +1929,7 @@ force_int:
     {
         int new_min_indent = min_indent + !is_parent_flow;
         int struct_flags = CV_NODE_FLOW + (c == '{' ? CV_NODE_MAP : CV_NODE_SEQ);
-        int is_simple = 1;
+        int is_simple = 1, count = 0;
 
         icvFSCreateCollection( fs, CV_NODE_TYPE(struct_flags) +
                                         (node->info ? CV_NODE_USER : 0), node );
@@ -1267,7 +1949,7 @@ force_int:
                 break;
             }
 
-            if( node->data.seq->total != 0 )
+            if( count != 0 )
             {
                 if( *ptr != ',' )
                     CV_PARSE_ERROR( "Missing , between the elements" );
@@ -1283,12 +1965,27 @@ force_int:
             {
                 if( *ptr == ']' )
                     break;
+                if( !fs->handler )
+                {
+                    int n = 0;
+                    ptr = icvFSParseNumbers( fs, ptr, node->data.seq, ',', &n );
+                    if( n > 0 )
+                    {
+                        count += n;
+                        continue;
+                    }
+                }
                 elem = (CvFileNode*)cvSeqPush( node->data.seq, 0 );
             }
+            icvFSStreamStart( fs, elem, CV_NODE_IS_MAP(struct_flags) ? ((CvFileMapNode*)elem)->key : 0 );
             ptr = icvYMLParseValue( fs, ptr, elem, struct_flags, new_min_indent );
             if( CV_NODE_IS_MAP(struct_flags) )
                 elem->tag |= CV_NODE_NAMED;
             is_simple &= !CV_NODE_IS_COLLECTION(elem->tag);
+            if( !CV_NODE_IS_MAP(struct_flags) )
+                icvFSDecodeBase64( fs, node, elem );
+            icvFSStreamEnd( fs, node, elem );
+            count++;
         }
         node->data.seq->flags |= is_simple ? CV_NODE_SEQ_SIMPLE : 0;
     }
@@ -1359,10 +2056,14 @@ force_string:
             }
 
             ptr = icvYMLSkipSpaces( fs, ptr, indent + 1, INT_MAX );
+            icvFSStreamStart( fs, elem, CV_NODE_IS_MAP(struct_flags) ? ((CvFileMapNode*)elem)->key : 0 );
             ptr = icvYMLParseValue( fs, ptr, elem, struct_flags, indent + 1 );
             if( CV_NODE_IS_MAP(struct_flags) )
                 elem->tag |= CV_NODE_NAMED;
             is_simple &= !CV_NODE_IS_COLLECTION(elem->tag);
+            if( !CV_NODE_IS_MAP(struct_flags) )
+                icvFSDecodeBase64( fs, node, elem );
+            icvFSStreamEnd( fs, node, elem );
 
             ptr = icvYMLSkipSpaces( fs, ptr, 0, INT_MAX );
             if( ptr - fs->buffer_start != indent )
@@ -1434,9 +2135,11 @@ icvYMLParse( CvFileStorage* fs )
             // 2. parse the collection
             CvFileNode* root_node = (CvFileNode*)cvSeqPush( fs->roots, 0 );
 
+            icvFSStreamStart( fs, root_node, 0 );
             ptr = icvYMLParseValue( fs, ptr, root_node, CV_NODE_NONE, 0 );
             if( !CV_NODE_IS_COLLECTION(root_node->tag) )
                 CV_PARSE_ERROR( "Only collections as YAML streams are supported by this parser" );
+            icvFSStreamEnd( fs, 0, root_node );
 
             // 3. parse until the end of file or next collection
             ptr = icvYMLSkipSpaces( fs, ptr, 0, INT_MAX );
@@ -1897,10 +2600,13 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
             int is_noname = 0;
             const char* type_name = 0;
             int elem_type = CV_NODE_NONE;
+            CvMemStoragePos pos;
 
             if( d == '/' || c == '\0' )
                 break;
 
+            if( fs->handler )
+                cvSaveMemStoragePos( fs->memstorage, &pos );
             ptr = icvXMLParseTag( fs, ptr, &key, &list, &tag_type );
 
             if( tag_type == CV_XML_DIRECTIVE_TAG )
@@ -1931,6 +2637,9 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
             if( !CV_NODE_IS_COLLECTION(node->tag) )
             {
                 icvFSCreateCollection( fs, is_noname ? CV_NODE_SEQ : CV_NODE_MAP, node );
+                // the collection itself must survive the element rollback
+                if( fs->handler )
+                    cvSaveMemStoragePos( fs->memstorage, &pos );
             }
             else if( is_noname ^ CV_NODE_IS_SEQ(node->tag) )
                 CV_PARSE_ERROR( is_noname ? "Map element should have a name" :
@@ -1941,6 +2650,7 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
             else
                 elem = cvGetFileNode( fs, node, key, 1 );
 
+            icvFSStreamStart( fs, elem, is_noname ? 0 : key, info, &pos );
             ptr = icvXMLParseValue( fs, ptr, elem, elem_type);
             if( !is_noname )
                 elem->tag |= CV_NODE_NAMED;
@@ -1949,6 +2659,7 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
             ptr = icvXMLParseTag( fs, ptr, &key2, &list, &tag_type );
             if( tag_type != CV_XML_CLOSING_TAG || key2 != key )
                 CV_PARSE_ERROR( "Mismatched closing tag" );
+            icvFSStreamEnd( fs, node, elem );
             have_space = 1;
         }
         else
@@ -1956,14 +2667,29 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
             if( !have_space )
                 CV_PARSE_ERROR( "There should be space between literals" );
 
+            if( CV_NODE_IS_SEQ(node->tag) && value_type != CV_NODE_STRING && !fs->handler )
+            {
+                int n = 0;
+                ptr = icvFSParseNumbers( fs, ptr, node->data.seq, 0, &n );
+                if( n > 0 )
+                {
+                    have_space = 0;
+                    continue;
+                }
+            }
+
             elem = node;
             if( node->tag != CV_NODE_NONE )
             {
                 if( !CV_NODE_IS_COLLECTION(node->tag) )
+                {
                     icvFSCreateCollection( fs, CV_NODE_SEQ, node );
+                    icvFSDecodeBase64( fs, node, (CvFileNode*)cvGetSeqElem( node->data.seq, 0 ) );
+                }
 
                 elem = (CvFileNode*)cvSeqPush( node->data.seq, 0 );
                 elem->info = 0;
+                icvFSStreamStart( fs, elem, 0 );
             }
 
             if( value_type != CV_NODE_STRING &&
@@ -1985,7 +2711,7 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
                 }
                 else
                 {
-                    ival = (int)strtol( ptr, &endptr, 0 );
+                    ival = icv_strtol( ptr, &endptr );
                     elem->tag = CV_NODE_INT;
                     elem->data.i = ival;
                 }
@@ -2079,12 +2805,22 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
                 elem->data.str = cvMemStorageAllocString( fs->memstorage, buf, i );
             }
 
+            if( elem != node )
+            {
+                icvFSDecodeBase64( fs, node, elem );
+                icvFSStreamEnd( fs, node, elem );
+            }
+
             if( !CV_NODE_IS_COLLECTION(value_type) && value_type != CV_NODE_NONE )
                 break;
             have_space = 0;
         }
     }
 
+    // a single base64 chunk is read as a sequence of the decoded numbers
+    if( value_type == CV_NODE_NONE && icvIsBase64Chunk( node ) )
+        value_type = CV_NODE_SEQ;
+
     if( (CV_NODE_TYPE(node->tag) == CV_NODE_NONE ||
         (CV_NODE_TYPE(node->tag) != value_type &&
         !CV_NODE_IS_COLLECTION(node->tag))) &&
@@ -2092,6 +2828,8 @@ icvXMLParseValue( CvFileStorage* fs, char* ptr, CvFileNode* node,
     {
         icvFSCreateCollection( fs, CV_NODE_IS_MAP(value_type) ?
                                         CV_NODE_MAP : CV_NODE_SEQ, node );
+        if( CV_NODE_IS_SEQ(node->tag) && node->data.seq->total == 1 )
+            icvFSDecodeBase64( fs, node, (CvFileNode*)cvGetSeqElem( node->data.seq, 0 ) );
     }
 
     if( value_type != CV_NODE_NONE &&
@@ -2296,10 +3034,12 @@ icvXMLParse( CvFileStorage* fs )
                 CV_PARSE_ERROR( "<opencv_storage> tag is missing" );
 
             root_node = (CvFileNode*)cvSeqPush( fs->roots, 0 );
+            icvFSStreamStart( fs, root_node, 0 );
             ptr = icvXMLParseValue( fs, ptr, root_node, CV_NODE_NONE );
             ptr = icvXMLParseTag( fs, ptr, &key2, &list, &tag_type );
             if( tag_type != CV_XML_CLOSING_TAG || key != key2 )
                 CV_PARSE_ERROR( "</opencv_storage> tag is missing" );
+            icvFSStreamEnd( fs, 0, root_node );
             ptr = icvXMLSkipSpaces( fs, ptr, 0 );
         }
     }
@@ -2515,178 +3255,949 @@ icvXMLWriteScalar( CvFileStorage* fs, const char* key, const char* data, int len
         else if( ptr > fs->buffer_start + fs->struct_indent && ptr[-1] != '>' )
             *ptr++ = ' ';
 
-        memcpy( ptr, data, len );
-        fs->buffer = ptr + len;
+        memcpy( ptr, data, len );
+        fs->buffer = ptr + len;
+    }
+}
+
+
+static void
+icvXMLWriteInt( CvFileStorage* fs, const char* key, int value )
+{
+    char buf[128], *ptr = icv_itoa( value, buf, 10 );
+    int len = (int)strlen(ptr);
+    icvXMLWriteScalar( fs, key, ptr, len );
+}
+
+
+static void
+icvXMLWriteReal( CvFileStorage* fs, const char* key, double value )
+{
+    char buf[128];
+    int len = (int)strlen( icvDoubleToString( buf, value ));
+    icvXMLWriteScalar( fs, key, buf, len );
+}
+
+
+static void
+icvXMLWriteString( CvFileStorage* fs, const char* key, const char* str, int quote )
+{
+    char buf[CV_FS_MAX_LEN*6+16];
+    char* data = (char*)str;
+    int i, len;
+
+    if( !str )
+        CV_Error( CV_StsNullPtr, "Null string pointer" );
+
+    len = (int)strlen(str);
+    if( len > CV_FS_MAX_LEN )
+        CV_Error( CV_StsBadArg, "The written string is too long" );
+
+    if( quote || len == 0 || str[0] != '\"' || str[0] != str[len-1] )
+    {
+        int need_quote = quote || len == 0;
+        data = buf;
+        *data++ = '\"';
+        for( i = 0; i < len; i++ )
+        {
+            char c = str[i];
+
+            if( (uchar)c >= 128 || c == ' ' )
+            {
+                *data++ = c;
+                need_quote = 1;
+            }
+            else if( !cv_isprint(c) || c == '<' || c == '>' || c == '&' || c == '\'' || c == '\"' )
+            {
+                *data++ = '&';
+                if( c == '<' )
+                {
+                    memcpy(data, "lt", 2);
+                    data += 2;
+                }
+                else if( c == '>' )
+                {
+                    memcpy(data, "gt", 2);
+                    data += 2;
+                }
+                else if( c == '&' )
+                {
+                    memcpy(data, "amp", 3);
+                    data += 3;
+                }
+                else if( c == '\'' )
+                {
+                    memcpy(data, "apos", 4);
+                    data += 4;
+                }
+                else if( c == '\"' )
+                {
+                    memcpy( data, "quot", 4);
+                    data += 4;
+                }
+                else
+                {
+                    sprintf( data, "#x%02x", (uchar)c );
+                    data += 4;
+                }
+                *data++ = ';';
+                need_quote = 1;
+            }
+            else
+                *data++ = c;
+        }
+        if( !need_quote && (cv_isdigit(str[0]) ||
+            str[0] == '+' || str[0] == '-' || str[0] == '.' ))
+            need_quote = 1;
+
+        if( need_quote )
+            *data++ = '\"';
+        len = (int)(data - buf) - !need_quote;
+        *data++ = '\0';
+        data = buf + !need_quote;
+    }
+
+    icvXMLWriteScalar( fs, key, data, len );
+}
+
+
+static void
+icvXMLWriteComment( CvFileStorage* fs, const char* comment, int eol_comment )
+{
+    int len;
+    int multiline;
+    const char* eol;
+    char* ptr;
+
+    if( !comment )
+        CV_Error( CV_StsNullPtr, "Null comment" );
+
+    if( strstr(comment, "--") != 0 )
+        CV_Error( CV_StsBadArg, "Double hyphen \'--\' is not allowed in the comments" );
+
+    len = (int)strlen(comment);
+    eol = strchr(comment, '\n');
+    multiline = eol != 0;
+    ptr = fs->buffer;
+
+    if( multiline || !eol_comment || fs->buffer_end - ptr < len + 5 )
+        ptr = icvXMLFlush( fs );
+    else if( ptr > fs->buffer_start + fs->struct_indent )
+        *ptr++ = ' ';
+
+    if( !multiline )
+    {
+        ptr = icvFSResizeWriteBuffer( fs, ptr, len + 9 );
+        sprintf( ptr, "<!-- %s -->", comment );
+        len = (int)strlen(ptr);
+    }
+    else
+    {
+        strcpy( ptr, "<!--" );
+        len = 4;
+    }
+
+    fs->buffer = ptr + len;
+    ptr = icvXMLFlush(fs);
+
+    if( multiline )
+    {
+        while( comment )
+        {
+            if( eol )
+            {
+                ptr = icvFSResizeWriteBuffer( fs, ptr, (int)(eol - comment) + 1 );
+                memcpy( ptr, comment, eol - comment + 1 );
+                ptr += eol - comment;
+                comment = eol + 1;
+                eol = strchr( comment, '\n' );
+            }
+            else
+            {
+                len = (int)strlen(comment);
+                ptr = icvFSResizeWriteBuffer( fs, ptr, len );
+                memcpy( ptr, comment, len );
+                ptr += len;
+                comment = 0;
+            }
+            fs->buffer = ptr;
+            ptr = icvXMLFlush( fs );
+        }
+        sprintf( ptr, "-->" );
+        fs->buffer = ptr + 3;
+        icvXMLFlush( fs );
+    }
+}
+
+
+/****************************************************************************************\
+*                                     Binary Format                                      *
+\****************************************************************************************/
+
+/*
+   The binary storage starts with CvBinHeader, followed by a flat list of 8-byte aligned
+   records: CvBinRecord, the record name (the key or, for the raw data, the format string)
+   and the payload. Scalars keep their value in the record itself, strings and type names
+   of collections are stored in the payload, collections are terminated by an END record.
+
+   Raw data blocks (written by cvWriteRawData) are stored as they are in memory. The parser
+   does not decode them: a sequence that consists only of raw blocks keeps pointers to the
+   file mapping, and the elements are converted to file nodes only on element-wise access.
+   Large blocks are 64-byte aligned in the file, so cv::read() can make matrix headers
+   that point directly to the mapping.
+*/
+
+#define CV_BIN_SIGNATURE    "%CVBIN:1"
+#define CV_BIN_SIGNATURE_LEN 8
+#define CV_BIN_BYTE_ORDER   0x01020304
+#define CV_BIN_ALIGN        64
+#define CV_BIN_ALIGN_MIN    256
+
+#define CV_BIN_REC_END      256
+#define CV_BIN_REC_RAW      512
+#define CV_BIN_REC_STREAM   1024
+
+// sequence flag, see CV_NODE_SEQ_SIMPLE
+#define CV_NODE_SEQ_RAW     512
+
+#define CV_FS_MAPPING_MAGIC 0x4D534643 /* 'CFSM' */
+
+typedef struct CvBinHeader
+{
+    char signature[CV_BIN_SIGNATURE_LEN];
+    int byte_order;
+    int reserved;
+}
+CvBinHeader;
+
+typedef struct CvBinRecord
+{
+    int tag;
+    int name_len;
+    int64 len;
+}
+CvBinRecord;
+
+/* the file contents shared by the storage and the matrices read from it */
+typedef struct CvFSMapping
+{
+    int refcount; // must be the first field, Mat::refcount points to it
+    int signature;
+    uchar* data;
+    size_t size;
+    int is_mapped;
+}
+CvFSMapping;
+
+typedef struct CvFileRawChunk
+{
+    const uchar* data;
+    size_t size;
+    int count;
+}
+CvFileRawChunk;
+
+typedef struct CvFileRawSeq
+{
+    CV_SEQUENCE_FIELDS()
+    const char* dt;
+    int nchunks;
+    CvFileRawChunk* chunks;
+}
+CvFileRawSeq;
+
+static int icvDecodeFormat( const char* dt, int* fmt_pairs, int max_len );
+
+static CvFSMapping*
+icvFSCreateMapping( size_t size )
+{
+    CvFSMapping* m = (CvFSMapping*)cvAlloc( sizeof(*m) );
+    m->refcount = 1;
+    m->signature = CV_FS_MAPPING_MAGIC;
+    m->data = (uchar*)cvAlloc( size + 1 );
+    m->size = size;
+    m->is_mapped = 0;
+    return m;
+}
+
+static void
+icvFSFreeMapping( CvFSMapping* m )
+{
+#ifdef HAVE_MMAP
+    if( m->is_mapped )
+        munmap( m->data, m->size );
+    else
+#endif
+        cvFree( &m->data );
+    m->signature = 0;
+    cvFree( &m );
+}
+
+static void
+icvFSReleaseMapping( CvFSMapping** pm )
+{
+    CvFSMapping* m = *pm;
+    *pm = 0;
+    if( m && CV_XADD(&m->refcount, -1) == 1 )
+        icvFSFreeMapping( m );
+}
+
+/* reads the whole binary storage into memory, mapping the uncompressed files */
+static void
+icvBinLoad( CvFileStorage* fs )
+{
+#if USE_ZLIB
+    if( fs->gzfile )
+    {
+        size_t size = 0, bufsize = 1 << 20;
+        uchar* buf = (uchar*)cvAlloc( bufsize );
+        for(;;)
+        {
+            if( size == bufsize )
+            {
+                uchar* newbuf = (uchar*)cvAlloc( bufsize*2 );
+                memcpy( newbuf, buf, size );
+                cvFree( &buf );
+                buf = newbuf;
+                bufsize *= 2;
+            }
+            int count = gzread( fs->gzfile, buf + size, (unsigned)MIN(bufsize - size, (size_t)INT_MAX) );
+            if( count <= 0 )
+                break;
+            size += count;
+        }
+        fs->mapping = icvFSCreateMapping( size );
+        memcpy( fs->mapping->data, buf, size );
+        cvFree( &buf );
+        return;
+    }
+#endif
+
+    CV_Assert( fs->file != 0 );
+    fs->file = freopen( fs->filename, "rb", fs->file );
+    if( !fs->file )
+        CV_Error_( CV_StsError, ("Can not open %s", fs->filename) );
+
+#ifdef HAVE_MMAP
+    int fd = fileno( fs->file );
+    struct stat st;
+    if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+    {
+        // the private writable mapping lets the aliased matrices be modified without touching the file
+        void* ptr = mmap( 0, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+        if( ptr != MAP_FAILED )
+        {
+            fs->mapping = (CvFSMapping*)cvAlloc( sizeof(*fs->mapping) );
+            fs->mapping->refcount = 1;
+            fs->mapping->signature = CV_FS_MAPPING_MAGIC;
+            fs->mapping->data = (uchar*)ptr;
+            fs->mapping->size = (size_t)st.st_size;
+            fs->mapping->is_mapped = 1;
+            return;
+        }
+    }
+#endif
+
+    fseek( fs->file, 0, SEEK_END );
+    size_t size = (size_t)ftell( fs->file );
+    fseek( fs->file, 0, SEEK_SET );
+    fs->mapping = icvFSCreateMapping( size );
+    if( fread( fs->mapping->data, 1, size, fs->file ) != size )
+        CV_Error_( CV_StsError, ("Can not read %s", fs->filename) );
+}
+
+/* computes the distance between consecutive records of the raw data (stride),
+   the size of one record without the trailing padding (extent) and the number of scalars in it */
+static void
+icvCalcRawLayout( const int* fmt_pairs, int fmt_pair_count, int* stride, int* extent, int* comps )
+{
+    int k, size = 0, count = 0, max_elem_size = 1;
+    for( k = 0; k < fmt_pair_count; k++ )
+    {
+        int elem_size = CV_ELEM_SIZE(fmt_pairs[k*2+1]);
+        size = cvAlign( size, elem_size );
+        size += elem_size*fmt_pairs[k*2];
+        count += fmt_pairs[k*2];
+        max_elem_size = MAX( max_elem_size, elem_size );
+    }
+    *extent = size;
+    // the records are laid out as an array of C structures
+    *stride = cvAlign( size, max_elem_size );
+    *comps = count;
+}
+
+static const uchar*
+icvBinReadRecord( CvFileStorage* fs, const uchar* ptr, CvBinRecord* rec,
+                  const char** name, const uchar** payload )
+{
+    const uchar* base = fs->mapping->data;
+    const uchar* end = base + fs->mapping->size;
+
+    if( ptr > end || (size_t)(end - ptr) < sizeof(*rec) )
+        CV_PARSE_ERROR( "Unexpected end of the binary storage" );
+    memcpy( rec, ptr, sizeof(*rec) );
+    ptr += sizeof(*rec);
+
+    if( rec->name_len < 0 || rec->name_len > CV_FS_MAX_LEN || rec->name_len > end - ptr )
+        CV_PARSE_ERROR( "Invalid record name" );
+    *name = (const char*)ptr;
+    ptr += cv::alignSize( rec->name_len, 8 );
+    *payload = 0;
+
+    int type = CV_NODE_TYPE(rec->tag);
+    if( rec->tag == CV_BIN_REC_RAW || type == CV_NODE_STR || type == CV_NODE_SEQ || type == CV_NODE_MAP )
+    {
+        if( rec->len < 0 )
+            CV_PARSE_ERROR( "Invalid record length" );
+        size_t len = (size_t)rec->len;
+        if( rec->tag == CV_BIN_REC_RAW && len >= CV_BIN_ALIGN_MIN )
+            ptr = base + cv::alignSize( (size_t)(ptr - base), CV_BIN_ALIGN );
+        if( ptr > end || len > (size_t)(end - ptr) )
+            CV_PARSE_ERROR( "Unexpected end of the binary storage" );
+        *payload = ptr;
+        ptr += cv::alignSize( len, 8 );
+    }
+    return ptr;
+}
+
+/* decodes the raw data block and appends the elements to the sequence of file nodes */
+static void
+icvBinPushRawData( CvSeq* seq, const char* dt, const uchar* data, size_t size )
+{
+    int fmt_pairs[CV_FS_MAX_FMT_PAIRS*2], fmt_pair_count, stride, extent, comps;
+    fmt_pair_count = icvDecodeFormat( dt, fmt_pairs, CV_FS_MAX_FMT_PAIRS );
+    icvCalcRawLayout( fmt_pairs, fmt_pair_count, &stride, &extent, &comps );
+
+    const int BUFSZ = 256;
+    CvFileNode buf[BUFSZ];
+    int n = 0;
+    size_t r, nrecords = size >= (size_t)extent ? (size - extent)/stride + 1 : 0;
+
+    memset( buf, 0, sizeof(buf) );
+    for( r = 0; r < nrecords; r++ )
+    {
+        size_t offset = r*stride;
+        for( int k = 0; k < fmt_pair_count; k++ )
+        {
+            int i, count = fmt_pairs[k*2], elem_type = fmt_pairs[k*2+1];
+            int elem_size = CV_ELEM_SIZE(elem_type);
+            offset = cv::alignSize( offset, elem_size );
+
+            for( i = 0; i < count; i++, offset += elem_size )
+            {
+                const uchar* p = data + offset;
+                CvFileNode* node = &buf[n];
+                node->tag = CV_NODE_INT;
+                switch( elem_type )
+                {
+                case CV_8U: node->data.i = *p; break;
+                case CV_8S: node->data.i = *(const schar*)p; break;
+                case CV_16U: node->data.i = *(const ushort*)p; break;
+                case CV_16S: node->data.i = *(const short*)p; break;
+                case CV_32S: node->data.i = *(const int*)p; break;
+                case CV_32F: node->tag = CV_NODE_REAL; node->data.f = *(const float*)p; break;
+                case CV_64F: node->tag = CV_NODE_REAL; node->data.f = *(const double*)p; break;
+                case CV_USRTYPE1: node->data.i = (int)*(const size_t*)p; break;
+                default: assert(0); return;
+                }
+                if( ++n == BUFSZ )
+                {
+                    cvSeqPushMulti( seq, buf, n );
+                    n = 0;
+                }
+            }
+        }
+    }
+    if( n > 0 )
+        cvSeqPushMulti( seq, buf, n );
+}
+
+/* converts the lazily decoded raw sequence to the regular sequence of file nodes */
+static void
+icvFSExpandRawSeq( const CvFileNode* node )
+{
+    if( !node || !CV_NODE_IS_SEQ(node->tag) || !(node->data.seq->flags & CV_NODE_SEQ_RAW) )
+        return;
+
+    CvFileRawSeq* seq = (CvFileRawSeq*)node->data.seq;
+    seq->flags &= ~CV_NODE_SEQ_RAW;
+    seq->total = 0;
+    for( int i = 0; i < seq->nchunks; i++ )
+        icvBinPushRawData( (CvSeq*)seq, seq->dt, seq->chunks[i].data, seq->chunks[i].size );
+}
+
+/* reads the whole raw sequence without decoding it into the file nodes;
+   returns false if the requested format can not be produced by a plain copy or conversion */
+static bool
+icvBinReadRawSeq( const CvFileRawSeq* seq, void* _data, const char* dt )
+{
+    int src_pairs[CV_FS_MAX_FMT_PAIRS*2], dst_pairs[CV_FS_MAX_FMT_PAIRS*2];
+    int src_count = icvDecodeFormat( seq->dt, src_pairs, CV_FS_MAX_FMT_PAIRS );
+    int dst_count = icvDecodeFormat( dt, dst_pairs, CV_FS_MAX_FMT_PAIRS );
+    uchar* data = (uchar*)_data;
+    int i;
+
+    if( src_count == dst_count && memcmp( src_pairs, dst_pairs, src_count*2*sizeof(int) ) == 0 )
+    {
+        int stride, extent, comps;
+        icvCalcRawLayout( src_pairs, src_count, &stride, &extent, &comps );
+        for( i = 0; i < seq->nchunks; i++ )
+        {
+            memcpy( data, seq->chunks[i].data, seq->chunks[i].size );
+            data += seq->chunks[i].size + (stride - extent);
+        }
+        return true;
+    }
+
+    if( src_count == 1 && dst_count == 1 &&
+        src_pairs[1] != CV_USRTYPE1 && dst_pairs[1] != CV_USRTYPE1 )
+    {
+        int sdepth = src_pairs[1], ddepth = dst_pairs[1];
+        if( seq->total % dst_pairs[0] != 0 )
+            CV_Error( CV_StsBadSize, "The sequence slice does not fit an integer number of records" );
+        for( i = 0; i < seq->nchunks; i++ )
+        {
+            int count = seq->chunks[i].count;
+            cv::Mat src( 1, count, sdepth, (void*)seq->chunks[i].data ), dst( 1, count, ddepth, data );
+            src.convertTo( dst, ddepth );
+            data += (size_t)count*CV_ELEM_SIZE(ddepth);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/* checks whether the sequence starting at ptr consists only of the raw blocks of the same format */
+static int
+icvBinScanRawSeq( CvFileStorage* fs, const uchar* ptr, const char** dt, int* dt_len )
+{
+    int nchunks = 0;
+    for(;;)
+    {
+        CvBinRecord rec;
+        const char* name;
+        const uchar* payload;
+        ptr = icvBinReadRecord( fs, ptr, &rec, &name, &payload );
+        if( rec.tag == CV_BIN_REC_END )
+            break;
+        if( rec.tag != CV_BIN_REC_RAW ||
+            (nchunks > 0 && (rec.name_len != *dt_len || memcmp( name, *dt, rec.name_len ) != 0)) )
+            return 0;
+        *dt = name;
+        *dt_len = rec.name_len;
+        nchunks++;
+    }
+    return nchunks;
+}
+
+static const uchar*
+icvBinParseRawSeq( CvFileStorage* fs, const uchar* ptr, CvFileNode* node,
+                   const char* dt, int dt_len, int nchunks )
+{
+    int fmt_pairs[CV_FS_MAX_FMT_PAIRS*2], fmt_pair_count, stride, extent, comps;
+    CvFileRawSeq* seq = (CvFileRawSeq*)cvCreateSeq( 0, sizeof(CvFileRawSeq),
+                                    sizeof(CvFileNode), fs->memstorage );
+    int64 total = 0;
+
+    seq->flags |= CV_NODE_SEQ_SIMPLE | CV_NODE_SEQ_RAW;
+    seq->dt = cvMemStorageAllocString( fs->memstorage, dt, dt_len ).ptr;
+    fmt_pair_count = icvDecodeFormat( seq->dt, fmt_pairs, CV_FS_MAX_FMT_PAIRS );
+    if( fmt_pair_count == 0 )
+        CV_PARSE_ERROR( "Invalid raw data format" );
+    icvCalcRawLayout( fmt_pairs, fmt_pair_count, &stride, &extent, &comps );
+
+    seq->nchunks = nchunks;
+    seq->chunks = (CvFileRawChunk*)cvMemStorageAlloc( fs->memstorage, nchunks*sizeof(seq->chunks[0]) );
+    for( int i = 0; i < nchunks; i++ )
+    {
+        CvBinRecord rec;
+        const char* name;
+        const uchar* payload;
+        ptr = icvBinReadRecord( fs, ptr, &rec, &name, &payload );
+        size_t size = (size_t)rec.len;
+        if( size < (size_t)extent || (size - extent) % stride != 0 )
+            CV_PARSE_ERROR( "The raw data block does not contain an integer number of records" );
+        int64 count = (int64)((size - extent)/stride + 1)*comps;
+        total += count;
+        if( total > INT_MAX )
+            CV_PARSE_ERROR( "Too many elements in the raw data block" );
+        seq->chunks[i].data = payload;
+        seq->chunks[i].size = size;
+        seq->chunks[i].count = (int)count;
+    }
+    seq->total = (int)total;
+
+    CvBinRecord rec;
+    const char* name;
+    const uchar* payload;
+    ptr = icvBinReadRecord( fs, ptr, &rec, &name, &payload );
+    assert( rec.tag == CV_BIN_REC_END );
+
+    node->tag = CV_NODE_SEQ;
+    node->data.seq = (CvSeq*)seq;
+    return ptr;
+}
+
+static const uchar*
+icvBinParseCollection( CvFileStorage* fs, const uchar* ptr, CvFileNode* node, int is_root );
+
+static const uchar*
+icvBinParseValue( CvFileStorage* fs, const uchar* ptr, const CvBinRecord* rec,
+                  const uchar* payload, CvFileNode* node )
+{
+    int type = CV_NODE_TYPE(rec->tag);
+    memset( node, 0, sizeof(*node) );
+
+    if( rec->tag == CV_NODE_INT )
+    {
+        node->tag = CV_NODE_INT;
+        node->data.i = (int)rec->len;
+    }
+    else if( rec->tag == CV_NODE_REAL )
+    {
+        node->tag = CV_NODE_REAL;
+        memcpy( &node->data.f, &rec->len, sizeof(double) );
+    }
+    else if( rec->tag == CV_NODE_STR )
+    {
+        if( rec->len > CV_FS_MAX_LEN )
+            CV_PARSE_ERROR( "Too long string literal" );
+        node->tag = CV_NODE_STR;
+        node->data.str = cvMemStorageAllocString( fs->memstorage, (const char*)payload, (int)rec->len );
+    }
+    else if( (rec->tag & ~(CV_NODE_TYPE_MASK|CV_NODE_FLOW)) == 0 &&
+             (type == CV_NODE_SEQ || type == CV_NODE_MAP) )
+    {
+        CvTypeInfo* info = 0;
+        const char* dt = 0;
+        int dt_len = 0, nchunks = 0;
+
+        if( rec->len > 0 )
+        {
+            char type_name[CV_FS_MAX_LEN+1];
+            if( rec->len > CV_FS_MAX_LEN )
+                CV_PARSE_ERROR( "Too long type name" );
+            memcpy( type_name, payload, (size_t)rec->len );
+            type_name[rec->len] = '\0';
+            info = cvFindType( type_name );
+        }
+
+        if( type == CV_NODE_SEQ && (nchunks = icvBinScanRawSeq( fs, ptr, &dt, &dt_len )) > 0 )
+            ptr = icvBinParseRawSeq( fs, ptr, node, dt, dt_len, nchunks );
+        else
+        {
+            icvFSCreateCollection( fs, type, node );
+            ptr = icvBinParseCollection( fs, ptr, node, 0 );
+        }
+
+        if( info )
+        {
+            node->info = info;
+            node->tag |= CV_NODE_USER;
+        }
+    }
+    else
+        CV_PARSE_ERROR( "Unknown record type" );
+
+    return ptr;
+}
+
+static const uchar*
+icvBinParseCollection( CvFileStorage* fs, const uchar* ptr, CvFileNode* node, int is_root )
+{
+    const uchar* end = fs->mapping->data + fs->mapping->size;
+    int is_simple = 1;
+
+    for(;;)
+    {
+        CvBinRecord rec;
+        const char* name;
+        const uchar* payload;
+        CvFileNode* elem;
+
+        if( is_root && ptr >= end )
+            break;
+
+        const uchar* next = icvBinReadRecord( fs, ptr, &rec, &name, &payload );
+        if( rec.tag == CV_BIN_REC_END )
+        {
+            if( is_root )
+                CV_PARSE_ERROR( "Unexpected end of the collection" );
+            ptr = next;
+            break;
+        }
+        if( rec.tag == CV_BIN_REC_STREAM )
+        {
+            if( !is_root )
+                CV_PARSE_ERROR( "Unexpected end of the stream" );
+            break;
+        }
+
+        // the top-level collection type is defined by its first element
+        if( !CV_NODE_IS_COLLECTION(node->tag) )
+            icvFSCreateCollection( fs, rec.name_len > 0 ? CV_NODE_MAP : CV_NODE_SEQ, node );
+
+        if( rec.tag == CV_BIN_REC_RAW )
+        {
+            // raw data mixed with other elements
+            if( !CV_NODE_IS_SEQ(node->tag) )
+                CV_PARSE_ERROR( "Raw data may only be stored in a sequence" );
+            char dt[CV_FS_MAX_LEN+1];
+            memcpy( dt, name, rec.name_len );
+            dt[rec.name_len] = '\0';
+            icvBinPushRawData( node->data.seq, dt, payload, (size_t)rec.len );
+            ptr = next;
+            continue;
+        }
+
+        if( CV_NODE_IS_MAP(node->tag) )
+        {
+            if( rec.name_len == 0 )
+                CV_PARSE_ERROR( "Map element should have a name" );
+            CvStringHashNode* key = cvGetHashedKey( fs, name, rec.name_len, 1 );
+            elem = cvGetFileNode( fs, node, key, 1 );
+        }
+        else
+        {
+            if( rec.name_len != 0 )
+                CV_PARSE_ERROR( "Sequence element should not have name" );
+            elem = (CvFileNode*)cvSeqPush( node->data.seq, 0 );
+        }
+
+        ptr = icvBinParseValue( fs, next, &rec, payload, elem );
+        if( CV_NODE_IS_MAP(node->tag) )
+            elem->tag |= CV_NODE_NAMED;
+        is_simple &= !CV_NODE_IS_COLLECTION(elem->tag);
+    }
+
+    if( CV_NODE_IS_COLLECTION(node->tag) && is_simple )
+        node->data.seq->flags |= CV_NODE_SEQ_SIMPLE;
+    return ptr;
+}
+
+static void
+icvBinParse( CvFileStorage* fs )
+{
+    icvBinLoad( fs );
+
+    const uchar* ptr = fs->mapping->data;
+    const uchar* end = ptr + fs->mapping->size;
+    CvBinHeader header;
+
+    if( fs->mapping->size < sizeof(header) )
+        CV_PARSE_ERROR( "The binary storage header is missing" );
+    memcpy( &header, ptr, sizeof(header) );
+    if( memcmp( header.signature, CV_BIN_SIGNATURE, CV_BIN_SIGNATURE_LEN ) != 0 )
+        CV_PARSE_ERROR( "Invalid binary storage signature" );
+    if( header.byte_order != CV_BIN_BYTE_ORDER )
+        CV_PARSE_ERROR( "The binary storage was written on a platform with different byte order" );
+    ptr += sizeof(header);
+
+    for(;;)
+    {
+        CvFileNode* root_node = (CvFileNode*)cvSeqPush( fs->roots, 0 );
+        memset( root_node, 0, sizeof(*root_node) );
+        ptr = icvBinParseCollection( fs, ptr, root_node, 1 );
+        if( ptr >= end )
+            break;
+        // skip the stream separator
+        CvBinRecord rec;
+        const char* name;
+        const uchar* payload;
+        ptr = icvBinReadRecord( fs, ptr, &rec, &name, &payload );
+    }
+}
+
+
+/****************************************************************************************\
+*                                     Binary Emitter                                     *
+\****************************************************************************************/
+
+static void
+icvBinPut( CvFileStorage* fs, const void* _data, size_t len )
+{
+    const char* data = (const char*)_data;
+    if( len == 0 )
+        return;
+    if( fs->outbuf )
+        std::copy( data, data + len, std::back_inserter(*fs->outbuf) );
+    else if( fs->file )
+    {
+        if( fwrite( data, 1, len, fs->file ) != len )
+            CV_Error( CV_StsError, "Could not write to the file storage" );
+    }
+#if USE_ZLIB
+    else if( fs->gzfile )
+    {
+        for( size_t ofs = 0; ofs < len; )
+        {
+            unsigned count = (unsigned)MIN( len - ofs, (size_t)(1 << 30) );
+            if( gzwrite( fs->gzfile, data + ofs, count ) != (int)count )
+                CV_Error( CV_StsError, "Could not write to the file storage" );
+            ofs += count;
+        }
+    }
+#endif
+    else
+        CV_Error( CV_StsError, "The storage is not opened" );
+    fs->bin_pos += len;
+}
+
+static void
+icvBinPad( CvFileStorage* fs, int align )
+{
+    static const char zeros[CV_BIN_ALIGN] = {0};
+    icvBinPut( fs, zeros, cv::alignSize( fs->bin_pos, align ) - fs->bin_pos );
+}
+
+static void
+icvBinWriteRecord( CvFileStorage* fs, int tag, const char* name, int64 len,
+                   const void* payload, size_t payload_len )
+{
+    CvBinRecord rec;
+    rec.tag = tag;
+    rec.name_len = name ? (int)strlen(name) : 0;
+    rec.len = len;
+
+    icvBinPut( fs, &rec, sizeof(rec) );
+    icvBinPut( fs, name, rec.name_len );
+    icvBinPad( fs, 8 );
+    if( payload_len > 0 )
+    {
+        if( tag == CV_BIN_REC_RAW && payload_len >= CV_BIN_ALIGN_MIN )
+            icvBinPad( fs, CV_BIN_ALIGN );
+        icvBinPut( fs, payload, payload_len );
+        icvBinPad( fs, 8 );
+    }
+}
+
+static const char*
+icvBinCheckKey( CvFileStorage* fs, const char* key )
+{
+    int struct_flags = fs->struct_flags;
+
+    if( key && key[0] == '\0' )
+        key = 0;
+
+    if( CV_NODE_IS_COLLECTION(struct_flags) )
+    {
+        if( (CV_NODE_IS_MAP(struct_flags) ^ (key != 0)) )
+            CV_Error( CV_StsBadArg, "An attempt to add element without a key to a map, "
+                                    "or add element with key to sequence" );
+    }
+    else
+    {
+        fs->is_first = 0;
+        struct_flags = key ? CV_NODE_MAP : CV_NODE_SEQ;
+    }
+
+    if( key && strlen(key) > CV_FS_MAX_LEN )
+        CV_Error( CV_StsBadArg, "The key is too long" );
+
+    fs->struct_flags = struct_flags & ~CV_NODE_EMPTY;
+    return key;
+}
+
+static void
+icvBinStartWriteStruct( CvFileStorage* fs, const char* key, int struct_flags,
+                        const char* type_name CV_DEFAULT(0))
+{
+    struct_flags = (struct_flags & (CV_NODE_TYPE_MASK|CV_NODE_FLOW)) | CV_NODE_EMPTY;
+    if( !CV_NODE_IS_COLLECTION(struct_flags))
+        CV_Error( CV_StsBadArg,
+        "Some collection type - CV_NODE_SEQ or CV_NODE_MAP, must be specified" );
+
+    size_t type_len = type_name ? strlen(type_name) : 0;
+    if( type_len > CV_FS_MAX_LEN )
+        CV_Error( CV_StsBadArg, "Too long type name" );
+
+    key = icvBinCheckKey( fs, key );
+    icvBinWriteRecord( fs, struct_flags & (CV_NODE_TYPE_MASK|CV_NODE_FLOW), key,
+                       (int64)type_len, type_name, type_len );
+
+    int parent_flags = fs->struct_flags;
+    cvSeqPush( fs->write_stack, &parent_flags );
+    fs->struct_flags = struct_flags;
+}
+
+static void
+icvBinEndWriteStruct( CvFileStorage* fs )
+{
+    int parent_flags = 0;
+
+    if( fs->write_stack->total == 0 )
+        CV_Error( CV_StsError, "EndWriteStruct w/o matching StartWriteStruct" );
+
+    cvSeqPop( fs->write_stack, &parent_flags );
+    icvBinWriteRecord( fs, CV_BIN_REC_END, 0, 0, 0, 0 );
+    fs->struct_flags = parent_flags;
+}
+
+static void
+icvBinStartNextStream( CvFileStorage* fs )
+{
+    if( !fs->is_first )
+    {
+        while( fs->write_stack->total > 0 )
+            icvBinEndWriteStruct(fs);
+
+        icvBinWriteRecord( fs, CV_BIN_REC_STREAM, 0, 0, 0, 0 );
+        fs->struct_flags = CV_NODE_EMPTY;
+        fs->is_first = 1;
     }
 }
 
-
 static void
-icvXMLWriteInt( CvFileStorage* fs, const char* key, int value )
+icvBinWriteInt( CvFileStorage* fs, const char* key, int value )
 {
-    char buf[128], *ptr = icv_itoa( value, buf, 10 );
-    int len = (int)strlen(ptr);
-    icvXMLWriteScalar( fs, key, ptr, len );
+    key = icvBinCheckKey( fs, key );
+    icvBinWriteRecord( fs, CV_NODE_INT, key, value, 0, 0 );
 }
 
-
 static void
-icvXMLWriteReal( CvFileStorage* fs, const char* key, double value )
+icvBinWriteReal( CvFileStorage* fs, const char* key, double value )
 {
-    char buf[128];
-    int len = (int)strlen( icvDoubleToString( buf, value ));
-    icvXMLWriteScalar( fs, key, buf, len );
+    int64 bits;
+    memcpy( &bits, &value, sizeof(bits) );
+    key = icvBinCheckKey( fs, key );
+    icvBinWriteRecord( fs, CV_NODE_REAL, key, bits, 0, 0 );
 }
 
-
 static void
-icvXMLWriteString( CvFileStorage* fs, const char* key, const char* str, int quote )
+icvBinWriteString( CvFileStorage* fs, const char* key, const char* str, int /*quote*/ )
 {
-    char buf[CV_FS_MAX_LEN*6+16];
-    char* data = (char*)str;
-    int i, len;
-
     if( !str )
         CV_Error( CV_StsNullPtr, "Null string pointer" );
 
-    len = (int)strlen(str);
+    size_t len = strlen(str);
     if( len > CV_FS_MAX_LEN )
         CV_Error( CV_StsBadArg, "The written string is too long" );
 
-    if( quote || len == 0 || str[0] != '\"' || str[0] != str[len-1] )
-    {
-        int need_quote = quote || len == 0;
-        data = buf;
-        *data++ = '\"';
-        for( i = 0; i < len; i++ )
-        {
-            char c = str[i];
-
-            if( (uchar)c >= 128 || c == ' ' )
-            {
-                *data++ = c;
-                need_quote = 1;
-            }
-            else if( !cv_isprint(c) || c == '<' || c == '>' || c == '&' || c == '\'' || c == '\"' )
-            {
-                *data++ = '&';
-                if( c == '<' )
-                {
-                    memcpy(data, "lt", 2);
-                    data += 2;
-                }
-                else if( c == '>' )
-                {
-                    memcpy(data, "gt", 2);
-                    data += 2;
-                }
-                else if( c == '&' )
-                {
-                    memcpy(data, "amp", 3);
-                    data += 3;
-                }
-                else if( c == '\'' )
-                {
-                    memcpy(data, "apos", 4);
-                    data += 4;
-                }
-                else if( c == '\"' )
-                {
-                    memcpy( data, "quot", 4);
-                    data += 4;
-                }
-                else
-                {
-                    sprintf( data, "#x%02x", (uchar)c );
-                    data += 4;
-                }
-                *data++ = ';';
-                need_quote = 1;
-            }
-            else
-                *data++ = c;
-        }
-        if( !need_quote && (cv_isdigit(str[0]) ||
-            str[0] == '+' || str[0] == '-' || str[0] == '.' ))
-            need_quote = 1;
-
-        if( need_quote )
-            *data++ = '\"';
-        len = (int)(data - buf) - !need_quote;
-        *data++ = '\0';
-        data = buf + !need_quote;
-    }
-
-    icvXMLWriteScalar( fs, key, data, len );
+    key = icvBinCheckKey( fs, key );
+    icvBinWriteRecord( fs, CV_NODE_STR, key, (int64)len, str, len );
 }
 
-
 static void
-icvXMLWriteComment( CvFileStorage* fs, const char* comment, int eol_comment )
+icvBinWriteComment( CvFileStorage*, const char* comment, int )
 {
-    int len;
-    int multiline;
-    const char* eol;
-    char* ptr;
-
+    // there is no place for comments in the binary format
     if( !comment )
         CV_Error( CV_StsNullPtr, "Null comment" );
+}
 
-    if( strstr(comment, "--") != 0 )
-        CV_Error( CV_StsBadArg, "Double hyphen \'--\' is not allowed in the comments" );
-
-    len = (int)strlen(comment);
-    eol = strchr(comment, '\n');
-    multiline = eol != 0;
-    ptr = fs->buffer;
-
-    if( multiline || !eol_comment || fs->buffer_end - ptr < len + 5 )
-        ptr = icvXMLFlush( fs );
-    else if( ptr > fs->buffer_start + fs->struct_indent )
-        *ptr++ = ' ';
-
-    if( !multiline )
-    {
-        ptr = icvFSResizeWriteBuffer( fs, ptr, len + 9 );
-        sprintf( ptr, "<!-- %s -->", comment );
-        len = (int)strlen(ptr);
-    }
-    else
-    {
-        strcpy( ptr, "<!--" );
-        len = 4;
-    }
-
-    fs->buffer = ptr + len;
-    ptr = icvXMLFlush(fs);
+static void
+icvBinWriteRawData( CvFileStorage* fs, const void* data, int len, const char* dt,
+                    const int* fmt_pairs, int fmt_pair_count )
+{
+    int stride, extent, comps;
+    icvCalcRawLayout( fmt_pairs, fmt_pair_count, &stride, &extent, &comps );
+    size_t size = (size_t)stride*(len - 1) + extent;
 
-    if( multiline )
-    {
-        while( comment )
-        {
-            if( eol )
-            {
-                ptr = icvFSResizeWriteBuffer( fs, ptr, (int)(eol - comment) + 1 );
-                memcpy( ptr, comment, eol - comment + 1 );
-                ptr += eol - comment;
-                comment = eol + 1;
-                eol = strchr( comment, '\n' );
-            }
-            else
-            {
-                len = (int)strlen(comment);
-                ptr = icvFSResizeWriteBuffer( fs, ptr, len );
-                memcpy( ptr, comment, len );
-                ptr += len;
-                comment = 0;
-            }
-            fs->buffer = ptr;
-            ptr = icvXMLFlush( fs );
-        }
-        sprintf( ptr, "-->" );
-        fs->buffer = ptr + 3;
-        icvXMLFlush( fs );
-    }
+    if( strlen(dt) > CV_FS_MAX_LEN )
+        CV_Error( CV_StsBadArg, "Too long data type specification" );
+    icvBinCheckKey( fs, 0 );
+    icvBinWriteRecord( fs, CV_BIN_REC_RAW, dt, (int64)size, data, size );
 }
 
 
@@ -2694,8 +4205,9 @@ icvXMLWriteComment( CvFileStorage* fs, const char* comment, int eol_comment )
 *                              Common High-Level Functions                               *
 \****************************************************************************************/
 
-CV_IMPL CvFileStorage*
-cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, const char* encoding )
+static CvFileStorage*
+icvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags,
+                    const char* encoding, cv::FileNodeHandler* handler )
 {
     CvFileStorage* fs = 0;
     char* xml_buf = 0;
@@ -2703,6 +4215,7 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
     bool append = (flags & 3) == CV_STORAGE_APPEND;
     bool mem = (flags & CV_STORAGE_MEMORY) != 0;
     bool write_mode = (flags & 3) != 0;
+    bool binary = write_mode && (flags & CV_STORAGE_FORMAT_MASK) == CV_STORAGE_FORMAT_BINARY;
     bool isGZ = false;
     size_t fnamelen = 0;
 
@@ -2718,6 +4231,9 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
     if( mem && append )
         CV_Error( CV_StsBadFlag, "CV_STORAGE_APPEND and CV_STORAGE_MEMORY are not currently compatible" );
 
+    if( binary && (mem || append) )
+        CV_Error( CV_StsBadFlag, "The binary storage can only be written to a new file" );
+
     fs = (CvFileStorage*)cvAlloc( sizeof(*fs) );
     memset( fs, 0, sizeof(*fs));
 
@@ -2748,7 +4264,7 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
 
         if( !isGZ )
         {
-            fs->file = fopen(fs->filename, !fs->write_mode ? "rt" : !append ? "wt" : "a+t" );
+            fs->file = fopen(fs->filename, !fs->write_mode ? "rt" : binary ? "wb" : !append ? "wt" : "a+t" );
             if( !fs->file )
                 goto _exit_;
         }
@@ -2776,6 +4292,7 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
 
         if( mem )
             fs->outbuf = new std::deque<char>;
+        fs->base64 = (flags & CV_STORAGE_BASE64) != 0;
 
         if( fmt == CV_STORAGE_FORMAT_AUTO && filename )
         {
@@ -2866,6 +4383,21 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
             fs->write_comment = icvXMLWriteComment;
             fs->start_next_stream = icvXMLStartNextStream;
         }
+        else if( fs->fmt == CV_STORAGE_FORMAT_BINARY )
+        {
+            CvBinHeader header;
+            memcpy( header.signature, CV_BIN_SIGNATURE, CV_BIN_SIGNATURE_LEN );
+            header.byte_order = CV_BIN_BYTE_ORDER;
+            header.reserved = 0;
+            icvBinPut( fs, &header, sizeof(header) );
+            fs->start_write_struct = icvBinStartWriteStruct;
+            fs->end_write_struct = icvBinEndWriteStruct;
+            fs->write_int = icvBinWriteInt;
+            fs->write_real = icvBinWriteReal;
+            fs->write_string = icvBinWriteString;
+            fs->write_comment = icvBinWriteComment;
+            fs->start_next_stream = icvBinStartNextStream;
+        }
         else
         {
             if( !append )
@@ -2896,6 +4428,29 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
         fs->fmt = strncmp( buf, yaml_signature, strlen(yaml_signature) ) == 0 ?
             CV_STORAGE_FORMAT_YAML : CV_STORAGE_FORMAT_XML;
 
+        if( strncmp( buf, CV_BIN_SIGNATURE, CV_BIN_SIGNATURE_LEN ) == 0 )
+        {
+            if( mem )
+                CV_Error( CV_StsBadArg, "The binary storage can not be read from a string" );
+            fs->fmt = CV_STORAGE_FORMAT_BINARY;
+            icvRewind(fs);
+            fs->str_hash = cvCreateMap( 0, sizeof(CvStringHash),
+                            sizeof(CvStringHashNode), fs->memstorage, 256 );
+            fs->roots = cvCreateSeq( 0, sizeof(CvSeq),
+                            sizeof(CvFileNode), fs->memstorage );
+            // the matrices are read directly from the file contents, so no text buffer is needed
+            icvBinParse( fs );
+            if( handler )
+            {
+                fs->handler = handler;
+                for( int i = 0; i < fs->roots->total; i++ )
+                    icvFSStreamTree( fs, "", (CvFileNode*)cvGetSeqElem( fs->roots, i ) );
+                fs->handler = 0;
+            }
+            fs->is_opened = true;
+            goto _exit_;
+        }
+
         if( !isGZ )
         {
             if( !mem )
@@ -2910,8 +4465,17 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
         }
         icvRewind(fs);
 
-        fs->str_hash = cvCreateMap( 0, sizeof(CvStringHash),
-                        sizeof(CvStringHashNode), fs->memstorage, 256 );
+        if( handler )
+        {
+            // the keys and the stream state are kept apart from the rolled back storage
+            fs->handler = handler;
+            fs->strstorage = cvCreateMemStorage( 0 );
+            fs->stream_stack = cvCreateSeq( 0, sizeof(CvSeq),
+                            sizeof(CvFSStreamRecord), fs->strstorage );
+        }
+
+        fs->str_hash = cvCreateMap( 0, sizeof(CvStringHash), sizeof(CvStringHashNode),
+                        fs->strstorage ? fs->strstorage : fs->memstorage, 256 );
 
         fs->roots = cvCreateSeq( 0, sizeof(CvSeq),
                         sizeof(CvFileNode), fs->memstorage );
@@ -2927,6 +4491,7 @@ cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, co
             icvXMLParse( fs );
         else
             icvYMLParse( fs );
+        fs->handler = 0;
         //cvSetErrMode( mode );
 
         // release resources that we do not need anymore
@@ -2960,6 +4525,13 @@ _exit_:
 }
 
 
+CV_IMPL CvFileStorage*
+cvOpenFileStorage( const char* filename, CvMemStorage* dststorage, int flags, const char* encoding )
+{
+    return icvOpenFileStorage( filename, dststorage, flags, encoding, 0 );
+}
+
+
 CV_IMPL void
 cvStartWriteStruct( CvFileStorage* fs, const char* key, int struct_flags,
                     const char* type_name, CvAttrList /*attributes*/ )
@@ -3018,7 +4590,6 @@ cvStartNextStream( CvFileStorage* fs )
 
 
 static const char icvTypeSymbol[] = "ucwsifdr";
-#define CV_FS_MAX_FMT_PAIRS  128
 
 static char*
 icvEncodeFormat( int elem_type, char* dt )
@@ -3124,6 +4695,37 @@ icvDecodeSimpleFormat( const char* dt )
 }
 
 
+/* writes the records as base64 chunks; returns 0 if a single record does not fit into a chunk */
+static int
+icvWriteRawDataBase64( CvFileStorage* fs, const char* data, int len, const char* dt,
+                       const int* fmt_pairs, int fmt_pair_count )
+{
+    int stride, extent, comps;
+    char buf[CV_FS_MAX_LEN+16];
+    int header_len = (int)(sizeof(icvBase64Prefix) - 1 + strlen(dt) + 1);
+    if( header_len > 256 )
+        return 0;
+
+    icvCalcRawLayout( fmt_pairs, fmt_pair_count, &stride, &extent, &comps );
+    int max_size = (CV_FS_MAX_LEN - 256 - header_len)/4*3;
+    if( max_size < extent )
+        return 0;
+    int max_records = (max_size - extent)/stride + 1;
+
+    sprintf( buf, "%s%s$", icvBase64Prefix, dt );
+    while( len > 0 )
+    {
+        int n = MIN( len, max_records );
+        int size = (n - 1)*stride + extent;
+        icvBase64Encode( (const uchar*)data, size, buf + header_len );
+        fs->write_string( fs, 0, buf, 1 );
+        data += n*stride;
+        len -= n;
+    }
+    return 1;
+}
+
+
 CV_IMPL void
 cvWriteRawData( CvFileStorage* fs, const void* _data, int len, const char* dt )
 {
@@ -3145,6 +4747,15 @@ cvWriteRawData( CvFileStorage* fs, const void* _data, int len, const char* dt )
     if( !data0 )
         CV_Error( CV_StsNullPtr, "Null data pointer" );
 
+    if( fs->fmt == CV_STORAGE_FORMAT_BINARY )
+    {
+        icvBinWriteRawData( fs, data0, len, dt, fmt_pairs, fmt_pair_count );
+        return;
+    }
+
+    if( fs->base64 && icvWriteRawDataBase64( fs, data0, len, dt, fmt_pairs, fmt_pair_count ) )
+        return;
+
     if( fmt_pair_count == 1 )
     {
         fmt_pairs[0] *= len;
@@ -3239,6 +4850,7 @@ cvStartReadRawData( const CvFileStorage* fs, const CvFileNode* src, CvSeqReader*
     }
     else if( node_type == CV_NODE_SEQ )
     {
+        icvFSExpandRawSeq( src );
         cvStartReadSeq( src->data.seq, reader, 0 );
     }
     else if( node_type == CV_NODE_NONE )
@@ -3408,6 +5020,10 @@ cvReadRawData( const CvFileStorage* fs, const CvFileNode* src,
     if( !src || !data )
         CV_Error( CV_StsNullPtr, "Null pointers to source file node or destination array" );
 
+    if( CV_NODE_IS_SEQ(src->tag) && (src->data.seq->flags & CV_NODE_SEQ_RAW) &&
+        icvBinReadRawSeq( (const CvFileRawSeq*)src->data.seq, data, dt ) )
+        return;
+
     cvStartReadRawData( fs, src, &reader );
     cvReadRawDataSlice( fs, &reader, CV_NODE_IS_SEQ(src->tag) ?
                         src->data.seq->total : 1, data, dt );
@@ -3425,6 +5041,7 @@ icvWriteCollection( CvFileStorage* fs, const CvFileNode* node )
     int is_map = CV_NODE_IS_MAP(node->tag);
     CvSeqReader reader;
 
+    icvFSExpandRawSeq( node );
     cvStartReadSeq( node->data.seq, &reader, 0 );
 
     for( i = 0; i < total; i++ )
@@ -5215,6 +6832,21 @@ void FileStorage::release()
     state = UNDEFINED;
 }
 
+void FileStorage::flush()
+{
+    CvFileStorage* _fs = fs.obj;
+    if( !isOpened() || !_fs->write_mode )
+        return;
+    if( _fs->fmt != CV_STORAGE_FORMAT_BINARY )
+        icvFSFlush( _fs );
+    if( _fs->file )
+        fflush( _fs->file );
+#if USE_ZLIB
+    else if( _fs->gzfile )
+        gzflush( _fs->gzfile, Z_SYNC_FLUSH );
+#endif
+}
+
 string FileStorage::releaseAndGetString()
 {
     string buf;
@@ -5231,6 +6863,63 @@ FileNode FileStorage::root(int streamidx) const
     return isOpened() ? FileNode(fs, cvGetRootFileNode(fs, streamidx)) : FileNode();
 }
 
+FileNodeHandler::~FileNodeHandler() {}
+
+bool FileNodeHandler::startCollection(const string&, int, const string& typeName)
+{
+    return typeName.empty();
+}
+
+void FileNodeHandler::endCollection() {}
+
+void FileNodeHandler::node(const string&, const FileNode&) {}
+
+FileNodeWriter::FileNodeWriter(FileStorage& _fs, int _flushLevel)
+    : fs(&_fs), level(0), flushLevel(_flushLevel), nstreams(0)
+{
+    CV_Assert( fs->isOpened() && (**fs)->write_mode );
+}
+
+bool FileNodeWriter::startCollection(const string& name, int type, const string& typeName)
+{
+    // the top-level mappings are written implicitly
+    if( level == 0 )
+    {
+        if( nstreams++ > 0 )
+            cvStartNextStream( **fs );
+    }
+    else if( FileNodeHandler::startCollection(name, type, typeName) )
+        cvStartWriteStruct( **fs, !name.empty() ? name.c_str() : 0, type, 0 );
+    else
+        return false;
+    level++;
+    return true;
+}
+
+void FileNodeWriter::endCollection()
+{
+    if( --level > 0 )
+        cvEndWriteStruct( **fs );
+    if( level <= flushLevel )
+        fs->flush();
+}
+
+void FileNodeWriter::node(const string& name, const FileNode& node)
+{
+    cvWriteFileNode( **fs, !name.empty() ? name.c_str() : 0, *node, 0 );
+    if( level <= flushLevel )
+        fs->flush();
+}
+
+void readFileStorage(const string& source, FileNodeHandler& handler, int flags)
+{
+    CV_Assert( (flags & 3) == FileStorage::READ );
+    CvFileStorage* fs = icvOpenFileStorage( source.c_str(), 0, flags, 0, &handler );
+    if( !fs )
+        CV_Error_( CV_StsError, ("Can not open %s", source.c_str()) );
+    cvReleaseFileStorage( &fs );
+}
+
 FileStorage& operator << (FileStorage& fs, const string& str)
 {
     enum { NAME_EXPECTED = FileStorage::NAME_EXPECTED,
@@ -5331,6 +7020,8 @@ FileNode FileNode::operator[](const char* nodename) const
 
 FileNode FileNode::operator[](int i) const
 {
+    if( isSeq() )
+        icvFSExpandRawSeq( node );
     return isSeq() ? FileNode(fs, (CvFileNode*)cvGetSeqElem(node->data.seq, i)) :
         i == 0 ? *this : FileNode();
 }
@@ -5366,6 +7057,7 @@ FileNodeIterator::FileNodeIterator(const CvFileStorage* _fs,
         container = _node;
         if( !(_node->tag & FileNode::USER) && (node_type == FileNode::SEQ || node_type == FileNode::MAP) )
         {
+            icvFSExpandRawSeq( _node );
             cvStartReadSeq( _node->data.seq, &reader );
             remaining = FileNode(_fs, _node).size();
         }
@@ -5534,6 +7226,99 @@ WriteStructContext::WriteStructContext(FileStorage& _fs, const string& name,
 WriteStructContext::~WriteStructContext() { cvEndWriteStruct(**fs); }
 
 
+/* releases the file mapping when the last matrix that refers to it is released */
+class FileMappingAllocator : public MatAllocator
+{
+public:
+    void allocate(int dims, const int* sizes, int type, int*& refcount,
+                  uchar*& datastart, uchar*& data, size_t* step)
+    {
+        size_t total = CV_ELEM_SIZE(type);
+        for( int i = dims-1; i >= 0; i-- )
+        {
+            step[i] = total;
+            total *= sizes[i];
+        }
+        total = alignSize(total, (int)sizeof(*refcount));
+        data = datastart = (uchar*)fastMalloc(total + sizeof(*refcount)*2);
+        refcount = (int*)(data + total);
+        refcount[0] = 1;
+        refcount[1] = 0;
+    }
+
+    void deallocate(int* refcount, uchar* datastart, uchar* /*data*/)
+    {
+        if( refcount[1] == CV_FS_MAPPING_MAGIC )
+            icvFSFreeMapping( (CvFSMapping*)refcount );
+        else
+            fastFree(datastart);
+    }
+};
+
+/* makes the matrix header pointing to the data in the binary storage mapping */
+static bool icvFSAliasMat( const FileNode& node, Mat& mat )
+{
+    const CvFileStorage* fs = node.fs;
+    const CvFileNode* cvnode = *node;
+    if( !fs || fs->fmt != CV_STORAGE_FORMAT_BINARY || !fs->mapping ||
+        !(cvnode->tag & CV_NODE_USER) || !cvnode->info )
+        return false;
+
+    int sizes[CV_MAX_DIM], dims = 0;
+    const char* type_name = cvnode->info->type_name;
+    if( strcmp(type_name, CV_TYPE_NAME_MAT) == 0 )
+    {
+        dims = 2;
+        sizes[0] = (int)node["rows"];
+        sizes[1] = (int)node["cols"];
+    }
+    else if( strcmp(type_name, CV_TYPE_NAME_MATND) == 0 )
+    {
+        FileNode sizes_node = node["sizes"];
+        dims = (int)sizes_node.size();
+        if( dims <= 0 || dims > CV_MAX_DIM || !sizes_node.isSeq() )
+            return false;
+        cvReadRawData( fs, *sizes_node, sizes, "i" );
+    }
+    else
+        return false;
+
+    const CvFileNode* dt_node = cvGetFileNodeByName( fs, cvnode, "dt" );
+    const CvFileNode* data_node = cvGetFileNodeByName( fs, cvnode, "data" );
+    if( !dt_node || !CV_NODE_IS_STRING(dt_node->tag) || !data_node ||
+        !CV_NODE_IS_SEQ(data_node->tag) || !(data_node->data.seq->flags & CV_NODE_SEQ_RAW) )
+        return false;
+
+    const CvFileRawSeq* seq = (const CvFileRawSeq*)data_node->data.seq;
+    if( seq->nchunks != 1 || strcmp(seq->dt, dt_node->data.str.ptr) != 0 )
+        return false;
+
+    int type = icvDecodeSimpleFormat( seq->dt );
+    size_t total = CV_ELEM_SIZE(type);
+    for( int i = 0; i < dims; i++ )
+    {
+        if( sizes[i] <= 0 )
+            return false;
+        total *= sizes[i];
+    }
+    const uchar* data = seq->chunks[0].data;
+    if( total != seq->chunks[0].size || ((size_t)data & (CV_ELEM_SIZE1(type) - 1)) != 0 )
+        return false;
+
+    // keep the existing buffer, so the data is copied into the preallocated matrix as before
+    if( mat.data && mat.type() == type && mat.dims == dims &&
+        std::equal(sizes, sizes + dims, mat.size.p) )
+        return false;
+
+    static FileMappingAllocator allocator;
+    Mat m(dims, sizes, type, (void*)data);
+    m.refcount = &fs->mapping->refcount;
+    m.allocator = &allocator;
+    CV_XADD(m.refcount, 1);
+    mat = m;
+    return true;
+}
+
 void read( const FileNode& node, Mat& mat, const Mat& default_mat )
 {
     if( node.empty() )
@@ -5541,6 +7326,8 @@ void read( const FileNode& node, Mat& mat, const Mat& default_mat )
         default_mat.copyTo(mat);
         return;
     }
+    if( icvFSAliasMat(node, mat) )
+        return;
     void* obj = cvRead((CvFileStorage*)node.fs, (CvFileNode*)*node);
     if(CV_IS_MAT_HDR_Z(obj))
     {
@@ -0,0 +1,447 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "precomp.hpp"
+#include "opencv2/core/shmem.hpp"
+
+#if !defined _TI66X && (defined __linux__ || defined __APPLE__)
+    #define HAVE_POSIX_SHM
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+namespace cv
+{
+
+#define CV_SHM_MAGIC  0x53484D31 /* 'SHM1' */
+#define CV_SHM_ALIGN  64
+
+#if defined __GNUC__
+    #define CV_SHM_CAS(addr, oldval, newval) __sync_bool_compare_and_swap((addr), (oldval), (newval))
+    #define CV_SHM_BARRIER() __sync_synchronize()
+#elif defined HAVE_POSIX_SHM
+    #error "SharedMatAllocator needs an atomic compare-and-swap for this compiler"
+#else
+    // no segment can be mapped without shared memory support, so no slot is ever claimed
+    #define CV_SHM_CAS(addr, oldval, newval) \
+        (CV_Error(CV_StsNotImplemented, "POSIX shared memory is not available on this platform"), false)
+    #define CV_SHM_BARRIER()
+#endif
+
+// the segment layout: ShmHeader, the ring of slot indices, then nslots of (ShmSlot header + data)
+struct ShmHeader
+{
+    int magic;
+    int nslots;
+    int nconsumers;
+    int reserved;
+    size_t slotSize;
+    size_t slotStep;
+    size_t slotsOfs;
+    // producer and per-consumer sequence numbers; only differences are meaningful, so they may wrap
+    volatile int head;
+    volatile int tail[SharedMatAllocator::MAX_CONSUMERS];
+};
+
+struct ShmSlot
+{
+    volatile int refcount;
+    int dims;
+    int type;
+    int size[CV_MAX_DIM];
+    size_t step[CV_MAX_DIM];
+};
+
+static inline size_t shmSlotDataOfs() { return alignSize(sizeof(ShmSlot), CV_SHM_ALIGN); }
+
+struct SharedMatAllocator::Impl
+{
+    Impl() : fd(-1), base(0), length(0), owner(false), hint(0) {}
+
+    ShmHeader* header() const { return (ShmHeader*)base; }
+    int* ring() const { return (int*)(base + sizeof(ShmHeader)); }
+    ShmSlot* slot(int i) const
+    {
+        const ShmHeader* h = header();
+        return (ShmSlot*)(base + h->slotsOfs + h->slotStep*i);
+    }
+    uchar* slotData(int i) const { return (uchar*)slot(i) + shmSlotDataOfs(); }
+
+    string name;
+    int fd;
+    uchar* base;
+    size_t length;
+    bool owner;
+    int hint;
+};
+
+static string shmName(const string& name)
+{
+    CV_Assert( !name.empty() );
+    return name[0] == '/' ? name : "/" + name;
+}
+
+SharedMatAllocator::SharedMatAllocator() : impl(new Impl)
+{
+}
+
+SharedMatAllocator::SharedMatAllocator(const string& name, int nslots, size_t _slotSize, int nconsumers)
+    : impl(new Impl)
+{
+    create(name, nslots, _slotSize, nconsumers);
+}
+
+SharedMatAllocator::SharedMatAllocator(const string& name) : impl(new Impl)
+{
+    open(name);
+}
+
+SharedMatAllocator::~SharedMatAllocator()
+{
+    close();
+    delete impl;
+}
+
+bool SharedMatAllocator::isOpened() const
+{
+    return impl->base != 0;
+}
+
+#ifdef HAVE_POSIX_SHM
+
+void SharedMatAllocator::create(const string& name, int nslots, size_t _slotSize, int nconsumers)
+{
+    CV_Assert( nslots > 0 && _slotSize > 0 && 0 < nconsumers && nconsumers <= MAX_CONSUMERS );
+    close();
+
+    string sname = shmName(name);
+    size_t slotStep = shmSlotDataOfs() + alignSize(_slotSize, CV_SHM_ALIGN);
+    size_t slotsOfs = alignSize(sizeof(ShmHeader) + nslots*sizeof(int), CV_SHM_ALIGN);
+    size_t length = slotsOfs + slotStep*nslots;
+
+    // a stale segment left by a crashed producer would have inconsistent counters
+    shm_unlink(sname.c_str());
+    int fd = shm_open(sname.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if( fd < 0 )
+        CV_Error_(CV_StsError, ("Can not create the shared memory segment %s", sname.c_str()));
+    if( ftruncate(fd, (off_t)length) != 0 )
+    {
+        ::close(fd);
+        shm_unlink(sname.c_str());
+        CV_Error_(CV_StsNoMem, ("Can not resize the shared memory segment %s to %lu bytes",
+                                sname.c_str(), (unsigned long)length));
+    }
+    void* ptr = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( ptr == MAP_FAILED )
+    {
+        ::close(fd);
+        shm_unlink(sname.c_str());
+        CV_Error_(CV_StsError, ("Can not map the shared memory segment %s", sname.c_str()));
+    }
+
+    impl->name = sname;
+    impl->fd = fd;
+    impl->base = (uchar*)ptr;
+    impl->length = length;
+    impl->owner = true;
+    impl->hint = 0;
+
+    // ftruncate() zero-fills the segment, so all the counters and slot headers start cleared
+    ShmHeader* h = impl->header();
+    h->nslots = nslots;
+    h->nconsumers = nconsumers;
+    h->slotSize = _slotSize;
+    h->slotStep = slotStep;
+    h->slotsOfs = slotsOfs;
+    CV_SHM_BARRIER();
+    h->magic = CV_SHM_MAGIC;
+}
+
+void SharedMatAllocator::open(const string& name)
+{
+    close();
+
+    string sname = shmName(name);
+    int fd = shm_open(sname.c_str(), O_RDWR, 0600);
+    if( fd < 0 )
+        CV_Error_(CV_StsError, ("Can not open the shared memory segment %s", sname.c_str()));
+    struct stat st;
+    void* ptr = MAP_FAILED;
+    if( fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmHeader) )
+        ptr = mmap(0, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( ptr == MAP_FAILED )
+    {
+        ::close(fd);
+        CV_Error_(CV_StsError, ("Can not map the shared memory segment %s", sname.c_str()));
+    }
+
+    impl->name = sname;
+    impl->fd = fd;
+    impl->base = (uchar*)ptr;
+    impl->length = (size_t)st.st_size;
+    impl->owner = false;
+    impl->hint = 0;
+
+    const ShmHeader* h = impl->header();
+    if( h->magic != CV_SHM_MAGIC || h->slotsOfs + h->slotStep*h->nslots > impl->length )
+    {
+        close();
+        CV_Error_(CV_StsParseError, ("%s is not a shared matrix segment or it is not initialized yet",
+                                     sname.c_str()));
+    }
+    CV_SHM_BARRIER();
+}
+
+void SharedMatAllocator::close()
+{
+    if( impl->base )
+        munmap(impl->base, impl->length);
+    if( impl->fd >= 0 )
+        ::close(impl->fd);
+    if( impl->owner )
+        shm_unlink(impl->name.c_str());
+    impl->base = 0;
+    impl->length = 0;
+    impl->fd = -1;
+    impl->owner = false;
+    impl->name.clear();
+}
+
+#else
+
+void SharedMatAllocator::create(const string&, int, size_t, int)
+{
+    CV_Error(CV_StsNotImplemented, "POSIX shared memory is not available on this platform");
+}
+
+void SharedMatAllocator::open(const string&)
+{
+    CV_Error(CV_StsNotImplemented, "POSIX shared memory is not available on this platform");
+}
+
+void SharedMatAllocator::close()
+{
+}
+
+#endif
+
+int SharedMatAllocator::slots() const
+{
+    return impl->base ? impl->header()->nslots : 0;
+}
+
+size_t SharedMatAllocator::slotSize() const
+{
+    return impl->base ? impl->header()->slotSize : 0;
+}
+
+int SharedMatAllocator::consumers() const
+{
+    return impl->base ? impl->header()->nconsumers : 0;
+}
+
+int SharedMatAllocator::slotIndex(const Mat& m) const
+{
+    if( !impl->base || !m.datastart || m.datastart < impl->base ||
+        m.datastart >= impl->base + impl->length )
+        return -1;
+    const ShmHeader* h = impl->header();
+    size_t ofs = (size_t)(m.datastart - impl->base);
+    if( ofs < h->slotsOfs )
+        return -1;
+    int idx = (int)((ofs - h->slotsOfs)/h->slotStep);
+    return idx < h->nslots && m.datastart == impl->slotData(idx) ? idx : -1;
+}
+
+Mat SharedMatAllocator::attach(int idx)
+{
+    CV_Assert( isOpened() && 0 <= idx && idx < impl->header()->nslots );
+    ShmSlot* s = impl->slot(idx);
+    if( CV_XADD((int*)&s->refcount, 1) <= 0 )
+    {
+        CV_XADD((int*)&s->refcount, -1);
+        CV_Error(CV_StsBadArg, "The slot does not contain a frame");
+    }
+
+    Mat m(s->dims, s->size, s->type, impl->slotData(idx), s->step);
+    m.refcount = (int*)&s->refcount;
+    m.allocator = this;
+    return m;
+}
+
+void SharedMatAllocator::allocate(int dims, const int* sizes, int type, int*& refcount,
+                                  uchar*& datastart, uchar*& data, size_t* step)
+{
+    CV_Assert( isOpened() && 0 < dims && dims <= CV_MAX_DIM );
+    ShmHeader* h = impl->header();
+
+    size_t total = CV_ELEM_SIZE(type);
+    for( int i = dims-1; i >= 0; i-- )
+    {
+        step[i] = total;
+        total *= sizes[i];
+    }
+    if( total > h->slotSize )
+        CV_Error_(CV_StsOutOfRange, ("The matrix (%lu bytes) does not fit the shared memory slot (%lu bytes)",
+                                     (unsigned long)total, (unsigned long)h->slotSize));
+
+    // grab any free slot, starting from the one after the last allocated,
+    // so that the slots are reused in round-robin order
+    int n = h->nslots, idx = -1;
+    for( int k = 0; k < n; k++ )
+    {
+        int i = (impl->hint + k) % n;
+        ShmSlot* s = impl->slot(i);
+        if( s->refcount == 0 && CV_SHM_CAS(&s->refcount, 0, 1) )
+        {
+            idx = i;
+            break;
+        }
+    }
+    if( idx < 0 )
+        CV_Error(CV_StsNoMem, "All the shared memory slots are in use");
+    impl->hint = (idx + 1) % n;
+
+    ShmSlot* s = impl->slot(idx);
+    s->dims = dims;
+    s->type = CV_MAT_TYPE(type);
+    for( int i = 0; i < dims; i++ )
+    {
+        s->size[i] = sizes[i];
+        s->step[i] = step[i];
+    }
+
+    refcount = (int*)&s->refcount;
+    datastart = data = impl->slotData(idx);
+}
+
+void SharedMatAllocator::deallocate(int* refcount, uchar* datastart, uchar*)
+{
+    // the slot becomes free as soon as the shared counter drops to zero,
+    // the mapping itself is kept until the allocator is closed
+    CV_DbgAssert( refcount && *refcount == 0 );
+    (void)refcount;
+    (void)datastart;
+}
+
+/////////////////////////////////////// SharedFrameRing ///////////////////////////////////////
+
+SharedFrameRing::SharedFrameRing()
+{
+}
+
+SharedFrameRing::SharedFrameRing(const Ptr<SharedMatAllocator>& _alloc) : alloc(_alloc)
+{
+    CV_Assert( !alloc.empty() && alloc->isOpened() );
+}
+
+Ptr<SharedMatAllocator> SharedFrameRing::allocator() const
+{
+    return alloc;
+}
+
+void SharedFrameRing::createFrame(int rows, int cols, int type, Mat& frame) const
+{
+    CV_Assert( !alloc.empty() );
+    frame.release();
+    frame.allocator = (MatAllocator*)alloc.obj;
+    frame.create(rows, cols, type);
+}
+
+bool SharedFrameRing::push(const Mat& frame)
+{
+    CV_Assert( !alloc.empty() && alloc->isOpened() );
+    int idx = alloc->slotIndex(frame);
+    CV_Assert( idx >= 0 && frame.refcount && frame.allocator == (MatAllocator*)alloc );
+
+    ShmHeader* h = alloc->impl->header();
+    int head = h->head, n = h->nconsumers;
+    for( int c = 0; c < n; c++ )
+        if( (unsigned)(head - h->tail[c]) >= (unsigned)h->nslots )
+            return false;
+
+    // each consumer gets its own reference; it is taken over by the header returned from pop()
+    alloc->impl->ring()[(unsigned)head % (unsigned)h->nslots] = idx;
+    CV_XADD(frame.refcount, n);
+    CV_SHM_BARRIER();
+    h->head = head + 1;
+    return true;
+}
+
+bool SharedFrameRing::pop(int consumer, Mat& frame)
+{
+    CV_Assert( !alloc.empty() && alloc->isOpened() );
+    ShmHeader* h = alloc->impl->header();
+    CV_Assert( 0 <= consumer && consumer < h->nconsumers );
+
+    int tail = h->tail[consumer];
+    if( tail == h->head )
+        return false;
+    CV_SHM_BARRIER();
+
+    int idx = alloc->impl->ring()[(unsigned)tail % (unsigned)h->nslots];
+    ShmSlot* s = alloc->impl->slot(idx);
+
+    // the header takes over the reference added by push(), so the counter is not incremented here
+    frame = Mat(s->dims, s->size, s->type, alloc->impl->slotData(idx), s->step);
+    frame.refcount = (int*)&s->refcount;
+    frame.allocator = alloc;
+
+    CV_SHM_BARRIER();
+    h->tail[consumer] = tail + 1;
+    return true;
+}
+
+int SharedFrameRing::pending(int consumer) const
+{
+    CV_Assert( !alloc.empty() && alloc->isOpened() );
+    const ShmHeader* h = alloc->impl->header();
+    CV_Assert( 0 <= consumer && consumer < h->nconsumers );
+    return (int)(unsigned)(h->head - h->tail[consumer]);
+}
+
+}
+
+/* End of file. */
@@ -0,0 +1,836 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "../precomp.hpp"
+#include "filter_avx2.hpp"
+
+#if CV_AVX2
+
+/////////////////////////////////// 8u-32s helpers ////////////////////////////////////
+
+// Zero-extends 32 bytes to 16-bit; lo gets bytes 0-7|16-23, hi gets bytes 8-15|24-31.
+static inline void load_8u16s_avx2(const uchar* src, __m256i& lo, __m256i& hi)
+{
+    __m256i x = _mm256_loadu_si256((const __m256i*)src), z = _mm256_setzero_si256();
+    hi = _mm256_unpackhi_epi8(x, z);
+    lo = _mm256_unpacklo_epi8(x, z);
+}
+
+// Accumulates the exact 32-bit products x*f of 16-bit values (same as the SSE2 mullo/mulhi pair).
+static inline void mulAdd_16s32s_avx2(__m256i x, __m256i f, __m256i& s0, __m256i& s1)
+{
+    __m256i lo = _mm256_mullo_epi16(x, f), hi = _mm256_mulhi_epi16(x, f);
+    s0 = _mm256_add_epi32(s0, _mm256_unpacklo_epi16(lo, hi));
+    s1 = _mm256_add_epi32(s1, _mm256_unpackhi_epi16(lo, hi));
+}
+
+// Stores 32 sums produced from load_8u16s_avx2 data in the original pixel order.
+static inline void store_32s_avx2(int* dst, __m256i s0, __m256i s1, __m256i s2, __m256i s3)
+{
+    _mm256_storeu_si256((__m256i*)dst, _mm256_permute2x128_si256(s0, s1, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 8), _mm256_permute2x128_si256(s2, s3, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 16), _mm256_permute2x128_si256(s0, s1, 0x31));
+    _mm256_storeu_si256((__m256i*)(dst + 24), _mm256_permute2x128_si256(s2, s3, 0x31));
+}
+
+static inline void store_16u32s_avx2(int* dst, __m256i x, __m256i y)
+{
+    __m256i z = _mm256_setzero_si256();
+    store_32s_avx2(dst, _mm256_unpacklo_epi16(x, z), _mm256_unpackhi_epi16(x, z),
+                   _mm256_unpacklo_epi16(y, z), _mm256_unpackhi_epi16(y, z));
+}
+
+static inline void store_16s32s_avx2(int* dst, __m256i x, __m256i y)
+{
+    store_32s_avx2(dst, _mm256_srai_epi32(_mm256_unpacklo_epi16(x, x), 16),
+                   _mm256_srai_epi32(_mm256_unpackhi_epi16(x, x), 16),
+                   _mm256_srai_epi32(_mm256_unpacklo_epi16(y, y), 16),
+                   _mm256_srai_epi32(_mm256_unpackhi_epi16(y, y), 16));
+}
+
+// 16 ints from two registers -> 16 saturated shorts in order.
+static inline void store_32s16s_avx2(short* dst, __m256i s0, __m256i s1)
+{
+    __m256i x = _mm256_permute4x64_epi64(_mm256_packs_epi32(s0, s1), 0xD8);
+    _mm256_storeu_si256((__m256i*)dst, x);
+}
+
+///////////////////////////////////// 8u-32s ////////////////////////////////////////
+
+int RowVec_8u32s_avx2(const uchar* _src, uchar* _dst, const int* kx, int ksize,
+                      bool symmetrical, int width, int cn )
+{
+    int i = 0, k;
+    int* dst = (int*)_dst;
+    __m256i z = _mm256_setzero_si256();
+
+    if( symmetrical && (ksize & 1) != 0 )
+    {
+        // fold the symmetrical taps; the integer sums are the same as the unfolded ones
+        int ksize2 = ksize/2;
+        const int* kc = kx + ksize2;
+        for( ; i <= width - 32; i += 32 )
+        {
+            const uchar* src = _src + i + ksize2*cn;
+            __m256i f = _mm256_set1_epi16((short)kc[0]), s0 = z, s1 = z, s2 = z, s3 = z;
+            __m256i x0, x1, y0, y1;
+
+            load_8u16s_avx2(src, x0, x1);
+            mulAdd_16s32s_avx2(x0, f, s0, s1);
+            mulAdd_16s32s_avx2(x1, f, s2, s3);
+
+            for( k = 1; k <= ksize2; k++ )
+            {
+                f = _mm256_set1_epi16((short)kc[k]);
+                load_8u16s_avx2(src - k*cn, x0, x1);
+                load_8u16s_avx2(src + k*cn, y0, y1);
+                mulAdd_16s32s_avx2(_mm256_add_epi16(x0, y0), f, s0, s1);
+                mulAdd_16s32s_avx2(_mm256_add_epi16(x1, y1), f, s2, s3);
+            }
+            store_32s_avx2(dst + i, s0, s1, s2, s3);
+        }
+    }
+    else
+    {
+        for( ; i <= width - 32; i += 32 )
+        {
+            const uchar* src = _src + i;
+            __m256i f, s0 = z, s1 = z, s2 = z, s3 = z, x0, x1;
+
+            for( k = 0; k < ksize; k++, src += cn )
+            {
+                f = _mm256_set1_epi16((short)kx[k]);
+                load_8u16s_avx2(src, x0, x1);
+                mulAdd_16s32s_avx2(x0, f, s0, s1);
+                mulAdd_16s32s_avx2(x1, f, s2, s3);
+            }
+            store_32s_avx2(dst + i, s0, s1, s2, s3);
+        }
+    }
+    return i;
+}
+
+
+int SymmRowSmallVec_8u32s_avx2(const uchar* src, uchar* _dst, const int* kx, int ksize,
+                               bool symmetrical, int width, int cn )
+{
+    int i = 0;
+    int* dst = (int*)_dst;
+    __m256i z = _mm256_setzero_si256();
+
+    if( ksize != 3 && ksize != 5 )
+        return 0;
+    src += (ksize/2)*cn;
+
+    if( symmetrical )
+    {
+        if( ksize == 3 )
+        {
+            if( kx[0] == 2 && kx[1] == 1 )
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x1, x2, y0, y1, y2;
+                    load_8u16s_avx2(src - cn, x0, y0);
+                    load_8u16s_avx2(src, x1, y1);
+                    load_8u16s_avx2(src + cn, x2, y2);
+                    x0 = _mm256_add_epi16(x0, _mm256_add_epi16(_mm256_add_epi16(x1, x1), x2));
+                    y0 = _mm256_add_epi16(y0, _mm256_add_epi16(_mm256_add_epi16(y1, y1), y2));
+                    store_16u32s_avx2(dst + i, x0, y0);
+                }
+            else if( kx[0] == -2 && kx[1] == 1 )
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x1, x2, y0, y1, y2;
+                    load_8u16s_avx2(src - cn, x0, y0);
+                    load_8u16s_avx2(src, x1, y1);
+                    load_8u16s_avx2(src + cn, x2, y2);
+                    x0 = _mm256_add_epi16(x0, _mm256_sub_epi16(x2, _mm256_add_epi16(x1, x1)));
+                    y0 = _mm256_add_epi16(y0, _mm256_sub_epi16(y2, _mm256_add_epi16(y1, y1)));
+                    store_16s32s_avx2(dst + i, x0, y0);
+                }
+            else
+            {
+                __m256i k0 = _mm256_set1_epi16((short)kx[0]), k1 = _mm256_set1_epi16((short)kx[1]);
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x1, x2, y0, y1, y2, s0 = z, s1 = z, s2 = z, s3 = z;
+                    load_8u16s_avx2(src - cn, x0, y0);
+                    load_8u16s_avx2(src, x1, y1);
+                    load_8u16s_avx2(src + cn, x2, y2);
+                    mulAdd_16s32s_avx2(x1, k0, s0, s1);
+                    mulAdd_16s32s_avx2(y1, k0, s2, s3);
+                    mulAdd_16s32s_avx2(_mm256_add_epi16(x0, x2), k1, s0, s1);
+                    mulAdd_16s32s_avx2(_mm256_add_epi16(y0, y2), k1, s2, s3);
+                    store_32s_avx2(dst + i, s0, s1, s2, s3);
+                }
+            }
+        }
+        else
+        {
+            if( kx[0] == -2 && kx[1] == 0 && kx[2] == 1 )
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x1, x2, y0, y1, y2;
+                    load_8u16s_avx2(src - cn*2, x0, y0);
+                    load_8u16s_avx2(src, x1, y1);
+                    load_8u16s_avx2(src + cn*2, x2, y2);
+                    x0 = _mm256_add_epi16(x0, _mm256_sub_epi16(x2, _mm256_add_epi16(x1, x1)));
+                    y0 = _mm256_add_epi16(y0, _mm256_sub_epi16(y2, _mm256_add_epi16(y1, y1)));
+                    store_16s32s_avx2(dst + i, x0, y0);
+                }
+            else
+            {
+                __m256i k0 = _mm256_set1_epi16((short)kx[0]), k1 = _mm256_set1_epi16((short)kx[1]),
+                        k2 = _mm256_set1_epi16((short)kx[2]);
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x1, x2, y0, y1, y2, s0 = z, s1 = z, s2 = z, s3 = z;
+                    load_8u16s_avx2(src - cn, x0, y0);
+                    load_8u16s_avx2(src, x1, y1);
+                    load_8u16s_avx2(src + cn, x2, y2);
+                    mulAdd_16s32s_avx2(x1, k0, s0, s1);
+                    mulAdd_16s32s_avx2(y1, k0, s2, s3);
+                    mulAdd_16s32s_avx2(_mm256_add_epi16(x0, x2), k1, s0, s1);
+                    mulAdd_16s32s_avx2(_mm256_add_epi16(y0, y2), k1, s2, s3);
+
+                    load_8u16s_avx2(src - cn*2, x0, y0);
+                    load_8u16s_avx2(src + cn*2, x2, y2);
+                    mulAdd_16s32s_avx2(_mm256_add_epi16(x0, x2), k2, s0, s1);
+                    mulAdd_16s32s_avx2(_mm256_add_epi16(y0, y2), k2, s2, s3);
+                    store_32s_avx2(dst + i, s0, s1, s2, s3);
+                }
+            }
+        }
+    }
+    else
+    {
+        if( ksize == 3 )
+        {
+            if( kx[0] == 0 && kx[1] == 1 )
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x2, y0, y2;
+                    load_8u16s_avx2(src + cn, x0, y0);
+                    load_8u16s_avx2(src - cn, x2, y2);
+                    store_16s32s_avx2(dst + i, _mm256_sub_epi16(x0, x2), _mm256_sub_epi16(y0, y2));
+                }
+            else
+            {
+                __m256i k1 = _mm256_set1_epi16((short)kx[1]);
+                for( ; i <= width - 32; i += 32, src += 32 )
+                {
+                    __m256i x0, x2, y0, y2, s0 = z, s1 = z, s2 = z, s3 = z;
+                    load_8u16s_avx2(src + cn, x0, y0);
+                    load_8u16s_avx2(src - cn, x2, y2);
+                    mulAdd_16s32s_avx2(_mm256_sub_epi16(x0, x2), k1, s0, s1);
+                    mulAdd_16s32s_avx2(_mm256_sub_epi16(y0, y2), k1, s2, s3);
+                    store_32s_avx2(dst + i, s0, s1, s2, s3);
+                }
+            }
+        }
+        else
+        {
+            __m256i k1 = _mm256_set1_epi16((short)kx[1]), k2 = _mm256_set1_epi16((short)kx[2]);
+            for( ; i <= width - 32; i += 32, src += 32 )
+            {
+                __m256i x0, x2, y0, y2, s0 = z, s1 = z, s2 = z, s3 = z;
+                load_8u16s_avx2(src + cn, x0, y0);
+                load_8u16s_avx2(src - cn, x2, y2);
+                mulAdd_16s32s_avx2(_mm256_sub_epi16(x0, x2), k1, s0, s1);
+                mulAdd_16s32s_avx2(_mm256_sub_epi16(y0, y2), k1, s2, s3);
+
+                load_8u16s_avx2(src + cn*2, x0, y0);
+                load_8u16s_avx2(src - cn*2, x2, y2);
+                mulAdd_16s32s_avx2(_mm256_sub_epi16(x0, x2), k2, s0, s1);
+                mulAdd_16s32s_avx2(_mm256_sub_epi16(y0, y2), k2, s2, s3);
+                store_32s_avx2(dst + i, s0, s1, s2, s3);
+            }
+        }
+    }
+
+    return i;
+}
+
+
+int SymmColumnVec_32s8u_avx2(const uchar** _src, uchar* dst, const float* ky, int ksize2,
+                             bool symmetrical, float delta, int width )
+{
+    const int** src = (const int**)_src;
+    const int *S, *S2;
+    int i = 0, k;
+    __m256 d8 = _mm256_set1_ps(delta);
+    __m256i perm = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    for( ; i <= width - 32; i += 32 )
+    {
+        __m256 f, s0, s1, s2, s3;
+        __m256i x0, x1, x2, x3;
+
+        if( symmetrical )
+        {
+            S = src[0] + i;
+            f = _mm256_set1_ps(ky[0]);
+            s0 = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)S)), f), d8);
+            s1 = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(S+8))), f), d8);
+            s2 = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(S+16))), f), d8);
+            s3 = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(S+24))), f), d8);
+
+            for( k = 1; k <= ksize2; k++ )
+            {
+                S = src[k] + i;
+                S2 = src[-k] + i;
+                f = _mm256_set1_ps(ky[k]);
+                x0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)S), _mm256_loadu_si256((const __m256i*)S2));
+                x1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(S+8)), _mm256_loadu_si256((const __m256i*)(S2+8)));
+                x2 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(S+16)), _mm256_loadu_si256((const __m256i*)(S2+16)));
+                x3 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(S+24)), _mm256_loadu_si256((const __m256i*)(S2+24)));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_cvtepi32_ps(x0), f));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_cvtepi32_ps(x1), f));
+                s2 = _mm256_add_ps(s2, _mm256_mul_ps(_mm256_cvtepi32_ps(x2), f));
+                s3 = _mm256_add_ps(s3, _mm256_mul_ps(_mm256_cvtepi32_ps(x3), f));
+            }
+        }
+        else
+        {
+            s0 = s1 = s2 = s3 = d8;
+            for( k = 1; k <= ksize2; k++ )
+            {
+                S = src[k] + i;
+                S2 = src[-k] + i;
+                f = _mm256_set1_ps(ky[k]);
+                x0 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)S), _mm256_loadu_si256((const __m256i*)S2));
+                x1 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(S+8)), _mm256_loadu_si256((const __m256i*)(S2+8)));
+                x2 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(S+16)), _mm256_loadu_si256((const __m256i*)(S2+16)));
+                x3 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(S+24)), _mm256_loadu_si256((const __m256i*)(S2+24)));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_cvtepi32_ps(x0), f));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_cvtepi32_ps(x1), f));
+                s2 = _mm256_add_ps(s2, _mm256_mul_ps(_mm256_cvtepi32_ps(x2), f));
+                s3 = _mm256_add_ps(s3, _mm256_mul_ps(_mm256_cvtepi32_ps(x3), f));
+            }
+        }
+
+        x0 = _mm256_packs_epi32(_mm256_cvtps_epi32(s0), _mm256_cvtps_epi32(s1));
+        x1 = _mm256_packs_epi32(_mm256_cvtps_epi32(s2), _mm256_cvtps_epi32(s3));
+        x0 = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(x0, x1), perm);
+        _mm256_storeu_si256((__m256i*)(dst + i), x0);
+    }
+
+    return i;
+}
+
+
+int SymmColumnSmallVec_32s16s_avx2(const uchar** _src, uchar* _dst, const float* ky,
+                                   bool symmetrical, float delta, int width )
+{
+    const int** src = (const int**)_src;
+    const int *S0 = src[-1], *S1 = src[0], *S2 = src[1];
+    short* dst = (short*)_dst;
+    int i = 0;
+    __m256 df8 = _mm256_set1_ps(delta);
+    __m256i d8 = _mm256_cvtps_epi32(df8);
+
+    if( symmetrical )
+    {
+        if( ky[0] == 2 && ky[1] == 1 )
+        {
+            for( ; i <= width - 16; i += 16 )
+            {
+                __m256i s0, s1, s2, s3, s4, s5;
+                s0 = _mm256_loadu_si256((const __m256i*)(S0 + i));
+                s1 = _mm256_loadu_si256((const __m256i*)(S0 + i + 8));
+                s2 = _mm256_loadu_si256((const __m256i*)(S1 + i));
+                s3 = _mm256_loadu_si256((const __m256i*)(S1 + i + 8));
+                s4 = _mm256_loadu_si256((const __m256i*)(S2 + i));
+                s5 = _mm256_loadu_si256((const __m256i*)(S2 + i + 8));
+                s0 = _mm256_add_epi32(s0, _mm256_add_epi32(s4, _mm256_add_epi32(s2, s2)));
+                s1 = _mm256_add_epi32(s1, _mm256_add_epi32(s5, _mm256_add_epi32(s3, s3)));
+                store_32s16s_avx2(dst + i, _mm256_add_epi32(s0, d8), _mm256_add_epi32(s1, d8));
+            }
+        }
+        else if( ky[0] == -2 && ky[1] == 1 )
+        {
+            for( ; i <= width - 16; i += 16 )
+            {
+                __m256i s0, s1, s2, s3, s4, s5;
+                s0 = _mm256_loadu_si256((const __m256i*)(S0 + i));
+                s1 = _mm256_loadu_si256((const __m256i*)(S0 + i + 8));
+                s2 = _mm256_loadu_si256((const __m256i*)(S1 + i));
+                s3 = _mm256_loadu_si256((const __m256i*)(S1 + i + 8));
+                s4 = _mm256_loadu_si256((const __m256i*)(S2 + i));
+                s5 = _mm256_loadu_si256((const __m256i*)(S2 + i + 8));
+                s0 = _mm256_add_epi32(s0, _mm256_sub_epi32(s4, _mm256_add_epi32(s2, s2)));
+                s1 = _mm256_add_epi32(s1, _mm256_sub_epi32(s5, _mm256_add_epi32(s3, s3)));
+                store_32s16s_avx2(dst + i, _mm256_add_epi32(s0, d8), _mm256_add_epi32(s1, d8));
+            }
+        }
+        else
+        {
+            __m256 k0 = _mm256_set1_ps(ky[0]), k1 = _mm256_set1_ps(ky[1]);
+            for( ; i <= width - 16; i += 16 )
+            {
+                __m256 s0, s1;
+                __m256i x0, x1;
+                s0 = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(S1 + i)));
+                s1 = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(S1 + i + 8)));
+                s0 = _mm256_add_ps(_mm256_mul_ps(s0, k0), df8);
+                s1 = _mm256_add_ps(_mm256_mul_ps(s1, k0), df8);
+                x0 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(S0 + i)),
+                                      _mm256_loadu_si256((const __m256i*)(S2 + i)));
+                x1 = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(S0 + i + 8)),
+                                      _mm256_loadu_si256((const __m256i*)(S2 + i + 8)));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_cvtepi32_ps(x0), k1));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_cvtepi32_ps(x1), k1));
+                store_32s16s_avx2(dst + i, _mm256_cvtps_epi32(s0), _mm256_cvtps_epi32(s1));
+            }
+        }
+    }
+    else
+    {
+        if( fabs(ky[1]) == 1 && ky[1] == -ky[-1] )
+        {
+            if( ky[1] < 0 )
+                std::swap(S0, S2);
+            for( ; i <= width - 16; i += 16 )
+            {
+                __m256i s0, s1, s2, s3;
+                s0 = _mm256_loadu_si256((const __m256i*)(S2 + i));
+                s1 = _mm256_loadu_si256((const __m256i*)(S2 + i + 8));
+                s2 = _mm256_loadu_si256((const __m256i*)(S0 + i));
+                s3 = _mm256_loadu_si256((const __m256i*)(S0 + i + 8));
+                s0 = _mm256_add_epi32(_mm256_sub_epi32(s0, s2), d8);
+                s1 = _mm256_add_epi32(_mm256_sub_epi32(s1, s3), d8);
+                store_32s16s_avx2(dst + i, s0, s1);
+            }
+        }
+        else
+        {
+            // same operand order as the SSE2 branch so both halves of a row match
+            __m256 k1 = _mm256_set1_ps(ky[1]);
+            for( ; i <= width - 16; i += 16 )
+            {
+                __m256 s0 = df8, s1 = df8;
+                __m256i x0, x1;
+                x0 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(S0 + i)),
+                                      _mm256_loadu_si256((const __m256i*)(S2 + i)));
+                x1 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(S0 + i + 8)),
+                                      _mm256_loadu_si256((const __m256i*)(S2 + i + 8)));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_cvtepi32_ps(x0), k1));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_cvtepi32_ps(x1), k1));
+                store_32s16s_avx2(dst + i, _mm256_cvtps_epi32(s0), _mm256_cvtps_epi32(s1));
+            }
+        }
+    }
+
+    return i;
+}
+
+/////////////////////////////////////// 16s //////////////////////////////////////////
+
+int RowVec_16s32f_avx2(const uchar* _src, uchar* _dst, const float* kx, int ksize,
+                       int width, int cn )
+{
+    int i = 0, k;
+    float* dst = (float*)_dst;
+
+    for( ; i <= width - 16; i += 16 )
+    {
+        const short* src = (const short*)_src + i;
+        __m256 f, s0 = _mm256_setzero_ps(), s1 = s0, x0, x1;
+        for( k = 0; k < ksize; k++, src += cn )
+        {
+            f = _mm256_set1_ps(kx[k]);
+            x0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)src)));
+            x1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + 8))));
+            s0 = _mm256_add_ps(s0, _mm256_mul_ps(x0, f));
+            s1 = _mm256_add_ps(s1, _mm256_mul_ps(x1, f));
+        }
+        _mm256_storeu_ps(dst + i, s0);
+        _mm256_storeu_ps(dst + i + 8, s1);
+    }
+    return i;
+}
+
+
+int SymmColumnVec_32f16s_avx2(const uchar** _src, uchar* _dst, const float* ky, int ksize2,
+                              bool symmetrical, float delta, int width )
+{
+    const float** src = (const float**)_src;
+    const float *S, *S2;
+    short* dst = (short*)_dst;
+    int i = 0, k;
+    __m256 d8 = _mm256_set1_ps(delta);
+
+    for( ; i <= width - 16; i += 16 )
+    {
+        __m256 f, s0, s1, x0, x1;
+
+        if( symmetrical )
+        {
+            S = src[0] + i;
+            f = _mm256_set1_ps(ky[0]);
+            s0 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S), f), d8);
+            s1 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S+8), f), d8);
+
+            for( k = 1; k <= ksize2; k++ )
+            {
+                S = src[k] + i;
+                S2 = src[-k] + i;
+                f = _mm256_set1_ps(ky[k]);
+                x0 = _mm256_add_ps(_mm256_loadu_ps(S), _mm256_loadu_ps(S2));
+                x1 = _mm256_add_ps(_mm256_loadu_ps(S+8), _mm256_loadu_ps(S2+8));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(x0, f));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(x1, f));
+            }
+        }
+        else
+        {
+            s0 = s1 = d8;
+            for( k = 1; k <= ksize2; k++ )
+            {
+                S = src[k] + i;
+                S2 = src[-k] + i;
+                f = _mm256_set1_ps(ky[k]);
+                x0 = _mm256_sub_ps(_mm256_loadu_ps(S), _mm256_loadu_ps(S2));
+                x1 = _mm256_sub_ps(_mm256_loadu_ps(S+8), _mm256_loadu_ps(S2+8));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(x0, f));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(x1, f));
+            }
+        }
+
+        store_32s16s_avx2(dst + i, _mm256_cvtps_epi32(s0), _mm256_cvtps_epi32(s1));
+    }
+
+    return i;
+}
+
+/////////////////////////////////////// 32f //////////////////////////////////////////
+
+int RowVec_32f_avx2(const uchar* _src, uchar* _dst, const float* kx, int ksize,
+                    int width, int cn )
+{
+    int i = 0, k;
+    const float* src0 = (const float*)_src;
+    float* dst = (float*)_dst;
+
+    for( ; i <= width - 16; i += 16 )
+    {
+        const float* src = src0 + i;
+        __m256 f, s0 = _mm256_setzero_ps(), s1 = s0;
+        for( k = 0; k < ksize; k++, src += cn )
+        {
+            f = _mm256_set1_ps(kx[k]);
+            s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(src), f));
+            s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(src + 8), f));
+        }
+        _mm256_storeu_ps(dst + i, s0);
+        _mm256_storeu_ps(dst + i + 8, s1);
+    }
+    return i;
+}
+
+
+int SymmRowSmallVec_32f_avx2(const uchar* _src, uchar* _dst, const float* kx, int ksize,
+                             bool symmetrical, int width, int cn )
+{
+    int i = 0;
+    float* dst = (float*)_dst;
+    const float* src = (const float*)_src + (ksize/2)*cn;
+
+    if( ksize != 3 && ksize != 5 )
+        return 0;
+
+    if( symmetrical )
+    {
+        if( ksize == 3 )
+        {
+            if( kx[0] == 2 && kx[1] == 1 )
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_loadu_ps(src - cn), x1 = _mm256_loadu_ps(src),
+                           x2 = _mm256_loadu_ps(src + cn);
+                    x0 = _mm256_add_ps(x0, _mm256_add_ps(_mm256_add_ps(x1, x1), x2));
+                    _mm256_storeu_ps(dst + i, x0);
+                }
+            else if( kx[0] == -2 && kx[1] == 1 )
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_loadu_ps(src - cn), x1 = _mm256_loadu_ps(src),
+                           x2 = _mm256_loadu_ps(src + cn);
+                    x0 = _mm256_add_ps(x0, _mm256_sub_ps(x2, _mm256_add_ps(x1, x1)));
+                    _mm256_storeu_ps(dst + i, x0);
+                }
+            else
+            {
+                __m256 k0 = _mm256_set1_ps(kx[0]), k1 = _mm256_set1_ps(kx[1]);
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_loadu_ps(src - cn), x1 = _mm256_loadu_ps(src),
+                           x2 = _mm256_loadu_ps(src + cn);
+                    x0 = _mm256_mul_ps(_mm256_add_ps(x0, x2), k1);
+                    x0 = _mm256_add_ps(x0, _mm256_mul_ps(x1, k0));
+                    _mm256_storeu_ps(dst + i, x0);
+                }
+            }
+        }
+        else
+        {
+            if( kx[0] == -2 && kx[1] == 0 && kx[2] == 1 )
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_loadu_ps(src - cn*2), x1 = _mm256_loadu_ps(src),
+                           x2 = _mm256_loadu_ps(src + cn*2);
+                    x0 = _mm256_add_ps(x0, _mm256_sub_ps(x2, _mm256_add_ps(x1, x1)));
+                    _mm256_storeu_ps(dst + i, x0);
+                }
+            else
+            {
+                __m256 k0 = _mm256_set1_ps(kx[0]), k1 = _mm256_set1_ps(kx[1]), k2 = _mm256_set1_ps(kx[2]);
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_loadu_ps(src - cn), x1 = _mm256_loadu_ps(src),
+                           x2 = _mm256_loadu_ps(src + cn);
+                    x0 = _mm256_mul_ps(_mm256_add_ps(x0, x2), k1);
+                    x0 = _mm256_add_ps(x0, _mm256_mul_ps(x1, k0));
+                    x2 = _mm256_add_ps(_mm256_loadu_ps(src + cn*2), _mm256_loadu_ps(src - cn*2));
+                    x0 = _mm256_add_ps(x0, _mm256_mul_ps(x2, k2));
+                    _mm256_storeu_ps(dst + i, x0);
+                }
+            }
+        }
+    }
+    else
+    {
+        if( ksize == 3 )
+        {
+            if( kx[0] == 0 && kx[1] == 1 )
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_sub_ps(_mm256_loadu_ps(src + cn), _mm256_loadu_ps(src - cn));
+                    _mm256_storeu_ps(dst + i, x0);
+                }
+            else
+            {
+                __m256 k1 = _mm256_set1_ps(kx[1]);
+                for( ; i <= width - 8; i += 8, src += 8 )
+                {
+                    __m256 x0 = _mm256_sub_ps(_mm256_loadu_ps(src + cn), _mm256_loadu_ps(src - cn));
+                    _mm256_storeu_ps(dst + i, _mm256_mul_ps(x0, k1));
+                }
+            }
+        }
+        else
+        {
+            __m256 k1 = _mm256_set1_ps(kx[1]), k2 = _mm256_set1_ps(kx[2]);
+            for( ; i <= width - 8; i += 8, src += 8 )
+            {
+                __m256 x0, x2;
+                x0 = _mm256_sub_ps(_mm256_loadu_ps(src + cn), _mm256_loadu_ps(src - cn));
+                x0 = _mm256_mul_ps(x0, k1);
+                x2 = _mm256_sub_ps(_mm256_loadu_ps(src + cn*2), _mm256_loadu_ps(src - cn*2));
+                x0 = _mm256_add_ps(x0, _mm256_mul_ps(x2, k2));
+                _mm256_storeu_ps(dst + i, x0);
+            }
+        }
+    }
+
+    return i;
+}
+
+
+int SymmColumnVec_32f_avx2(const uchar** _src, uchar* _dst, const float* ky, int ksize2,
+                           bool symmetrical, float delta, int width )
+{
+    const float** src = (const float**)_src;
+    const float *S, *S2;
+    float* dst = (float*)_dst;
+    int i = 0, k;
+    __m256 d8 = _mm256_set1_ps(delta);
+
+    for( ; i <= width - 32; i += 32 )
+    {
+        __m256 f, s0, s1, s2, s3, x0, x1;
+
+        if( symmetrical )
+        {
+            S = src[0] + i;
+            f = _mm256_set1_ps(ky[0]);
+            s0 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S), f), d8);
+            s1 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S+8), f), d8);
+            s2 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S+16), f), d8);
+            s3 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S+24), f), d8);
+
+            for( k = 1; k <= ksize2; k++ )
+            {
+                S = src[k] + i;
+                S2 = src[-k] + i;
+                f = _mm256_set1_ps(ky[k]);
+                x0 = _mm256_add_ps(_mm256_loadu_ps(S), _mm256_loadu_ps(S2));
+                x1 = _mm256_add_ps(_mm256_loadu_ps(S+8), _mm256_loadu_ps(S2+8));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(x0, f));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(x1, f));
+                x0 = _mm256_add_ps(_mm256_loadu_ps(S+16), _mm256_loadu_ps(S2+16));
+                x1 = _mm256_add_ps(_mm256_loadu_ps(S+24), _mm256_loadu_ps(S2+24));
+                s2 = _mm256_add_ps(s2, _mm256_mul_ps(x0, f));
+                s3 = _mm256_add_ps(s3, _mm256_mul_ps(x1, f));
+            }
+        }
+        else
+        {
+            s0 = s1 = s2 = s3 = d8;
+            for( k = 1; k <= ksize2; k++ )
+            {
+                S = src[k] + i;
+                S2 = src[-k] + i;
+                f = _mm256_set1_ps(ky[k]);
+                x0 = _mm256_sub_ps(_mm256_loadu_ps(S), _mm256_loadu_ps(S2));
+                x1 = _mm256_sub_ps(_mm256_loadu_ps(S+8), _mm256_loadu_ps(S2+8));
+                s0 = _mm256_add_ps(s0, _mm256_mul_ps(x0, f));
+                s1 = _mm256_add_ps(s1, _mm256_mul_ps(x1, f));
+                x0 = _mm256_sub_ps(_mm256_loadu_ps(S+16), _mm256_loadu_ps(S2+16));
+                x1 = _mm256_sub_ps(_mm256_loadu_ps(S+24), _mm256_loadu_ps(S2+24));
+                s2 = _mm256_add_ps(s2, _mm256_mul_ps(x0, f));
+                s3 = _mm256_add_ps(s3, _mm256_mul_ps(x1, f));
+            }
+        }
+
+        _mm256_storeu_ps(dst + i, s0);
+        _mm256_storeu_ps(dst + i + 8, s1);
+        _mm256_storeu_ps(dst + i + 16, s2);
+        _mm256_storeu_ps(dst + i + 24, s3);
+    }
+
+    return i;
+}
+
+
+int SymmColumnSmallVec_32f_avx2(const uchar** _src, uchar* _dst, const float* ky,
+                                bool symmetrical, float delta, int width )
+{
+    const float** src = (const float**)_src;
+    const float *S0 = src[-1], *S1 = src[0], *S2 = src[1];
+    float* dst = (float*)_dst;
+    int i = 0;
+    __m256 d8 = _mm256_set1_ps(delta);
+
+    if( symmetrical )
+    {
+        if( ky[0] == 2 && ky[1] == 1 )
+        {
+            for( ; i <= width - 8; i += 8 )
+            {
+                __m256 s0 = _mm256_loadu_ps(S0 + i), s1 = _mm256_loadu_ps(S1 + i),
+                       s2 = _mm256_loadu_ps(S2 + i);
+                s0 = _mm256_add_ps(s0, _mm256_add_ps(s2, _mm256_add_ps(s1, s1)));
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(s0, d8));
+            }
+        }
+        else if( ky[0] == -2 && ky[1] == 1 )
+        {
+            for( ; i <= width - 8; i += 8 )
+            {
+                __m256 s0 = _mm256_loadu_ps(S0 + i), s1 = _mm256_loadu_ps(S1 + i),
+                       s2 = _mm256_loadu_ps(S2 + i);
+                s0 = _mm256_add_ps(s0, _mm256_sub_ps(s2, _mm256_add_ps(s1, s1)));
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(s0, d8));
+            }
+        }
+        else
+        {
+            __m256 k0 = _mm256_set1_ps(ky[0]), k1 = _mm256_set1_ps(ky[1]);
+            for( ; i <= width - 8; i += 8 )
+            {
+                __m256 s0, x0;
+                s0 = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(S1 + i), k0), d8);
+                x0 = _mm256_add_ps(_mm256_loadu_ps(S0 + i), _mm256_loadu_ps(S2 + i));
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(s0, _mm256_mul_ps(x0, k1)));
+            }
+        }
+    }
+    else
+    {
+        if( fabs(ky[1]) == 1 && ky[1] == -ky[-1] )
+        {
+            if( ky[1] < 0 )
+                std::swap(S0, S2);
+            for( ; i <= width - 8; i += 8 )
+            {
+                __m256 s0 = _mm256_sub_ps(_mm256_loadu_ps(S2 + i), _mm256_loadu_ps(S0 + i));
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(s0, d8));
+            }
+        }
+        else
+        {
+            __m256 k1 = _mm256_set1_ps(ky[1]);
+            for( ; i <= width - 8; i += 8 )
+            {
+                __m256 x0 = _mm256_sub_ps(_mm256_loadu_ps(S2 + i), _mm256_loadu_ps(S0 + i));
+                _mm256_storeu_ps(dst + i, _mm256_add_ps(d8, _mm256_mul_ps(x0, k1)));
+            }
+        }
+    }
+
+    return i;
+}
+#else
+int RowVec_8u32s_avx2(const uchar*, uchar*, const int*, int, bool, int, int ) { return 0; }
+
+int SymmRowSmallVec_8u32s_avx2(const uchar*, uchar*, const int*, int, bool, int, int ) { return 0; }
+
+int SymmColumnVec_32s8u_avx2(const uchar**, uchar*, const float*, int, bool, float, int ) { return 0; }
+
+int SymmColumnSmallVec_32s16s_avx2(const uchar**, uchar*, const float*, bool, float, int ) { return 0; }
+
+int RowVec_16s32f_avx2(const uchar*, uchar*, const float*, int, int, int ) { return 0; }
+
+int SymmColumnVec_32f16s_avx2(const uchar**, uchar*, const float*, int, bool, float, int ) { return 0; }
+
+int RowVec_32f_avx2(const uchar*, uchar*, const float*, int, int, int ) { return 0; }
+
+int SymmRowSmallVec_32f_avx2(const uchar*, uchar*, const float*, int, bool, int, int ) { return 0; }
+
+int SymmColumnVec_32f_avx2(const uchar**, uchar*, const float*, int, bool, float, int ) { return 0; }
+
+int SymmColumnSmallVec_32f_avx2(const uchar**, uchar*, const float*, bool, float, int ) { return 0; }
+#endif
+
+/* End of file. */
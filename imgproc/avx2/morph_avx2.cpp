@@ -0,0 +1,118 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "../precomp.hpp"
+#include "morph_avx2.hpp"
+
+#if CV_AVX2
+
+int BinaryCombineShifted_avx2(uint64* dst, const uint64* src, int shift, int nwords, int op )
+{
+    // a 64-bit shift count of 64 clears the lane, so shift == 0 needs no special case
+    __m128i sr = _mm_cvtsi32_si128(shift), sl = _mm_cvtsi32_si128(64 - shift);
+    int k = 0;
+
+    for( ; k <= nwords - 4; k += 4 )
+    {
+        __m256i w = _mm256_or_si256(_mm256_srl_epi64(_mm256_loadu_si256((const __m256i*)(src + k)), sr),
+                                    _mm256_sll_epi64(_mm256_loadu_si256((const __m256i*)(src + k + 1)), sl));
+        __m256i* d = (__m256i*)(dst + k);
+        if( op == 1 )
+            w = _mm256_and_si256(_mm256_loadu_si256(d), w);
+        else if( op == 2 )
+            w = _mm256_or_si256(_mm256_loadu_si256(d), w);
+        _mm256_storeu_si256(d, w);
+    }
+
+    return k;
+}
+
+int BinaryPackRow_avx2(const uchar* src, uint64* dst, int width, bool invert )
+{
+    __m256i z = _mm256_setzero_si256();
+    uint64 flip = invert ? 0 : ~(uint64)0;
+    int x = 0;
+
+    for( ; x <= width - 64; x += 64 )
+    {
+        // the masks have bits set for the zero pixels
+        uint64 m0 = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src + x)), z));
+        uint64 m1 = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src + x + 32)), z));
+        dst[x >> 6] = (m0 | (m1 << 32)) ^ flip;
+    }
+
+    return x;
+}
+
+int BinaryUnpackRow_avx2(const uint64* a, const uint64* b, int op, uchar* dst, int width )
+{
+    // every byte of a 32-bit chunk is copied to 8 bytes, which then test one bit each
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bits = _mm256_set1_epi64x((int64)0x8040201008040201LL);
+    int x = 0;
+
+    for( ; x <= width - 64; x += 64 )
+    {
+        uint64 w = a[x >> 6];
+        if( op == 1 )
+            w &= b[x >> 6];
+        else if( op == 3 )
+            w &= ~b[x >> 6];
+
+        __m256i v0 = _mm256_shuffle_epi8(_mm256_set1_epi32((int)w), spread);
+        __m256i v1 = _mm256_shuffle_epi8(_mm256_set1_epi32((int)(w >> 32)), spread);
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_cmpeq_epi8(_mm256_and_si256(v0, bits), bits));
+        _mm256_storeu_si256((__m256i*)(dst + x + 32), _mm256_cmpeq_epi8(_mm256_and_si256(v1, bits), bits));
+    }
+
+    return x;
+}
+#else
+int BinaryCombineShifted_avx2(uint64*, const uint64*, int, int, int ) { return 0; }
+
+int BinaryPackRow_avx2(const uchar*, uint64*, int, bool ) { return 0; }
+
+int BinaryUnpackRow_avx2(const uint64*, const uint64*, int, uchar*, int ) { return 0; }
+#endif
+
+/* End of file. */
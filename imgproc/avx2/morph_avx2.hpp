@@ -0,0 +1,61 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                        Intel License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of Intel Corporation may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef _CV_MORPH_AVX2_H_
+#define _CV_MORPH_AVX2_H_
+
+// Bit-packed binary morphology. The row is the bit string of src that starts at bit
+// shift (0..63) of src[0]; it is combined with dst word by word, op being 0 (copy),
+// 1 (and) or 2 (or). src[nwords] must be readable. Returns the number of words processed.
+
+int BinaryCombineShifted_avx2(uint64* dst, const uint64* src, int shift, int nwords, int op );
+
+// Packs the non-zero (or, with invert, the zero) pixels of src to bits, 64 pixels at a time.
+// Returns the number of pixels processed.
+int BinaryPackRow_avx2(const uchar* src, uint64* dst, int width, bool invert );
+
+// Expands a, a & b (op 1) or a & ~b (op 3) to 0/255 pixels, 64 pixels at a time.
+// Returns the number of pixels processed.
+int BinaryUnpackRow_avx2(const uint64* a, const uint64* b, int op, uchar* dst, int width );
+
+#endif
+
+/* End of file. */
@@ -86,165 +86,230 @@ static bool ippCanny(const Mat& _src, Mat& _dst, float low,  float high)
 }
 #endif
 
-void cv::Canny( InputArray _src, OutputArray _dst,
-                double low_thresh, double high_thresh,
-                int aperture_size, bool L2gradient )
+namespace cv
 {
-    Mat src = _src.getMat();
-    CV_Assert( src.depth() == CV_8U );
 
-    _dst.create(src.size(), CV_8U);
-    Mat dst = _dst.getMat();
+/* sector numbers
+   (Top-Left Origin)
 
-    if (!L2gradient && (aperture_size & CV_CANNY_L2_GRADIENT) == CV_CANNY_L2_GRADIENT)
-    {
-        //backward compatibility
-        aperture_size &= ~CV_CANNY_L2_GRADIENT;
-        L2gradient = true;
-    }
-
-    if ((aperture_size & 1) == 0 || (aperture_size != -1 && (aperture_size < 3 || aperture_size > 7)))
-        CV_Error(CV_StsBadFlag, "");
+    1   2   3
+     *  *  *
+      * * *
+    0*******0
+      * * *
+     *  *  *
+    3   2   1
+*/
 
-    if (low_thresh > high_thresh)
-        std::swap(low_thresh, high_thresh);
+#define CANNY_PUSH(d)    *(d) = uchar(2), stack.push_back(d)
+#define CANNY_SHIFT 15
 
-#ifdef HAVE_TEGRA_OPTIMIZATION
-    if (tegra::canny(src, dst, low_thresh, high_thresh, aperture_size, L2gradient))
-        return;
-#endif
+static void cannyMagnitude( const short* dx, const short* dy, int* mag, int width, bool L2gradient )
+{
+    int j = 0;
 
-#ifdef USE_IPP_CANNY
-    if( aperture_size == 3 && !L2gradient &&
-        ippCanny(src, dst, (float)low_thresh, (float)high_thresh) )
-        return;
+#if CV_SSE2
+    if( checkHardwareSupport(CV_CPU_SSE2) )
+    {
+        if( !L2gradient )
+        {
+            for( ; j <= width - 8; j += 8 )
+            {
+                __m128i x = _mm_loadu_si128( (const __m128i*)(dx + j) );
+                __m128i y = _mm_loadu_si128( (const __m128i*)(dy + j) );
+                __m128i x0 = _mm_srai_epi32( _mm_unpacklo_epi16(x, x), 16 );
+                __m128i x1 = _mm_srai_epi32( _mm_unpackhi_epi16(x, x), 16 );
+                __m128i y0 = _mm_srai_epi32( _mm_unpacklo_epi16(y, y), 16 );
+                __m128i y1 = _mm_srai_epi32( _mm_unpackhi_epi16(y, y), 16 );
+                __m128i sx0 = _mm_srai_epi32(x0, 31), sx1 = _mm_srai_epi32(x1, 31);
+                __m128i sy0 = _mm_srai_epi32(y0, 31), sy1 = _mm_srai_epi32(y1, 31);
+                x0 = _mm_sub_epi32( _mm_xor_si128(x0, sx0), sx0 );
+                x1 = _mm_sub_epi32( _mm_xor_si128(x1, sx1), sx1 );
+                y0 = _mm_sub_epi32( _mm_xor_si128(y0, sy0), sy0 );
+                y1 = _mm_sub_epi32( _mm_xor_si128(y1, sy1), sy1 );
+                _mm_storeu_si128( (__m128i*)(mag + j), _mm_add_epi32(x0, y0) );
+                _mm_storeu_si128( (__m128i*)(mag + j + 4), _mm_add_epi32(x1, y1) );
+            }
+        }
+        else
+        {
+            for( ; j <= width - 8; j += 8 )
+            {
+                __m128i x = _mm_loadu_si128( (const __m128i*)(dx + j) );
+                __m128i y = _mm_loadu_si128( (const __m128i*)(dy + j) );
+                __m128i v0 = _mm_unpacklo_epi16(x, y), v1 = _mm_unpackhi_epi16(x, y);
+                _mm_storeu_si128( (__m128i*)(mag + j), _mm_madd_epi16(v0, v0) );
+                _mm_storeu_si128( (__m128i*)(mag + j + 4), _mm_madd_epi16(v1, v1) );
+            }
+        }
+    }
 #endif
 
-    const int cn = src.channels();
-    Mat dx(src.rows, src.cols, CV_16SC(cn));
-    Mat dy(src.rows, src.cols, CV_16SC(cn));
-
-    Sobel(src, dx, CV_16S, 1, 0, aperture_size, 1, 0, cv::BORDER_REPLICATE);
-    Sobel(src, dy, CV_16S, 0, 1, aperture_size, 1, 0, cv::BORDER_REPLICATE);
-
-    if (L2gradient)
+    if( !L2gradient )
     {
-        low_thresh = std::min(32767.0, low_thresh);
-        high_thresh = std::min(32767.0, high_thresh);
-
-        if (low_thresh > 0) low_thresh *= low_thresh;
-        if (high_thresh > 0) high_thresh *= high_thresh;
+        for( ; j < width; j++ )
+            mag[j] = std::abs(int(dx[j])) + std::abs(int(dy[j]));
     }
-    int low = cvFloor(low_thresh);
-    int high = cvFloor(high_thresh);
+    else
+    {
+        for( ; j < width; j++ )
+            mag[j] = int(dx[j])*dx[j] + int(dy[j])*dy[j];
+    }
+}
 
-    ptrdiff_t mapstep = src.cols + 2;
-    AutoBuffer<uchar> buffer((src.cols+2)*(src.rows+2) + cn * mapstep * 3 * sizeof(int));
+// Runs Sobel, magnitude, non-maxima suppression and the hysteresis of one stripe of rows.
+// Sobel rows are streamed through a pair of derivative filter engines and only the three
+// rows needed by the suppression are kept. The map rows of a stripe are written by that
+// stripe only; the edge pixels whose 8-neighbourhood crosses the stripe boundary are
+// collected in `border` and tracked further once all the stripes are done.
+class CannyInvoker : public ParallelLoopBody
+{
+public:
+    enum { CHUNK_ROWS = 16 };
 
-    int* mag_buf[3];
-    mag_buf[0] = (int*)(uchar*)buffer;
-    mag_buf[1] = mag_buf[0] + mapstep*cn;
-    mag_buf[2] = mag_buf[1] + mapstep*cn;
-    memset(mag_buf[0], 0, /* cn* */mapstep*sizeof(int));
+    CannyInvoker( const Mat& _src, uchar* _map, int _low, int _high, int _aperture_size,
+                  bool _L2gradient, std::vector<uchar*>* _border, int _nStripes )
+        : ParallelLoopBody(), src(&_src), map(_map), low(_low), high(_high),
+          aperture_size(_aperture_size), L2gradient(_L2gradient), border(_border), nStripes(_nStripes)
+    {
+    }
 
-    uchar* map = (uchar*)(mag_buf[2] + mapstep*cn);
-    memset(map, 1, mapstep);
-    memset(map + mapstep*(src.rows + 1), 1, mapstep);
+    void operator()( const Range& range ) const
+    {
+        int rows = src->rows, cols = src->cols, cn = src->channels();
+        int row0 = rows*range.start/nStripes, row1 = rows*range.end/nStripes;
+        if( row0 >= row1 )
+            return;
+
+        // the Sobel rows of [ra, rb) provide the magnitudes around the rows of the stripe
+        int ra = std::max(row0 - 1, 0), rb = std::min(row1 + 1, rows);
+        int ddtype = CV_MAKETYPE(CV_16S, cn);
+        Ptr<FilterEngine> fx = createDerivFilter( src->type(), ddtype, 1, 0, aperture_size, BORDER_REPLICATE );
+        Ptr<FilterEngine> fy = createDerivFilter( src->type(), ddtype, 0, 1, aperture_size, BORDER_REPLICATE );
+        int y = fx->start( *src, Rect(0, ra, cols, rb - ra) );
+        fy->start( *src, Rect(0, ra, cols, rb - ra) );
+        const uchar* sptr = src->data + (ptrdiff_t)y*src->step;
+        int remaining = fx->remainingInputRows();
+
+        ptrdiff_t mapstep = cols + 2;
+        int ksize = aperture_size > 0 ? aperture_size : 3;
+        size_t dstep = alignSize(cols*cn*sizeof(short), 16);
+        AutoBuffer<uchar> _buf(dstep*(CHUNK_ROWS + ksize)*2 + (mapstep*cn*4 + 4)*sizeof(int) +
+                               dstep*6);
+        uchar* dxbuf = (uchar*)_buf;
+        uchar* dybuf = dxbuf + dstep*(CHUNK_ROWS + ksize);
+        int* magbuf = (int*)alignPtr(dybuf + dstep*(CHUNK_ROWS + ksize), (int)sizeof(int));
+        int* zeros = magbuf + mapstep*cn*3;
+        short* dring = (short*)alignPtr((uchar*)(zeros + mapstep*cn), 16);
+        memset(zeros, 0, mapstep*sizeof(int));
+
+        std::vector<uchar*> stack;
+        stack.reserve(std::max(1 << 10, cols*(row1 - row0)/10));
+
+        for( y = ra; remaining > 0; )
+        {
+            int count = std::min(remaining, (int)CHUNK_ROWS);
+            int n = fx->proceed( sptr, (int)src->step, count, dxbuf, (int)dstep );
+            int ny = fy->proceed( sptr, (int)src->step, count, dybuf, (int)dstep );
+            CV_Assert( n == ny );
+            sptr += count*src->step;
+            remaining -= count;
+
+            for( int k = 0; k < n; k++, y++ )
+            {
+                int slot = (y - ra) % 3;
+                int* _norm = magbuf + mapstep*cn*slot + 1;
+                short* _dx = dring + dstep/sizeof(short)*slot*2;
+                short* _dy = _dx + dstep/sizeof(short);
+                memcpy( _dx, dxbuf + dstep*k, cols*cn*sizeof(short) );
+                memcpy( _dy, dybuf + dstep*k, cols*cn*sizeof(short) );
 
-    int maxsize = std::max(1 << 10, src.cols * src.rows / 10);
-    std::vector<uchar*> stack(maxsize);
-    uchar **stack_top = &stack[0];
-    uchar **stack_bottom = &stack[0];
+                cannyMagnitude( _dx, _dy, _norm, cols*cn, L2gradient );
 
-    /* sector numbers
-       (Top-Left Origin)
+                if( cn > 1 )
+                {
+                    for( int j = 0, jn = 0; j < cols; ++j, jn += cn )
+                    {
+                        int maxIdx = jn;
+                        for( int c = 1; c < cn; ++c )
+                            if( _norm[jn + c] > _norm[maxIdx] ) maxIdx = jn + c;
+                        _norm[j] = _norm[maxIdx];
+                        _dx[j] = _dx[maxIdx];
+                        _dy[j] = _dy[maxIdx];
+                    }
+                }
+                _norm[-1] = _norm[cols] = 0;
 
-        1   2   3
-         *  *  *
-          * * *
-        0*******0
-          * * *
-         *  *  *
-        3   2   1
-    */
+                if( y - 1 >= row0 )
+                    suppress( y - 1, ra, rb, magbuf, zeros, dring, dstep, stack, row0 );
+            }
+        }
+        if( rb == rows )
+            suppress( rows - 1, ra, rb, magbuf, zeros, dring, dstep, stack, row0 );
 
-    #define CANNY_PUSH(d)    *(d) = uchar(2), *stack_top++ = (d)
-    #define CANNY_POP(d)     (d) = *--stack_top
+        // track the edges inside the stripe; the rows of the neighbouring stripes are left to
+        // the final stitching pass
+        const uchar* lo = map + mapstep*(row0 == 0 ? 0 : row0 + 1) + mapstep;
+        const uchar* hi = map + mapstep*(row1 == rows ? rows + 2 : row1 + 1) - mapstep;
+        std::vector<uchar*>& stripeBorder = border[range.start];
 
-    // calculate magnitude and angle of gradient, perform non-maxima suppression.
-    // fill the map with one of the following values:
-    //   0 - the pixel might belong to an edge
-    //   1 - the pixel can not belong to an edge
-    //   2 - the pixel does belong to an edge
-    for (int i = 0; i <= src.rows; i++)
-    {
-        int* _norm = mag_buf[(i > 0) + 1] + 1;
-        if (i < src.rows)
+        while( !stack.empty() )
         {
-            short* _dx = dx.ptr<short>(i);
-            short* _dy = dy.ptr<short>(i);
+            uchar* m = stack.back();
+            stack.pop_back();
 
-            if (!L2gradient)
+            if( !m[-1] )         CANNY_PUSH(m - 1);
+            if( !m[1] )          CANNY_PUSH(m + 1);
+            if( m >= lo )
             {
-                for (int j = 0; j < src.cols*cn; j++)
-                    _norm[j] = std::abs(int(_dx[j])) + std::abs(int(_dy[j]));
+                if( !m[-mapstep-1] ) CANNY_PUSH(m - mapstep - 1);
+                if( !m[-mapstep] )   CANNY_PUSH(m - mapstep);
+                if( !m[-mapstep+1] ) CANNY_PUSH(m - mapstep + 1);
             }
             else
+                stripeBorder.push_back(m);
+            if( m < hi )
             {
-                for (int j = 0; j < src.cols*cn; j++)
-                    _norm[j] = int(_dx[j])*_dx[j] + int(_dy[j])*_dy[j];
-            }
-
-            if (cn > 1)
-            {
-                for(int j = 0, jn = 0; j < src.cols; ++j, jn += cn)
-                {
-                    int maxIdx = jn;
-                    for(int k = 1; k < cn; ++k)
-                        if(_norm[jn + k] > _norm[maxIdx]) maxIdx = jn + k;
-                    _norm[j] = _norm[maxIdx];
-                    _dx[j] = _dx[maxIdx];
-                    _dy[j] = _dy[maxIdx];
-                }
+                if( !m[mapstep-1] )  CANNY_PUSH(m + mapstep - 1);
+                if( !m[mapstep] )    CANNY_PUSH(m + mapstep);
+                if( !m[mapstep+1] )  CANNY_PUSH(m + mapstep + 1);
             }
-            _norm[-1] = _norm[src.cols] = 0;
-        }
-        else
-            memset(_norm-1, 0, /* cn* */mapstep*sizeof(int));
-
-        // at the very beginning we do not have a complete ring
-        // buffer of 3 magnitude rows for non-maxima suppression
-        if (i == 0)
-            continue;
-
-        uchar* _map = map + mapstep*i + 1;
-        _map[-1] = _map[src.cols] = 1;
-
-        int* _mag = mag_buf[1] + 1; // take the central row
-        ptrdiff_t magstep1 = mag_buf[2] - mag_buf[1];
-        ptrdiff_t magstep2 = mag_buf[0] - mag_buf[1];
-
-        const short* _x = dx.ptr<short>(i-1);
-        const short* _y = dy.ptr<short>(i-1);
-
-        if ((stack_top - stack_bottom) + src.cols > maxsize)
-        {
-            int sz = (int)(stack_top - stack_bottom);
-            maxsize = maxsize * 3/2;
-            stack.resize(maxsize);
-            stack_bottom = &stack[0];
-            stack_top = stack_bottom + sz;
+            else
+                stripeBorder.push_back(m);
         }
+    }
 
+private:
+    // calculate magnitude and angle of gradient, perform non-maxima suppression.
+    // fill the map with one of the following values:
+    //   0 - the pixel might belong to an edge
+    //   1 - the pixel can not belong to an edge
+    //   2 - the pixel does belong to an edge
+    void suppress( int i, int ra, int rb, int* magbuf, const int* zeros, short* dring, size_t dstep,
+                   std::vector<uchar*>& stack, int row0 ) const
+    {
+        int cols = src->cols, cn = src->channels();
+        ptrdiff_t mapstep = cols + 2;
+        const int* _mag = magbuf + mapstep*cn*((i - ra) % 3) + 1;
+        const int* _prev = (i - 1 >= ra ? magbuf + mapstep*cn*((i - 1 - ra) % 3) : zeros) + 1;
+        const int* _next = (i + 1 < rb ? magbuf + mapstep*cn*((i + 1 - ra) % 3) : zeros) + 1;
+        const short* _x = dring + dstep/sizeof(short)*((i - ra) % 3)*2;
+        const short* _y = _x + dstep/sizeof(short);
+
+        uchar* _map = map + mapstep*(i + 1) + 1;
+        _map[-1] = _map[cols] = 1;
+        // the row above the stripe belongs to another stripe, so the "already pushed" shortcut
+        // looks at the (edgeless) top border row instead
+        const uchar* _above = i == row0 ? map + 1 : _map - mapstep;
+
+        const int TG22 = (int)(0.4142135623730950488016887242097*(1<<CANNY_SHIFT) + 0.5);
         int prev_flag = 0;
-        for (int j = 0; j < src.cols; j++)
-        {
-            #define CANNY_SHIFT 15
-            const int TG22 = (int)(0.4142135623730950488016887242097*(1<<CANNY_SHIFT) + 0.5);
 
+        for( int j = 0; j < cols; j++ )
+        {
             int m = _mag[j];
 
-            if (m > low)
+            if( m > low )
             {
                 int xs = _x[j];
                 int ys = _y[j];
@@ -253,21 +318,21 @@ void cv::Canny( InputArray _src, OutputArray _dst,
 
                 int tg22x = x * TG22;
 
-                if (y < tg22x)
+                if( y < tg22x )
                 {
-                    if (m > _mag[j-1] && m >= _mag[j+1]) goto __ocv_canny_push;
+                    if( m > _mag[j-1] && m >= _mag[j+1] ) goto __ocv_canny_push;
                 }
                 else
                 {
                     int tg67x = tg22x + (x << (CANNY_SHIFT+1));
-                    if (y > tg67x)
+                    if( y > tg67x )
                     {
-                        if (m > _mag[j+magstep2] && m >= _mag[j+magstep1]) goto __ocv_canny_push;
+                        if( m > _prev[j] && m >= _next[j] ) goto __ocv_canny_push;
                     }
                     else
                     {
                         int s = (xs ^ ys) < 0 ? -1 : 1;
-                        if (m > _mag[j+magstep2-s] && m > _mag[j+magstep1+s]) goto __ocv_canny_push;
+                        if( m > _prev[j-s] && m > _next[j+s] ) goto __ocv_canny_push;
                     }
                 }
             }
@@ -275,7 +340,7 @@ void cv::Canny( InputArray _src, OutputArray _dst,
             _map[j] = uchar(1);
             continue;
 __ocv_canny_push:
-            if (!prev_flag && m > high && _map[j-mapstep] != 2)
+            if( !prev_flag && m > high && _above[j] != 2 )
             {
                 CANNY_PUSH(_map + j);
                 prev_flag = 1;
@@ -283,28 +348,118 @@ __ocv_canny_push:
             else
                 _map[j] = 0;
         }
+    }
 
-        // scroll the ring buffer
-        _mag = mag_buf[0];
-        mag_buf[0] = mag_buf[1];
-        mag_buf[1] = mag_buf[2];
-        mag_buf[2] = _mag;
+    const Mat* src;
+    uchar* map;
+    int low;
+    int high;
+    int aperture_size;
+    bool L2gradient;
+    std::vector<uchar*>* border;
+    int nStripes;
+};
+
+class CannyFinalInvoker : public ParallelLoopBody
+{
+public:
+    CannyFinalInvoker( const uchar* _map, Mat& _dst )
+        : ParallelLoopBody(), map(_map), dst(&_dst)
+    {
     }
 
-    // now track the edges (hysteresis thresholding)
-    while (stack_top > stack_bottom)
+    void operator()( const Range& range ) const
     {
-        uchar* m;
-        if ((stack_top - stack_bottom) + 8 > maxsize)
+        ptrdiff_t mapstep = dst->cols + 2;
+        for( int i = range.start; i < range.end; i++ )
         {
-            int sz = (int)(stack_top - stack_bottom);
-            maxsize = maxsize * 3/2;
-            stack.resize(maxsize);
-            stack_bottom = &stack[0];
-            stack_top = stack_bottom + sz;
+            const uchar* pmap = map + mapstep*(i + 1) + 1;
+            uchar* pdst = dst->ptr(i);
+            for( int j = 0; j < dst->cols; j++ )
+                pdst[j] = (uchar)-(pmap[j] >> 1);
         }
+    }
 
-        CANNY_POP(m);
+private:
+    const uchar* map;
+    Mat* dst;
+};
+
+}
+
+void cv::Canny( InputArray _src, OutputArray _dst,
+                double low_thresh, double high_thresh,
+                int aperture_size, bool L2gradient )
+{
+    Mat src = _src.getMat();
+    CV_Assert( src.depth() == CV_8U );
+
+    _dst.create(src.size(), CV_8U);
+    Mat dst = _dst.getMat();
+
+    if (!L2gradient && (aperture_size & CV_CANNY_L2_GRADIENT) == CV_CANNY_L2_GRADIENT)
+    {
+        //backward compatibility
+        aperture_size &= ~CV_CANNY_L2_GRADIENT;
+        L2gradient = true;
+    }
+
+    if ((aperture_size & 1) == 0 || (aperture_size != -1 && (aperture_size < 3 || aperture_size > 7)))
+        CV_Error(CV_StsBadFlag, "");
+
+    if (low_thresh > high_thresh)
+        std::swap(low_thresh, high_thresh);
+
+#ifdef HAVE_TEGRA_OPTIMIZATION
+    if (tegra::canny(src, dst, low_thresh, high_thresh, aperture_size, L2gradient))
+        return;
+#endif
+
+#ifdef USE_IPP_CANNY
+    if( aperture_size == 3 && !L2gradient &&
+        ippCanny(src, dst, (float)low_thresh, (float)high_thresh) )
+        return;
+#endif
+
+    if( src.empty() )
+        return;
+
+    if (L2gradient)
+    {
+        low_thresh = std::min(32767.0, low_thresh);
+        high_thresh = std::min(32767.0, high_thresh);
+
+        if (low_thresh > 0) low_thresh *= low_thresh;
+        if (high_thresh > 0) high_thresh *= high_thresh;
+    }
+    int low = cvFloor(low_thresh);
+    int high = cvFloor(high_thresh);
+
+    ptrdiff_t mapstep = src.cols + 2;
+    AutoBuffer<uchar> buffer((src.cols+2)*(src.rows+2));
+
+    uchar* map = (uchar*)buffer;
+    memset(map, 1, mapstep);
+    memset(map + mapstep*(src.rows + 1), 1, mapstep);
+
+    // the stripes only recompute a few Sobel rows around their boundaries, so they can be short
+    int nStripes = 1, nthreads = getNumThreads();
+    if( nthreads > 1 )
+        nStripes = std::max(std::min(std::min(nthreads*2, (int)(src.total() >> 15)), src.rows/16), 1);
+
+    std::vector<std::vector<uchar*> > border(nStripes);
+    parallel_for_(Range(0, nStripes),
+                  CannyInvoker(src, map, low, high, aperture_size, L2gradient, &border[0], nStripes));
+
+    // now track the edges that cross the stripe boundaries (hysteresis thresholding)
+    std::vector<uchar*> stack;
+    for( int k = 0; k < nStripes; k++ )
+        stack.insert(stack.end(), border[k].begin(), border[k].end());
+
+    while( !stack.empty() )
+    {
+        uchar* m = stack.back();
+        stack.pop_back();
 
         if (!m[-1])         CANNY_PUSH(m - 1);
         if (!m[1])          CANNY_PUSH(m + 1);
@@ -317,13 +472,7 @@ __ocv_canny_push:
     }
 
     // the final pass, form the final image
-    const uchar* pmap = map + mapstep + 1;
-    uchar* pdst = dst.ptr();
-    for (int i = 0; i < src.rows; i++, pmap += mapstep, pdst += dst.step)
-    {
-        for (int j = 0; j < src.cols; j++)
-            pdst[j] = (uchar)-(pmap[j] >> 1);
-    }
+    parallel_for_(Range(0, src.rows), CannyFinalInvoker(map, dst), src.total()/(double)(1<<16));
 }
 
 void cvCanny( const CvArr* image, CvArr* edges, double threshold1,
@@ -0,0 +1,503 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+
+/*
+   Two-pass connected component labeling with union-find. With 8-connectivity the
+   first pass labels 2x2 blocks instead of pixels: all the foreground pixels of a block
+   are connected, and whether two neighboring blocks are connected follows from the
+   few pixels along their common side. With 4-connectivity single pixels are labeled.
+   The first pass runs in horizontal stripes, each with its own range of provisional
+   labels; the components crossing the stripe seams are merged afterwards. The second
+   pass writes the final labels, which are numbered in the order of the components'
+   first blocks, and collects the component statistics.
+*/
+
+namespace cv
+{
+
+static inline int ccFindRoot( const int* P, int i )
+{
+    while( P[i] < i )
+        i = P[i];
+    return i;
+}
+
+static inline void ccSetRoot( int* P, int i, int root )
+{
+    while( P[i] < i )
+    {
+        int j = P[i];
+        P[i] = root;
+        i = j;
+    }
+    P[i] = root;
+}
+
+// the smaller label always becomes the root
+static inline int ccMerge( int* P, int i, int j )
+{
+    int root = ccFindRoot(P, i);
+    if( i != j )
+    {
+        int rootj = ccFindRoot(P, j);
+        if( root > rootj )
+            root = rootj;
+        ccSetRoot(P, j, root);
+    }
+    ccSetRoot(P, i, root);
+    return root;
+}
+
+/* codes of a row of 2x2 blocks: bit 0 - top-left pixel, bit 1 - top-right,
+   bit 2 - bottom-left, bit 3 - bottom-right */
+static void ccBlockCodes( const Mat& img, int by, uchar* codes )
+{
+    const uchar* r0 = img.ptr<uchar>(by*2);
+    const uchar* r1 = by*2 + 1 < img.rows ? r0 + img.step : 0;
+    int bx, width = img.cols;
+
+    for( bx = 0; bx < width/2; bx++ )
+    {
+        int c = (r0[bx*2] != 0) | ((r0[bx*2+1] != 0) << 1);
+        if( r1 )
+            c |= ((r1[bx*2] != 0) << 2) | ((r1[bx*2+1] != 0) << 3);
+        codes[bx] = (uchar)c;
+    }
+
+    if( width & 1 )
+        codes[bx] = (uchar)((r0[width-1] != 0) | (r1 && r1[width-1] ? 4 : 0));
+}
+
+// merges block bx of the current row with the connected blocks of the row above
+static inline int ccMergeAbove8( int* P, int lab, int code, const uchar* prevCodes,
+                                 const int* prevLabels, int bx, int bw )
+{
+    if( (code & 3) && (prevCodes[bx] & 12) )
+        lab = lab ? (lab != prevLabels[bx] ? ccMerge(P, lab, prevLabels[bx]) : lab) : prevLabels[bx];
+    if( (code & 1) && bx > 0 && (prevCodes[bx-1] & 8) )
+        lab = lab ? (lab != prevLabels[bx-1] ? ccMerge(P, lab, prevLabels[bx-1]) : lab) : prevLabels[bx-1];
+    if( (code & 2) && bx + 1 < bw && (prevCodes[bx+1] & 4) )
+        lab = lab ? (lab != prevLabels[bx+1] ? ccMerge(P, lab, prevLabels[bx+1]) : lab) : prevLabels[bx+1];
+    return lab;
+}
+
+class ConnectedComponentsLabelInvoker : public ParallelLoopBody
+{
+public:
+    ConnectedComponentsLabelInvoker( const Mat& _img, Mat& _blabels, int* _P, int* _nextLabel,
+                                     int _connectivity, int _nStripes )
+        : img(&_img), blabels(&_blabels), P(_P), nextLabel(_nextLabel),
+          connectivity(_connectivity), nStripes(_nStripes)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int bh = blabels->rows, bw = blabels->cols;
+        int row0 = bh*range.start/nStripes, row1 = bh*range.end/nStripes;
+        int next = row0*bw + 1;
+
+        if( connectivity == 8 )
+        {
+            AutoBuffer<uchar> _codes(bw*2);
+            uchar *codes = _codes, *prevCodes = codes + bw;
+
+            for( int by = row0; by < row1; by++ )
+            {
+                int* lrow = blabels->ptr<int>(by);
+                const int* prevLabels = by > row0 ? blabels->ptr<int>(by-1) : 0;
+                std::swap(codes, prevCodes);
+                ccBlockCodes(*img, by, codes);
+
+                for( int bx = 0; bx < bw; bx++ )
+                {
+                    int code = codes[bx], lab = 0;
+                    if( !code )
+                    {
+                        lrow[bx] = 0;
+                        continue;
+                    }
+
+                    if( bx > 0 && (code & 5) && (codes[bx-1] & 10) )
+                        lab = lrow[bx-1];
+                    if( prevLabels )
+                        lab = ccMergeAbove8(P, lab, code, prevCodes, prevLabels, bx, bw);
+                    if( !lab )
+                    {
+                        lab = next++;
+                        P[lab] = lab;
+                    }
+                    lrow[bx] = lab;
+                }
+            }
+        }
+        else
+        {
+            for( int y = row0; y < row1; y++ )
+            {
+                const uchar* src = img->ptr<uchar>(y);
+                const uchar* prev = y > row0 ? src - img->step : 0;
+                int* lrow = blabels->ptr<int>(y);
+                const int* prevLabels = prev ? blabels->ptr<int>(y-1) : 0;
+
+                for( int x = 0; x < bw; x++ )
+                {
+                    int lab = 0;
+                    if( !src[x] )
+                    {
+                        lrow[x] = 0;
+                        continue;
+                    }
+
+                    if( x > 0 && src[x-1] )
+                        lab = lrow[x-1];
+                    if( prev && prev[x] )
+                        lab = lab ? (lab != prevLabels[x] ? ccMerge(P, lab, prevLabels[x]) : lab) : prevLabels[x];
+                    if( !lab )
+                    {
+                        lab = next++;
+                        P[lab] = lab;
+                    }
+                    lrow[x] = lab;
+                }
+            }
+        }
+
+        nextLabel[range.start] = next;
+    }
+
+private:
+    const Mat* img;
+    Mat* blabels;
+    int* P;
+    int* nextLabel;
+    int connectivity;
+    int nStripes;
+};
+
+/* per-stripe statistics: left, top, right, bottom and area of every label seen in the stripe,
+   followed by the sums of the x and y coordinates. The stripe owns the labels [lo, lo + nown)
+   whose roots it created; the other labels it sees are the background and the components
+   entering from above, which all show up in its first row and are kept sorted in foreign.
+   This bounds the per-stripe storage by the image width instead of the number of labels. */
+struct ConnectedComponentsStats
+{
+    int lo, nown;
+    std::vector<int> foreign;
+    std::vector<int> bounds;
+    std::vector<double> sums;
+};
+
+template<typename LT> class ConnectedComponentsRelabelInvoker : public ParallelLoopBody
+{
+public:
+    ConnectedComponentsRelabelInvoker( const Mat& _img, const Mat& _blabels, const int* _P,
+                                       Mat& _labels, int _connectivity, const int* _firstLabel,
+                                       ConnectedComponentsStats* _stats, int _nStripes )
+        : img(&_img), blabels(&_blabels), P(_P), labels(&_labels), connectivity(_connectivity),
+          firstLabel(_firstLabel), stats(_stats), nStripes(_nStripes)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int unit = connectivity == 8 ? 2 : 1;
+        int bh = blabels->rows, width = img->cols;
+        int row0 = std::min(bh*range.start/nStripes*unit, img->rows);
+        int row1 = std::min(bh*range.end/nStripes*unit, img->rows);
+        int* bounds = 0;
+        double* sums = 0;
+        const int* foreign = 0;
+        int lo = 0, nown = 0, nforeign = 0;
+
+        if( stats )
+        {
+            ConnectedComponentsStats& s = stats[range.start];
+            s.lo = lo = firstLabel[range.start];
+            s.nown = nown = firstLabel[range.end] - lo;
+            s.foreign.assign(1, 0);
+            if( row0 < row1 )
+            {
+                const uchar* src = img->ptr<uchar>(row0);
+                const int* brow = blabels->ptr<int>(row0/unit);
+                for( int x = 0; x < width; x++ )
+                {
+                    int l = connectivity == 8 ? (src[x] ? P[brow[x >> 1]] : 0) : P[brow[x]];
+                    if( l && l < lo && l != s.foreign.back() )
+                        s.foreign.push_back(l);
+                }
+                std::sort(s.foreign.begin(), s.foreign.end());
+                s.foreign.erase(std::unique(s.foreign.begin(), s.foreign.end()), s.foreign.end());
+            }
+
+            int nloc = nown + (int)s.foreign.size();
+            s.bounds.resize(nloc*5);
+            s.sums.assign(nloc*2, 0.);
+            bounds = &s.bounds[0];
+            sums = &s.sums[0];
+            foreign = &s.foreign[0];
+            nforeign = (int)s.foreign.size();
+            for( int i = 0; i < nloc; i++ )
+            {
+                bounds[i*5] = bounds[i*5+1] = INT_MAX;
+                bounds[i*5+2] = bounds[i*5+3] = INT_MIN;
+                bounds[i*5+4] = 0;
+            }
+        }
+
+        int lastForeign = -1, lastIdx = 0;
+
+        for( int y = row0; y < row1; y++ )
+        {
+            const uchar* src = img->ptr<uchar>(y);
+            const int* brow = blabels->ptr<int>(y/unit);
+            LT* dst = labels->ptr<LT>(y);
+
+            if( connectivity == 8 )
+                for( int x = 0; x < width; x++ )
+                    dst[x] = (LT)(src[x] ? P[brow[x >> 1]] : 0);
+            else
+                for( int x = 0; x < width; x++ )
+                    dst[x] = (LT)P[brow[x]];
+
+            if( !bounds )
+                continue;
+
+            for( int x = 0; x < width; x++ )
+            {
+                int l = dst[x], i;
+                if( l >= lo )
+                    i = l - lo;
+                else if( l == lastForeign )
+                    i = lastIdx;
+                else
+                {
+                    i = nown + (int)(std::lower_bound(foreign, foreign + nforeign, l) - foreign);
+                    lastForeign = l;
+                    lastIdx = i;
+                }
+
+                int* b = bounds + i*5;
+                if( x < b[0] )
+                    b[0] = x;
+                if( x > b[2] )
+                    b[2] = x;
+                if( !b[4]++ )
+                    b[1] = y;
+                b[3] = y;
+                sums[i*2] += x;
+                sums[i*2+1] += y;
+            }
+        }
+    }
+
+private:
+    const Mat* img;
+    const Mat* blabels;
+    const int* P;
+    Mat* labels;
+    int connectivity;
+    const int* firstLabel;
+    ConnectedComponentsStats* stats;
+    int nStripes;
+};
+
+static int connectedComponents_( const Mat& img, OutputArray _labels, OutputArray _stats,
+                                 OutputArray _centroids, bool computeStats,
+                                 int connectivity, int ltype )
+{
+    CV_Assert( img.type() == CV_8UC1 );
+    CV_Assert( connectivity == 8 || connectivity == 4 );
+    CV_Assert( ltype == CV_32S || ltype == CV_16U );
+
+    _labels.create(img.size(), ltype);
+    Mat labels = _labels.getMat();
+
+    int unit = connectivity == 8 ? 2 : 1;
+    int bh = (img.rows + unit - 1)/unit, bw = (img.cols + unit - 1)/unit;
+
+    // with 4-connectivity and 32-bit labels the provisional labels go straight to the output
+    Mat blabels;
+    if( connectivity == 4 && ltype == CV_32S )
+        blabels = labels;
+    else
+        blabels.create(bh, bw, CV_32S);
+
+    int nStripes = 1, nthreads = getNumThreads();
+    if( nthreads > 1 )
+        nStripes = std::max(std::min(std::min(nthreads*2, (int)(img.total() >> 15)), bh/8), 1);
+
+    AutoBuffer<int> _P(bh*bw + 1);
+    int* P = _P;
+    std::vector<int> nextLabel(nStripes + 1);
+    for( int k = 0; k <= nStripes; k++ )
+        nextLabel[k] = bh*k/nStripes*bw + 1;
+    P[0] = 0;
+
+    parallel_for_(Range(0, nStripes),
+                  ConnectedComponentsLabelInvoker(img, blabels, P, &nextLabel[0], connectivity, nStripes));
+
+    // merge the components across the stripe seams
+    AutoBuffer<uchar> _codes(bw*2);
+    for( int k = 1; k < nStripes; k++ )
+    {
+        int by = bh*k/nStripes;
+        int* lrow = blabels.ptr<int>(by);
+        const int* prevLabels = blabels.ptr<int>(by-1);
+
+        if( connectivity == 8 )
+        {
+            uchar *codes = _codes, *prevCodes = codes + bw;
+            ccBlockCodes(img, by, codes);
+            ccBlockCodes(img, by - 1, prevCodes);
+            for( int bx = 0; bx < bw; bx++ )
+                if( codes[bx] )
+                    ccMergeAbove8(P, lrow[bx], codes[bx], prevCodes, prevLabels, bx, bw);
+        }
+        else
+        {
+            for( int x = 0; x < bw; x++ )
+                if( lrow[x] && prevLabels[x] )
+                    ccMerge(P, lrow[x], prevLabels[x]);
+        }
+    }
+
+    // a label always points to a smaller one, so a single pass numbers the roots consecutively
+    int nLabels = 1;
+    std::vector<int> firstLabel(nStripes + 1);
+    for( int k = 0; k < nStripes; k++ )
+    {
+        firstLabel[k] = nLabels;
+        for( int i = bh*k/nStripes*bw + 1; i < nextLabel[k]; i++ )
+            P[i] = P[i] < i ? P[P[i]] : nLabels++;
+    }
+    firstLabel[nStripes] = nLabels;
+
+    if( ltype == CV_16U && nLabels > USHRT_MAX + 1 )
+        CV_Error( CV_StsOutOfRange, "The number of components does not fit into 16-bit labels" );
+
+    std::vector<ConnectedComponentsStats> stats(computeStats ? nStripes : 0);
+    ConnectedComponentsStats* pstats = computeStats ? &stats[0] : 0;
+    if( ltype == CV_32S )
+        parallel_for_(Range(0, nStripes), ConnectedComponentsRelabelInvoker<int>(img, blabels, P,
+                      labels, connectivity, &firstLabel[0], pstats, nStripes));
+    else
+        parallel_for_(Range(0, nStripes), ConnectedComponentsRelabelInvoker<ushort>(img, blabels, P,
+                      labels, connectivity, &firstLabel[0], pstats, nStripes));
+
+    if( !computeStats )
+        return nLabels;
+
+    _stats.create(nLabels, CC_STAT_MAX, CV_32S);
+    _centroids.create(nLabels, 2, CV_64F);
+    Mat statsMat = _stats.getMat(), centroids = _centroids.getMat();
+
+    std::vector<int> bounds(nLabels*5);
+    std::vector<double> sums(nLabels*2, 0.);
+    for( int l = 0; l < nLabels; l++ )
+    {
+        bounds[l*5] = bounds[l*5+1] = INT_MAX;
+        bounds[l*5+2] = bounds[l*5+3] = INT_MIN;
+        bounds[l*5+4] = 0;
+    }
+
+    for( int k = 0; k < nStripes; k++ )
+    {
+        const ConnectedComponentsStats& st = stats[k];
+        int nloc = (int)st.bounds.size()/5;
+        for( int i = 0; i < nloc; i++ )
+        {
+            int l = i < st.nown ? st.lo + i : st.foreign[i - st.nown];
+            const int* b = &st.bounds[i*5];
+            int* d = &bounds[l*5];
+            d[0] = std::min(d[0], b[0]);
+            d[1] = std::min(d[1], b[1]);
+            d[2] = std::max(d[2], b[2]);
+            d[3] = std::max(d[3], b[3]);
+            d[4] += b[4];
+            sums[l*2] += st.sums[i*2];
+            sums[l*2+1] += st.sums[i*2+1];
+        }
+    }
+
+    for( int l = 0; l < nLabels; l++ )
+    {
+        const int* b = &bounds[l*5];
+        int left = b[0], top = b[1], right = b[2], bottom = b[3], area = b[4];
+        double sx = sums[l*2], sy = sums[l*2+1];
+
+        int* s = statsMat.ptr<int>(l);
+        double* c = centroids.ptr<double>(l);
+        if( area == 0 )
+        {
+            s[CC_STAT_LEFT] = s[CC_STAT_TOP] = s[CC_STAT_WIDTH] = s[CC_STAT_HEIGHT] = s[CC_STAT_AREA] = 0;
+            c[0] = c[1] = 0;
+            continue;
+        }
+        s[CC_STAT_LEFT] = left;
+        s[CC_STAT_TOP] = top;
+        s[CC_STAT_WIDTH] = right - left + 1;
+        s[CC_STAT_HEIGHT] = bottom - top + 1;
+        s[CC_STAT_AREA] = area;
+        c[0] = sx/area;
+        c[1] = sy/area;
+    }
+
+    return nLabels;
+}
+
+}
+
+int cv::connectedComponents( InputArray _img, OutputArray _labels, int connectivity, int ltype )
+{
+    Mat img = _img.getMat();
+    return connectedComponents_(img, _labels, noArray(), noArray(), false, connectivity, ltype);
+}
+
+int cv::connectedComponentsWithStats( InputArray _img, OutputArray _labels, OutputArray _stats,
+                                      OutputArray _centroids, int connectivity, int ltype )
+{
+    Mat img = _img.getMat();
+    return connectedComponents_(img, _labels, _stats, _centroids, true, connectivity, ltype);
+}
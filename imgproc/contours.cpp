@@ -1769,11 +1769,376 @@ cvFindContours( void*  img,  CvMemStorage*  storage,
     return count;
 }
 
+namespace cv
+{
+
+/*
+   Parallel border extraction for 8uC1 images (CV_RETR_LIST/CCOMP/TREE with
+   CV_CHAIN_APPROX_NONE/SIMPLE). The binarized image is labeled into 8-connected
+   foreground and 4-connected background components, stripe by stripe, and the
+   components crossing the stripe seams are merged afterwards. Every foreground
+   component has one outer border that starts at its raster-first pixel, and every
+   background component except the one containing the frame has one hole border that
+   starts just left of its raster-first pixel. The raster order of those pixels is the
+   order in which cvFindNextContour meets the borders, so the contours and their order
+   are the same as on the serial path. The parents come from the component adjacency
+   rather than from the 7-bit border labels, which cvFindNextContour may confuse on
+   images with many borders. The borders are then traced independently of each other.
+*/
+
+static inline int contourFindRoot( int* labels, int i )
+{
+    while( labels[i] != i )
+    {
+        labels[i] = labels[labels[i]];
+        i = labels[i];
+    }
+    return i;
+}
+
+// the smaller index always becomes the root, so every root is the raster-first pixel
+// of its component
+static inline void contourMerge( int* labels, int i, int j )
+{
+    i = contourFindRoot(labels, i);
+    j = contourFindRoot(labels, j);
+    if( i < j )
+        labels[j] = i;
+    else
+        labels[i] = j;
+}
+
+class ContourLabelInvoker : public ParallelLoopBody
+{
+public:
+    ContourLabelInvoker( const Mat& _img, int* _labels, std::vector<int>* _roots, int _nStripes )
+        : img(&_img), labels(_labels), roots(_roots), nStripes(_nStripes)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int width = img->cols;
+        int row0 = img->rows*range.start/nStripes, row1 = img->rows*range.end/nStripes;
+        std::vector<int>& stripeRoots = roots[range.start];
+
+        for( int y = row0; y < row1; y++ )
+        {
+            const uchar* src = img->ptr<uchar>(y);
+            const uchar* prev = y > row0 ? src - img->step : 0;
+            int* lrow = labels + y*width;
+
+            for( int x = 0; x < width; x++ )
+            {
+                int i = y*width + x;
+
+                if( src[x] )
+                {
+                    // the frame is zero, so a foreground pixel always has both horizontal neighbors
+                    if( prev && prev[x] )
+                        lrow[x] = lrow[x - width];
+                    else
+                    {
+                        if( src[x-1] )
+                            lrow[x] = lrow[x-1];
+                        else if( prev && prev[x-1] )
+                            lrow[x] = lrow[x - width - 1];
+                        else
+                            lrow[x] = i;
+
+                        if( prev && prev[x+1] )
+                        {
+                            if( lrow[x] == i )
+                                lrow[x] = lrow[x - width + 1];
+                            else if( lrow[x] != lrow[x - width + 1] )
+                                contourMerge(labels, i, i - width + 1);
+                        }
+                    }
+                }
+                else
+                {
+                    if( x > 0 && !src[x-1] )
+                    {
+                        lrow[x] = lrow[x-1];
+                        if( prev && !prev[x] && lrow[x] != lrow[x - width] )
+                            contourMerge(labels, i, i - width);
+                    }
+                    else if( prev && !prev[x] )
+                        lrow[x] = lrow[x - width];
+                    else
+                        lrow[x] = i;
+                }
+            }
+        }
+
+        // point every pixel to the root of its stripe-local component
+        for( int i = row0*width; i < row1*width; i++ )
+        {
+            labels[i] = labels[labels[i]];
+            if( labels[i] == i )
+                stripeRoots.push_back(i);
+        }
+    }
+
+private:
+    const Mat* img;
+    int* labels;
+    std::vector<int>* roots;
+    int nStripes;
+};
+
+static void traceContourBorder( const uchar* ptr, int step, Point pt, bool isHole,
+                                int _method, std::vector<Point>& contour )
+{
+    int deltas[16];
+    const uchar *i0 = ptr, *i1, *i3, *i4;
+    int prev_s, s, s_end;
+    int method = _method - 1;
+
+    CV_INIT_3X3_DELTAS( deltas, step, 1 );
+    memcpy( deltas + 8, deltas, 8 * sizeof( deltas[0] ));
+
+    s_end = s = isHole ? 0 : 4;
+
+    do
+    {
+        s = (s - 1) & 7;
+        i1 = i0 + deltas[s];
+        if( *i1 != 0 )
+            break;
+    }
+    while( s != s_end );
+
+    if( s == s_end )            /* single pixel domain */
+    {
+        contour.push_back(pt);
+        return;
+    }
+
+    i3 = i0;
+    prev_s = s ^ 4;
+
+    /* follow border */
+    for( ;; )
+    {
+        s_end = s;
+
+        for( ;; )
+        {
+            i4 = i3 + deltas[++s];
+            if( *i4 != 0 )
+                break;
+        }
+        s &= 7;
+
+        if( s != prev_s || method == 0 )
+        {
+            contour.push_back(pt);
+            prev_s = s;
+        }
+
+        pt.x += icvCodeDeltas[s].x;
+        pt.y += icvCodeDeltas[s].y;
+
+        if( i4 == i0 && i3 == i1 )
+            break;
+
+        i3 = i4;
+        s = (s + 4) & 7;
+    }
+}
+
+class ContourTraceInvoker : public ParallelLoopBody
+{
+public:
+    ContourTraceInvoker( const Mat& _img, const int* _starts, std::vector<Point>* _contours,
+                         int _method, Point _offset )
+        : img(&_img), starts(_starts), contours(_contours), method(_method), offset(_offset)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int width = img->cols;
+        for( int k = range.start; k < range.end; k++ )
+        {
+            int y = starts[k] / width, x = starts[k] - y*width;
+            bool isHole = img->at<uchar>(y, x) == 0;
+            x -= isHole;
+            traceContourBorder( img->ptr<uchar>(y) + x, (int)img->step, Point(x, y) + offset,
+                                isHole, method, contours[k] );
+        }
+    }
+
+private:
+    const Mat* img;
+    const int* starts;
+    std::vector<Point>* contours;
+    int method;
+    Point offset;
+};
+
+static void findContoursParallel( Mat& image, OutputArrayOfArrays _contours,
+                                  OutputArray _hierarchy, int mode, int method, Point offset )
+{
+    int width = image.cols, height = image.rows;
+
+    /* make zero borders and convert all pixels to 0 or 1, as cvStartFindContours does */
+    memset( image.ptr(0), 0, width );
+    memset( image.ptr(height - 1), 0, width );
+    for( int y = 1; y < height - 1; y++ )
+        image.at<uchar>(y, 0) = image.at<uchar>(y, width - 1) = 0;
+    threshold( image, image, 0, 1, THRESH_BINARY );
+
+    int nStripes = 1, nthreads = getNumThreads();
+    if( nthreads > 1 )
+        nStripes = std::max(std::min(std::min(nthreads*2, (int)(image.total() >> 15)), height/16), 1);
+
+    AutoBuffer<int> _labels(width*height);
+    int* labels = _labels;
+    std::vector<std::vector<int> > roots(nStripes);
+    parallel_for_(Range(0, nStripes), ContourLabelInvoker(image, labels, &roots[0], nStripes));
+
+    // merge the components across the stripe seams
+    for( int k = 1; k < nStripes; k++ )
+    {
+        int y = height*k/nStripes;
+        const uchar* src = image.ptr<uchar>(y);
+        const uchar* prev = image.ptr<uchar>(y - 1);
+        for( int x = 0; x < width; x++ )
+        {
+            int i = y*width + x;
+            if( src[x] )
+            {
+                if( prev[x-1] )
+                    contourMerge(labels, i, i - width - 1);
+                if( prev[x] )
+                    contourMerge(labels, i, i - width);
+                if( prev[x+1] )
+                    contourMerge(labels, i, i - width + 1);
+            }
+            else if( !prev[x] )
+                contourMerge(labels, i, i - width);
+        }
+    }
+
+    // the stripe-local roots now point to smaller indices only, so one pass in increasing
+    // order makes them point to the final roots. The remaining roots, except the frame
+    // background, start the borders in the order of the serial scan.
+    std::vector<int> starts;
+    for( int k = 0; k < nStripes; k++ )
+        for( size_t j = 0; j < roots[k].size(); j++ )
+        {
+            int r = roots[k][j];
+            labels[r] = labels[labels[r]];
+            if( labels[r] == r && r != 0 )
+                starts.push_back(r);
+        }
+
+    if( _hierarchy.needed() )
+        _hierarchy.clear();
+
+    int i, total = (int)starts.size();
+    if( total == 0 )
+    {
+        _contours.clear();
+        return;
+    }
+
+    /* find contour parents; total stands for the frame */
+    std::vector<int> links(total*4 + 1, -1);
+    int *parent = &links[0], *firstChild = parent + total, *hNext = firstChild + total + 1;
+    int *hPrev = hNext + total;
+    for( i = 0; i < total; i++ )
+    {
+        int r = starts[i];
+        bool isHole = image.at<uchar>(r / width, r % width) == 0;
+        // the pixel left of the start belongs to the component enclosing this one
+        int enclosing = labels[labels[r - 1]];
+        int p = total;
+
+        if( isHole ? mode != CV_RETR_LIST : mode == CV_RETR_TREE && enclosing != 0 )
+            p = (int)(std::lower_bound(starts.begin(), starts.end(), enclosing) - starts.begin());
+        parent[i] = p;
+
+        // a new child goes in front of its siblings, as in cvInsertNodeIntoTree
+        hNext[i] = firstChild[p];
+        if( firstChild[p] >= 0 )
+            hPrev[firstChild[p]] = i;
+        firstChild[p] = i;
+    }
+
+    /* the output order is the pre-order traversal of the tree, as in cvTreeToNodeSeq */
+    std::vector<int> order, index(total);
+    order.reserve(total);
+    for( i = firstChild[total]; i >= 0; )
+    {
+        index[i] = (int)order.size();
+        order.push_back(i);
+        if( firstChild[i] >= 0 )
+            i = firstChild[i];
+        else
+        {
+            while( i < total && hNext[i] < 0 )
+                i = parent[i];
+            i = i < total ? hNext[i] : -1;
+        }
+    }
+
+    std::vector<std::vector<Point> > contours(total);
+    parallel_for_(Range(0, total), ContourTraceInvoker(image, &starts[0], &contours[0], method, offset),
+                  std::min(total, nthreads*8));
+
+    _contours.create(total, 1, 0, -1, true);
+    if( _contours.kind() == _InputArray::STD_VECTOR_VECTOR && _contours.type() == CV_32SC2 )
+    {
+        std::vector<std::vector<Point> >& dst = *(std::vector<std::vector<Point> >*)_contours.obj;
+        for( i = 0; i < total; i++ )
+            dst[i].swap(contours[order[i]]);
+    }
+    else
+    {
+        for( i = 0; i < total; i++ )
+        {
+            const std::vector<Point>& c = contours[order[i]];
+            _contours.create((int)c.size(), 1, CV_32SC2, i, true);
+            Mat ci = _contours.getMat(i);
+            CV_Assert( ci.isContinuous() );
+            memcpy( ci.data, &c[0], c.size()*sizeof(c[0]) );
+        }
+    }
+
+    if( _hierarchy.needed() )
+    {
+        _hierarchy.create(1, total, CV_32SC4, -1, true);
+        Vec4i* hierarchy = _hierarchy.getMat().ptr<Vec4i>();
+
+        for( i = 0; i < total; i++ )
+        {
+            int k = order[i];
+            hierarchy[i] = Vec4i(hNext[k] >= 0 ? index[hNext[k]] : -1,
+                                 hPrev[k] >= 0 ? index[hPrev[k]] : -1,
+                                 firstChild[k] >= 0 ? index[firstChild[k]] : -1,
+                                 parent[k] < total ? index[parent[k]] : -1);
+        }
+    }
+}
+
+}
+
 void cv::findContours( InputOutputArray _image, OutputArrayOfArrays _contours,
                    OutputArray _hierarchy, int mode, int method, Point offset )
 {
     Mat image = _image.getMat();
-    MemStorage storage(cvCreateMemStorage());
+    if( image.type() == CV_8UC1 && image.rows >= 3 && image.cols >= 3 &&
+        (mode == CV_RETR_LIST || mode == CV_RETR_CCOMP || mode == CV_RETR_TREE) &&
+        (method == CV_CHAIN_APPROX_NONE || method == CV_CHAIN_APPROX_SIMPLE) )
+    {
+        findContoursParallel(image, _contours, _hierarchy, mode, method, offset);
+        return;
+    }
+
+    ThreadMemStorage storage;
     CvMat _cimage = image;
     CvSeq* _ccontours = 0;
     if( _hierarchy.needed() )
@@ -1939,7 +2304,7 @@ void cv::approxPolyDP( InputArray _curve, OutputArray _approxCurve,
     int npoints = curve.checkVector(2), depth = curve.depth();
     CV_Assert( npoints >= 0 && (depth == CV_32S || depth == CV_32F));
     CvMat _ccurve = curve;
-    MemStorage storage(cvCreateMemStorage());
+    ThreadMemStorage storage;
     CvSeq* result = cvApproxPoly(&_ccurve, sizeof(CvContour), storage, CV_POLY_APPROX_DP, epsilon, closed);
     if( result->total > 0 )
     {
@@ -2038,7 +2403,7 @@ void cv::convexityDefects( InputArray _points, InputArray _hull, OutputArray _de
     CV_Assert( ptnum > 3 );
     Mat hull = _hull.getMat();
     CV_Assert( hull.checkVector(1, CV_32S) > 2 );
-    Ptr<CvMemStorage> storage = cvCreateMemStorage();
+    ThreadMemStorage storage;
 
     CvMat c_points = points, c_hull = hull;
     CvSeq* seq = cvConvexityDefects(&c_points, &c_hull, storage);
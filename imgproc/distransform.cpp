@@ -63,164 +63,345 @@ icvInitTopBottom( int* temp, int tempstep, CvSize size, int border )
 }
 
 
-static CvStatus CV_STDCALL
-icvDistanceTransform_3x3_C1R( const uchar* src, int srcstep, int* temp,
-        int step, float* dist, int dststep, CvSize size, const float* metrics )
+/*
+   The 3x3/5x5 chamfer and the 8-bit L1 transforms are two sweeps, top-down and then
+   bottom-up, where every row only depends on the BORDER rows swept before it. Each
+   stripe of rows runs both sweeps on its own, as if the rows beyond it were empty,
+   which can only overestimate the distances. Then the rows next to every seam are
+   recomputed serially from the exact rows across the seam, until BORDER recomputed
+   rows in a row come out unchanged; the rest of the stripe is exact already. In the
+   backward sweep the recomputation starts from the stripe's estimate instead of the
+   forward result. That is exact as long as no step of the mask is shorter than the
+   horizontal one, so other user masks are swept in one stripe.
+*/
+
+namespace cv
 {
-    const int BORDER = 1;
-    int i, j;
-    const int HV_DIST = CV_FLT_TO_FIX( metrics[0], ICV_DIST_SHIFT );
-    const int DIAG_DIST = CV_FLT_TO_FIX( metrics[1], ICV_DIST_SHIFT );
-    const float scale = 1.f/(1 << ICV_DIST_SHIFT);
 
-    srcstep /= sizeof(src[0]);
-    step /= sizeof(temp[0]);
-    dststep /= sizeof(dist[0]);
+#if CV_SSE2
+static inline __m128i dtMin32( __m128i a, __m128i b )
+{
+    __m128i m = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(m, b), _mm_andnot_si128(m, a));
+}
+#endif
 
-    icvInitTopBottom( temp, step, size, BORDER );
+struct DTChamferRows
+{
+    typedef int value_type;
 
-    // forward pass
-    for( i = 0; i < size.height; i++ )
+    DTChamferRows( const CvMat* _src, Mat& _temp, CvMat* _dst, int _border, const float* metrics )
     {
-        const uchar* s = src + i*srcstep;
-        int* tmp = (int*)(temp + (i+BORDER)*step) + BORDER;
+        src = _src;
+        temp = &_temp;
+        dst = _dst;
+        border = _border;
+        cols = src->cols;
+        hvDist = CV_FLT_TO_FIX( metrics[0], ICV_DIST_SHIFT );
+        diagDist = CV_FLT_TO_FIX( metrics[1], ICV_DIST_SHIFT );
+        longDist = border > 1 ? CV_FLT_TO_FIX( metrics[2], ICV_DIST_SHIFT ) : INT_MAX;
+        infRow.assign(cols + border*2, ICV_INIT_DIST0);
+        useSIMD = false;
+    #if CV_SSE2
+        useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+    #endif
+    }
 
-        for( j = 0; j < BORDER; j++ )
-            tmp[-j-1] = tmp[size.width + j] = ICV_INIT_DIST0;
+    int* row( int i ) const { return temp->ptr<int>(i) + border; }
 
-        for( j = 0; j < size.width; j++ )
+    // forward sweep of row i into out; the rows above top are taken as empty
+    void forward( int i, int top, int* out, int* u ) const
+    {
+        const uchar* s = src->data.ptr + i*src->step;
+        const int* p1 = i - 1 >= top ? row(i - 1) : &infRow[border];
+        const int* p2 = i - 2 >= top ? row(i - 2) : &infRow[border];
+        const int width = cols, HV_DIST = hvDist, DIAG_DIST = diagDist, LONG_DIST = longDist;
+        const bool mask5 = border > 1;
+        int j = 0, t;
+
+        for( j = 0; j < border; j++ )
+            out[-j-1] = out[width + j] = ICV_INIT_DIST0;
+
+        j = 0;
+    #if CV_SSE2
+        if( useSIMD )
         {
-            if( !s[j] )
-                tmp[j] = 0;
-            else
+            __m128i hv = _mm_set1_epi32(HV_DIST), diag = _mm_set1_epi32(DIAG_DIST);
+            __m128i ldist = _mm_set1_epi32(LONG_DIST);
+            for( ; j <= width - 4; j += 4 )
             {
-                int t0 = tmp[j-step-1] + DIAG_DIST;
-                int t = tmp[j-step] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-step+1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-1] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                tmp[j] = t0;
+                __m128i t0 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p1 + j - 1)), diag);
+                t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p1 + j)), hv));
+                t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p1 + j + 1)), diag));
+                if( mask5 )
+                {
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p2 + j - 1)), ldist));
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p2 + j + 1)), ldist));
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p1 + j - 2)), ldist));
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p1 + j + 2)), ldist));
+                }
+                _mm_storeu_si128((__m128i*)(u + j), t0);
             }
         }
+    #endif
+        for( ; j < width; j++ )
+        {
+            int t0 = std::min(std::min(p1[j-1] + DIAG_DIST, p1[j] + HV_DIST), p1[j+1] + DIAG_DIST);
+            if( mask5 )
+                t0 = std::min(std::min(std::min(t0, p2[j-1] + LONG_DIST), std::min(p2[j+1] + LONG_DIST,
+                              p1[j-2] + LONG_DIST)), p1[j+2] + LONG_DIST);
+            u[j] = t0;
+        }
+
+        for( j = 0, t = ICV_INIT_DIST0; j < width; j++ )
+        {
+            t = s[j] ? std::min(t + HV_DIST, u[j]) : 0;
+            out[j] = t;
+        }
     }
 
-    // backward pass
-    for( i = size.height - 1; i >= 0; i-- )
+    // backward sweep of row i into out, also storing the distances; the rows from bottom on are taken as empty
+    void backward( int i, int bottom, int* out, int* v ) const
     {
-        float* d = (float*)(dist + i*dststep);
-        int* tmp = (int*)(temp + (i+BORDER)*step) + BORDER;
+        const int* in = row(i);
+        const int* q1 = i + 1 < bottom ? row(i + 1) : &infRow[border];
+        const int* q2 = i + 2 < bottom ? row(i + 2) : &infRow[border];
+        const int width = cols, HV_DIST = hvDist, DIAG_DIST = diagDist, LONG_DIST = longDist;
+        const bool mask5 = border > 1;
+        const float scale = 1.f/(1 << ICV_DIST_SHIFT);
+        int j = 0, t;
+
+    #if CV_SSE2
+        if( useSIMD )
+        {
+            __m128i hv = _mm_set1_epi32(HV_DIST), diag = _mm_set1_epi32(DIAG_DIST);
+            __m128i ldist = _mm_set1_epi32(LONG_DIST);
+            for( ; j <= width - 4; j += 4 )
+            {
+                __m128i t0 = _mm_loadu_si128((const __m128i*)(in + j));
+                t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q1 + j - 1)), diag));
+                t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q1 + j)), hv));
+                t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q1 + j + 1)), diag));
+                if( mask5 )
+                {
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q2 + j - 1)), ldist));
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q2 + j + 1)), ldist));
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q1 + j - 2)), ldist));
+                    t0 = dtMin32(t0, _mm_add_epi32(_mm_loadu_si128((const __m128i*)(q1 + j + 2)), ldist));
+                }
+                _mm_storeu_si128((__m128i*)(v + j), t0);
+            }
+        }
+    #endif
+        for( ; j < width; j++ )
+        {
+            int t0 = std::min(std::min(in[j], q1[j-1] + DIAG_DIST), std::min(q1[j] + HV_DIST, q1[j+1] + DIAG_DIST));
+            if( mask5 )
+                t0 = std::min(std::min(std::min(t0, q2[j-1] + LONG_DIST), std::min(q2[j+1] + LONG_DIST,
+                              q1[j-2] + LONG_DIST)), q1[j+2] + LONG_DIST);
+            v[j] = t0;
+        }
 
-        for( j = size.width - 1; j >= 0; j-- )
+        // the pixels at most one horizontal step away from the zero ones are final already
+        for( j = width - 1, t = ICV_INIT_DIST0; j >= 0; j-- )
         {
-            int t0 = tmp[j];
-            if( t0 > HV_DIST )
+            t = in[j] > HV_DIST ? std::min(t + HV_DIST, v[j]) : in[j];
+            out[j] = t;
+        }
+
+        j = 0;
+        if( CV_MAT_TYPE(dst->type) == CV_32FC1 )
+        {
+            float* d = (float*)(dst->data.ptr + i*dst->step);
+        #if CV_SSE2
+            if( useSIMD )
             {
-                int t = tmp[j+step+1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step-1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+1] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                tmp[j] = t0;
+                __m128 scale4 = _mm_set1_ps(scale);
+                for( ; j <= width - 4; j += 4 )
+                    _mm_storeu_ps(d + j, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(out + j))), scale4));
             }
-            d[j] = (float)(t0 * scale);
+        #endif
+            for( ; j < width; j++ )
+                d[j] = (float)(out[j] * scale);
+        }
+        else
+        {
+            ushort* d = (ushort*)(dst->data.ptr + i*dst->step);
+            for( ; j < width; j++ )
+                d[j] = saturate_cast<ushort>(out[j] * scale);
         }
     }
 
-    return CV_OK;
-}
-
+    const CvMat* src;
+    Mat* temp;
+    CvMat* dst;
+    int border, cols;
+    int hvDist, diagDist, longDist;
+    std::vector<int> infRow;
+    bool useSIMD;
+};
 
-static CvStatus CV_STDCALL
-icvDistanceTransform_5x5_C1R( const uchar* src, int srcstep, int* temp,
-        int step, float* dist, int dststep, CvSize size, const float* metrics )
+// the 8-bit L1 transform is computed in place, in dst, with distances saturated at 255
+struct DTL1Rows
 {
-    const int BORDER = 2;
-    int i, j;
-    const int HV_DIST = CV_FLT_TO_FIX( metrics[0], ICV_DIST_SHIFT );
-    const int DIAG_DIST = CV_FLT_TO_FIX( metrics[1], ICV_DIST_SHIFT );
-    const int LONG_DIST = CV_FLT_TO_FIX( metrics[2], ICV_DIST_SHIFT );
-    const float scale = 1.f/(1 << ICV_DIST_SHIFT);
+    typedef uchar value_type;
 
-    srcstep /= sizeof(src[0]);
-    step /= sizeof(temp[0]);
-    dststep /= sizeof(dist[0]);
+    DTL1Rows( const CvMat* _src, CvMat* _dst )
+    {
+        src = _src;
+        dst = _dst;
+        border = 1;
+        cols = src->cols;
+        height = src->rows;
+        emptyRow.assign(cols, (uchar)255);
+    }
 
-    icvInitTopBottom( temp, step, size, BORDER );
+    uchar* row( int i ) const { return dst->data.ptr + i*dst->step; }
 
-    // forward pass
-    for( i = 0; i < size.height; i++ )
+    void forward( int i, int top, uchar* out, int* ) const
     {
-        const uchar* s = src + i*srcstep;
-        int* tmp = (int*)(temp + (i+BORDER)*step) + BORDER;
+        const uchar* s = src->data.ptr + i*src->step;
+        const uchar* up = i - 1 >= top ? row(i - 1) : &emptyRow[0];
+        const int width = cols;
 
-        for( j = 0; j < BORDER; j++ )
-            tmp[-j-1] = tmp[size.width + j] = ICV_INIT_DIST0;
+        // the first row and column see 255 (empty) above and to the left
+        for( int x = 0, a = 255; x < width; x++ )
+        {
+            a = s[x] == 0 ? 0 : std::min(std::min(a, (int)up[x]) + 1, 255);
+            out[x] = (uchar)a;
+        }
+    }
 
-        for( j = 0; j < size.width; j++ )
+    void backward( int i, int bottom, uchar* out, int* ) const
+    {
+        const uchar* in = row(i);
+        const int width = cols;
+        int a, x;
+
+        if( i == height - 1 )
         {
-            if( !s[j] )
-                tmp[j] = 0;
-            else
+            // do last row east pixel scan here (skip bottom right pixel)
+            a = out[width-1] = in[width-1];
+            for( x = width - 2; x >= 0; x-- )
             {
-                int t0 = tmp[j-step*2-1] + LONG_DIST;
-                int t = tmp[j-step*2+1] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-step-2] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-step-1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-step] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-step+1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-step+2] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j-1] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                tmp[j] = t0;
+                a = std::min(std::min(a + 1, 255), (int)in[x]);
+                out[x] = (uchar)a;
             }
+            return;
+        }
+
+        const uchar* down = i + 1 < bottom ? row(i + 1) : &emptyRow[0];
+
+        // right edge is the only error case
+        a = std::min(down[width-1] + 1, 255);
+        out[width-1] = (uchar)std::min(a, (int)in[width-1]);
+        for( x = width - 2; x >= 0; x-- )
+        {
+            a = std::min(std::min(a, (int)down[x]) + 1, 255);
+            out[x] = (uchar)std::min(a, (int)in[x]);
         }
     }
 
-    // backward pass
-    for( i = size.height - 1; i >= 0; i-- )
+    const CvMat* src;
+    CvMat* dst;
+    int border, cols, height;
+    std::vector<uchar> emptyRow;
+};
+
+template<class Rows> struct DTSweepInvoker : ParallelLoopBody
+{
+    DTSweepInvoker( const Rows& _rows, int _height, int _nStripes, bool _forward )
     {
-        float* d = (float*)(dist + i*dststep);
-        int* tmp = (int*)(temp + (i+BORDER)*step) + BORDER;
+        rows = &_rows;
+        height = _height;
+        nStripes = _nStripes;
+        forward = _forward;
+    }
 
-        for( j = size.width - 1; j >= 0; j-- )
+    void operator()( const Range& range ) const
+    {
+        int i, row0 = height*range.start/nStripes, row1 = height*range.end/nStripes;
+        AutoBuffer<int> _buf(rows->cols);
+        int* buf = _buf;
+
+        if( forward )
+            for( i = row0; i < row1; i++ )
+                rows->forward(i, row0, rows->row(i), buf);
+        else
+            for( i = row1 - 1; i >= row0; i-- )
+                rows->backward(i, row1, rows->row(i), buf);
+    }
+
+    const Rows* rows;
+    int height;
+    int nStripes;
+    bool forward;
+};
+
+template<class Rows> static void
+distanceSweeps( const Rows& rows, int height, int nStripes )
+{
+    typedef typename Rows::value_type T;
+    int border = rows.border, width = rows.cols;
+    size_t rowSize = width*sizeof(T);
+    AutoBuffer<T> _scratch(width + border*2);
+    AutoBuffer<int> _buf(width);
+    T* scratch = (T*)_scratch + border;
+    int* buf = _buf;
+
+    parallel_for_(Range(0, nStripes), DTSweepInvoker<Rows>(rows, height, nStripes, true));
+
+    for( int k = 1; k < nStripes; k++ )
+        for( int i = height*k/nStripes, same = 0; i < height && same < border; i++ )
         {
-            int t0 = tmp[j];
-            if( t0 > HV_DIST )
+            rows.forward(i, 0, scratch, buf);
+            if( memcmp(scratch, rows.row(i), rowSize) == 0 )
+                same++;
+            else
             {
-                int t = tmp[j+step*2+1] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step*2-1] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step+2] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step+1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step-1] + DIAG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+step-2] + LONG_DIST;
-                if( t0 > t ) t0 = t;
-                t = tmp[j+1] + HV_DIST;
-                if( t0 > t ) t0 = t;
-                tmp[j] = t0;
+                memcpy(rows.row(i), scratch, rowSize);
+                same = 0;
             }
-            d[j] = (float)(t0 * scale);
         }
-    }
 
-    return CV_OK;
+    parallel_for_(Range(0, nStripes), DTSweepInvoker<Rows>(rows, height, nStripes, false));
+
+    for( int k = nStripes - 1; k > 0; k-- )
+        for( int i = height*k/nStripes - 1, same = 0; i >= 0 && same < border; i-- )
+        {
+            rows.backward(i, height, scratch, buf);
+            if( memcmp(scratch, rows.row(i), rowSize) == 0 )
+                same++;
+            else
+            {
+                memcpy(rows.row(i), scratch, rowSize);
+                same = 0;
+            }
+        }
+}
+
+static int distanceStripes( int rows, int cols )
+{
+    int nthreads = getNumThreads();
+    if( nthreads <= 1 )
+        return 1;
+    return std::max(std::min(std::min(nthreads*2, (rows*cols) >> 15), rows/32), 1);
+}
+
+}
+
+/* 3x3 or 5x5 chamfer distance transform into a 32fC1 or 16uC1 map */
+static void
+icvDistanceTransformChamfer( const CvMat* src, CvMat* dst, int maskSize, const float* metrics )
+{
+    int border = maskSize == CV_DIST_MASK_3 ? 1 : 2;
+    cv::Mat temp(src->rows, src->cols + border*2, CV_32S);
+    cv::DTChamferRows rows(src, temp, dst, border, metrics);
+    int nStripes = 1;
+
+    if( rows.diagDist >= rows.hvDist && rows.longDist >= rows.hvDist )
+        nStripes = cv::distanceStripes(src->rows, src->cols);
+    cv::distanceSweeps(rows, src->rows, nStripes);
 }
 
 
@@ -613,11 +794,6 @@ typedef CvStatus (CV_STDCALL * CvIPPDistTransFunc2)( uchar* src, int srcstep,
 
 /***********************************************************************************/
 
-typedef CvStatus (CV_STDCALL * CvDistTransFunc)( const uchar* src, int srcstep,
-                                                 int* temp, int tempstep,
-                                                 float* dst, int dststep,
-                                                 CvSize size, const float* metrics );
-
 
 /****************************************************************************************\
  Non-inplace and Inplace 8u->8u Distance Transform for CityBlock (a.k.a. L1) metric
@@ -629,74 +805,11 @@ typedef CvStatus (CV_STDCALL * CvDistTransFunc)( const uchar* src, int srcstep,
 static void
 icvDistanceATS_L1_8u( const CvMat* src, CvMat* dst )
 {
-    int width = src->cols, height = src->rows;
-
-    int a;
-    uchar lut[256];
-    int x, y;
-
-    const uchar *sbase = src->data.ptr;
-    uchar *dbase = dst->data.ptr;
-    int srcstep = src->step;
-    int dststep = dst->step;
-
     CV_Assert( CV_IS_MASK_ARR( src ) && CV_MAT_TYPE( dst->type ) == CV_8UC1 );
     CV_Assert( CV_ARE_SIZES_EQ( src, dst ));
 
-    ////////////////////// forward scan ////////////////////////
-    for( x = 0; x < 256; x++ )
-        lut[x] = CV_CAST_8U(x+1);
-
-    //init first pixel to max (we're going to be skipping it)
-    dbase[0] = (uchar)(sbase[0] == 0 ? 0 : 255);
-
-    //first row (scan west only, skip first pixel)
-    for( x = 1; x < width; x++ )
-        dbase[x] = (uchar)(sbase[x] == 0 ? 0 : lut[dbase[x-1]]);
-
-    for( y = 1; y < height; y++ )
-    {
-        sbase += srcstep;
-        dbase += dststep;
-
-        //for left edge, scan north only
-        a = sbase[0] == 0 ? 0 : lut[dbase[-dststep]];
-        dbase[0] = (uchar)a;
-
-        for( x = 1; x < width; x++ )
-        {
-            a = sbase[x] == 0 ? 0 : lut[MIN(a, dbase[x - dststep])];
-            dbase[x] = (uchar)a;
-        }
-    }
-
-    ////////////////////// backward scan ///////////////////////
-
-    a = dbase[width-1];
-
-    // do last row east pixel scan here (skip bottom right pixel)
-    for( x = width - 2; x >= 0; x-- )
-    {
-        a = lut[a];
-        dbase[x] = (uchar)(CV_CALC_MIN_8U(a, dbase[x]));
-    }
-
-    // right edge is the only error case
-    for( y = height - 2; y >= 0; y-- )
-    {
-        dbase -= dststep;
-
-        // do right edge
-        a = lut[dbase[width-1+dststep]];
-        dbase[width-1] = (uchar)(MIN(a, dbase[width-1]));
-
-        for( x = width - 2; x >= 0; x-- )
-        {
-            int b = dbase[x+dststep];
-            a = lut[MIN(a, b)];
-            dbase[x] = (uchar)(MIN(a, dbase[x]));
-        }
-    }
+    cv::DTL1Rows rows(src, dst);
+    cv::distanceSweeps(rows, src->rows, cv::distanceStripes(src->rows, src->cols));
 }
 //END ATS ADDITION
 
@@ -717,10 +830,11 @@ cvDistTransform( const void* srcarr, void* dstarr,
     dst = cvGetMat( dst, &dststub );
 
     if( !CV_IS_MASK_ARR( src ) || (CV_MAT_TYPE( dst->type ) != CV_32FC1 &&
+        (CV_MAT_TYPE(dst->type) != CV_16UC1 || labels) &&
         (CV_MAT_TYPE(dst->type) != CV_8UC1 || distType != CV_DIST_L1 || labels)) )
         CV_Error( CV_StsUnsupportedFormat,
         "source image must be 8uC1 and the distance map must be 32fC1 "
-        "(or 8uC1 in case of simple L1 distance transform)" );
+        "(or 16uC1 without labels, or 8uC1 in case of simple L1 distance transform)" );
 
     if( !CV_ARE_SIZES_EQ( src, dst ))
         CV_Error( CV_StsUnmatchedSizes, "the source and the destination images must be of the same size" );
@@ -735,7 +849,15 @@ cvDistTransform( const void* srcarr, void* dstarr,
 
     if( maskSize == CV_DIST_MASK_PRECISE )
     {
-        icvTrueDistTrans( src, dst );
+        if( CV_MAT_TYPE(dst->type) == CV_16UC1 )
+        {
+            cv::Mat fdst(dst->rows, dst->cols, CV_32F);
+            CvMat _fdst = fdst;
+            icvTrueDistTrans( src, &_fdst );
+            fdst.convertTo(cv::cvarrToMat(dst), CV_16U);
+        }
+        else
+            icvTrueDistTrans( src, dst );
         return;
     }
 
@@ -772,67 +894,59 @@ cvDistTransform( const void* srcarr, void* dstarr,
     {
         icvDistanceATS_L1_8u( src, dst );
     }
+    else if( !labels )
+    {
+    #if defined (HAVE_IPP) && (IPP_VERSION_MAJOR >= 7)
+        if( maskSize == CV_DIST_MASK_5 && CV_MAT_TYPE(dst->type) == CV_32FC1 )
+        {
+            IppiSize roi = { src->cols, src->rows };
+            if( ippiDistanceTransform_5x5_8u32f_C1R(
+                    src->data.ptr, src->step,
+                    dst->data.fl, dst->step, roi, _mask) >= 0 )
+                return;
+        }
+    #endif
+        icvDistanceTransformChamfer( src, dst, maskSize, _mask );
+    }
     else
     {
         int border = maskSize == CV_DIST_MASK_3 ? 1 : 2;
         cv::Ptr<CvMat> temp = cvCreateMat( size.height + border*2, size.width + border*2, CV_32SC1 );
 
-        if( !labels )
+        cvZero( labels );
+
+        if( labelType == CV_DIST_LABEL_CCOMP )
         {
-        #if defined (HAVE_IPP) && (IPP_VERSION_MAJOR >= 7)
-            if( maskSize == CV_DIST_MASK_5 )
+            CvSeq *contours = 0;
+            cv::Ptr<CvMemStorage> st = cvCreateMemStorage();
+            cv::Ptr<CvMat> src_copy = cvCreateMat( size.height+border*2, size.width+border*2, src->type );
+            cvCopyMakeBorder(src, src_copy, cvPoint(border, border), IPL_BORDER_CONSTANT, cvScalarAll(255));
+            cvCmpS( src_copy, 0, src_copy, CV_CMP_EQ );
+            cvFindContours( src_copy, st, &contours, sizeof(CvContour),
+                           CV_RETR_CCOMP, CV_CHAIN_APPROX_SIMPLE, cvPoint(-border, -border));
+
+            for( int label = 1; contours != 0; contours = contours->h_next, label++ )
             {
-                IppiSize roi = { src->cols, src->rows };
-                if( ippiDistanceTransform_5x5_8u32f_C1R(
-                        src->data.ptr, src->step,
-                        dst->data.fl, dst->step, roi, _mask) >= 0 )
-                    return;
+                CvScalar area_color = cvScalarAll(label);
+                cvDrawContours( labels, contours, area_color, area_color, -255, -1, 8 );
             }
-        #endif
-            CvDistTransFunc func = maskSize == CV_DIST_MASK_3 ?
-                icvDistanceTransform_3x3_C1R :
-                icvDistanceTransform_5x5_C1R;
-
-            func( src->data.ptr, src->step, temp->data.i, temp->step,
-                  dst->data.fl, dst->step, size, _mask );
         }
         else
         {
-            cvZero( labels );
-
-            if( labelType == CV_DIST_LABEL_CCOMP )
-            {
-                CvSeq *contours = 0;
-                cv::Ptr<CvMemStorage> st = cvCreateMemStorage();
-                cv::Ptr<CvMat> src_copy = cvCreateMat( size.height+border*2, size.width+border*2, src->type );
-                cvCopyMakeBorder(src, src_copy, cvPoint(border, border), IPL_BORDER_CONSTANT, cvScalarAll(255));
-                cvCmpS( src_copy, 0, src_copy, CV_CMP_EQ );
-                cvFindContours( src_copy, st, &contours, sizeof(CvContour),
-                               CV_RETR_CCOMP, CV_CHAIN_APPROX_SIMPLE, cvPoint(-border, -border));
-
-                for( int label = 1; contours != 0; contours = contours->h_next, label++ )
-                {
-                    CvScalar area_color = cvScalarAll(label);
-                    cvDrawContours( labels, contours, area_color, area_color, -255, -1, 8 );
-                }
-            }
-            else
+            int k = 1;
+            for( int i = 0; i < src->rows; i++ )
             {
-                int k = 1;
-                for( int i = 0; i < src->rows; i++ )
-                {
-                    const uchar* srcptr = src->data.ptr + src->step*i;
-                    int* labelptr = (int*)(labels->data.ptr + labels->step*i);
+                const uchar* srcptr = src->data.ptr + src->step*i;
+                int* labelptr = (int*)(labels->data.ptr + labels->step*i);
 
-                    for( int j = 0; j < src->cols; j++ )
-                        if( srcptr[j] == 0 )
-                            labelptr[j] = k++;
-                }
+                for( int j = 0; j < src->cols; j++ )
+                    if( srcptr[j] == 0 )
+                        labelptr[j] = k++;
             }
-
-            icvDistanceTransformEx_5x5_C1R( src->data.ptr, src->step, temp->data.i, temp->step,
-                        dst->data.fl, dst->step, labels->data.i, labels->step, size, _mask );
         }
+
+        icvDistanceTransformEx_5x5_C1R( src->data.ptr, src->step, temp->data.i, temp->step,
+                    dst->data.fl, dst->step, labels->data.i, labels->step, size, _mask );
     }
 }
 
@@ -848,9 +962,16 @@ void cv::distanceTransform( InputArray _src, OutputArray _dst, OutputArray _labe
 
 void cv::distanceTransform( InputArray _src, OutputArray _dst,
                             int distanceType, int maskSize )
+{
+    distanceTransform( _src, _dst, distanceType, maskSize, CV_32F );
+}
+
+void cv::distanceTransform( InputArray _src, OutputArray _dst,
+                            int distanceType, int maskSize, int dstType )
 {
     Mat src = _src.getMat();
-    _dst.create(src.size(), CV_32F);
+    CV_Assert( dstType == CV_32F || dstType == CV_16U || (dstType == CV_8U && distanceType == CV_DIST_L1) );
+    _dst.create(src.size(), dstType);
     Mat dst = _dst.getMat();
     CvMat c_src = src, c_dst = _dst.getMat();
     cvDistTransform(&c_src, &c_dst, distanceType, maskSize, 0, 0, -1);
@@ -41,6 +41,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "avx2/filter_avx2.hpp"
 
 extern "C" {
 extern volatile int cvwidth, cvheight, cvdepth;
@@ -109,10 +110,12 @@ BaseRowFilter::~BaseRowFilter() {}
 BaseColumnFilter::BaseColumnFilter() { ksize = anchor = -1; }
 BaseColumnFilter::~BaseColumnFilter() {}
 void BaseColumnFilter::reset() {}
+Ptr<BaseColumnFilter> BaseColumnFilter::clone() const { return Ptr<BaseColumnFilter>(); }
 
 BaseFilter::BaseFilter() { ksize = Size(-1,-1); anchor = Point(-1,-1); }
 BaseFilter::~BaseFilter() {}
 void BaseFilter::reset() {}
+Ptr<BaseFilter> BaseFilter::clone() const { return Ptr<BaseFilter>(); }
 
 FilterEngine::FilterEngine()
 {
@@ -443,6 +446,81 @@ int FilterEngine::proceed( const uchar* src, int srcstep, int count,
 }
 
 
+static void runFilterEngine(FilterEngine& f, const Mat& src, Mat& dst,
+                            const Rect& srcRoi, Point dstOfs, bool isolated)
+{
+    int y = f.start(src, srcRoi, isolated);
+    f.proceed( src.data + y*src.step
+               + srcRoi.x*src.elemSize(),
+               (int)src.step, f.endY - f.startY,
+               dst.data + dstOfs.y*dst.step +
+               dstOfs.x*dst.elemSize(), (int)dst.step );
+}
+
+/*
+ Each stripe is processed by its own copy of the engine (ring buffer, border tables and
+ the stateful column/2D filters). The rows above and below the stripe are read from the
+ source as in the whole-image run, so the result does not depend on the number of stripes.
+*/
+class FilterEngineRunner : public ParallelLoopBody
+{
+public:
+    FilterEngineRunner(const FilterEngine& _engine, const Mat& _src, Mat& _dst,
+                       const Rect& _srcRoi, Point _dstOfs, bool _isolated, int _nStripes)
+        : engine(&_engine), src(_src), dst(_dst), srcRoi(_srcRoi), dstOfs(_dstOfs),
+          isolated(_isolated), nStripes(_nStripes)
+    {
+    }
+
+    void operator () ( const Range& range ) const
+    {
+        int row0 = srcRoi.height*range.start/nStripes;
+        int row1 = srcRoi.height*range.end/nStripes;
+        if( row0 >= row1 )
+            return;
+
+        FilterEngine f(*engine);
+        if( !f.isSeparable() )
+            f.filter2D = engine->filter2D->clone();
+        else
+            f.columnFilter = engine->columnFilter->clone();
+
+        Mat _dst = dst;
+        runFilterEngine( f, src, _dst, Rect(srcRoi.x, srcRoi.y + row0, srcRoi.width, row1 - row0),
+                         Point(dstOfs.x, dstOfs.y + row0), isolated );
+    }
+
+private:
+    const FilterEngine* engine;
+    Mat src;
+    Mat dst;
+    Rect srcRoi;
+    Point dstOfs;
+    bool isolated;
+    int nStripes;
+};
+
+static int getFilterStripes(const FilterEngine& f, const Mat& src, const Mat& dst, const Rect& srcRoi)
+{
+    const int minStripeArea = 1 << 15;
+    int nthreads = getNumThreads();
+
+    // in-place filtering relies on the rows being processed sequentially
+    if( nthreads <= 1 ||
+        (dst.datastart < src.dataend && src.datastart < dst.dataend) )
+        return 1;
+
+    // the first ksize.height-1 rows of every stripe are filtered twice, so keep the stripes tall
+    int maxStripes = std::min(srcRoi.area()/minStripeArea, srcRoi.height/(f.ksize.height*4));
+    if( maxStripes <= 1 )
+        return 1;
+
+    if( f.isSeparable() ? f.columnFilter->clone().empty() : f.filter2D->clone().empty() )
+        return 1;
+
+    return std::min(nthreads*2, maxStripes);
+}
+
 void FilterEngine::apply(const Mat& src, Mat& dst,
     const Rect& _srcRoi, Point dstOfs, bool isolated)
 {
@@ -459,12 +537,21 @@ void FilterEngine::apply(const Mat& src, Mat& dst,
         dstOfs.x + srcRoi.width <= dst.cols &&
         dstOfs.y + srcRoi.height <= dst.rows );
 
-    int y = start(src, srcRoi, isolated);
-    proceed( src.data + y*src.step
-             + srcRoi.x*src.elemSize(),
-             (int)src.step, endY - startY,
-             dst.data + dstOfs.y*dst.step +
-             dstOfs.x*dst.elemSize(), (int)dst.step );
+    int nStripes = getFilterStripes(*this, src, dst, srcRoi);
+    if( nStripes > 1 )
+    {
+        // exceptions must not escape the stripe bodies, so validate the ROI and
+        // the border modes the stripes will use here, on the calling thread
+        start(src, srcRoi, isolated);
+        if( roi.y < anchor.y || roi.y + roi.height + ksize.height - anchor.y - 1 > wholeSize.height )
+            borderInterpolate(-1, wholeSize.height, columnBorderType);
+
+        parallel_for_(Range(0, nStripes),
+                      FilterEngineRunner(*this, src, dst, srcRoi, dstOfs, isolated, nStripes));
+        return;
+    }
+
+    runFilterEngine( *this, src, dst, srcRoi, dstOfs, isolated );
 }
 
 }
@@ -555,20 +642,23 @@ struct FilterNoVec
 
 struct RowVec_8u32s
 {
-    RowVec_8u32s() { smallValues = false; }
+    RowVec_8u32s() { smallValues = symmetrical = false; }
     RowVec_8u32s( const Mat& _kernel )
     {
         kernel = _kernel;
-        smallValues = true;
+        smallValues = symmetrical = true;
         int k, ksize = kernel.rows + kernel.cols - 1;
+        const int* kx = (const int*)kernel.data;
         for( k = 0; k < ksize; k++ )
         {
-            int v = ((const int*)kernel.data)[k];
+            int v = kx[k];
             if( v < SHRT_MIN || v > SHRT_MAX )
             {
                 smallValues = false;
                 break;
             }
+            if( v != kx[ksize - 1 - k] )
+                symmetrical = false;
         }
     }
 
@@ -584,6 +674,9 @@ struct RowVec_8u32s
 
         if( smallValues )
         {
+            if( checkHardwareSupport(CV_CPU_AVX2) )
+                i = RowVec_8u32s_avx2(_src, _dst, _kx, _ksize, symmetrical, width, cn);
+
             for( ; i <= width - 16; i += 16 )
             {
                 const uchar* src = _src + i;
@@ -641,6 +734,7 @@ struct RowVec_8u32s
 
     Mat kernel;
     bool smallValues;
+    bool symmetrical;
 };
 
 
@@ -676,8 +770,10 @@ struct SymmRowSmallVec_8u32s
         if( !smallValues )
             return 0;
 
-        src += (_ksize/2)*cn;
         width *= cn;
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmRowSmallVec_8u32s_avx2(src, _dst, kx, _ksize, symmetrical, width, cn);
+        src += (_ksize/2)*cn + i;
 
         __m128i z = _mm_setzero_si128();
         if( symmetrical )
@@ -998,6 +1094,9 @@ struct SymmColumnVec_32s8u
         const __m128i *S, *S2;
         __m128 d4 = _mm_set1_ps(delta);
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmColumnVec_32s8u_avx2(_src, dst, ky, ksize2, symmetrical, delta, width);
+
         if( symmetrical )
         {
             for( ; i <= width - 16; i += 16 )
@@ -1148,6 +1247,9 @@ struct SymmColumnSmallVec_32s16s
         __m128 df4 = _mm_set1_ps(delta);
         __m128i d4 = _mm_cvtps_epi32(df4);
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmColumnSmallVec_32s16s_avx2(_src, _dst, ky, symmetrical, delta, width);
+
         if( symmetrical )
         {
             if( ky[0] == 2 && ky[1] == 1 )
@@ -1275,6 +1377,9 @@ struct RowVec_16s32f
         const float* _kx = (const float*)kernel.data;
         width *= cn;
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = RowVec_16s32f_avx2(_src, _dst, _kx, _ksize, width, cn);
+
         for( ; i <= width - 8; i += 8 )
         {
             const short* src = (const short*)_src + i;
@@ -1329,6 +1434,9 @@ struct SymmColumnVec_32f16s
         short* dst = (short*)_dst;
         __m128 d4 = _mm_set1_ps(delta);
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmColumnVec_32f16s_avx2(_src, _dst, ky, ksize2, symmetrical, delta, width);
+
         if( symmetrical )
         {
             for( ; i <= width - 16; i += 16 )
@@ -1505,6 +1613,9 @@ struct RowVec_32f
         int i = 0, k;
         width *= cn;
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = RowVec_32f_avx2(_src, _dst, _kx, _ksize, width, cn);
+
         for( ; i <= width - 8; i += 8 )
         {
             const float* src = src0 + i;
@@ -1554,6 +1665,10 @@ struct SymmRowSmallVec_32f
         const float* kx = (const float*)kernel.data + _ksize/2;
         width *= cn;
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmRowSmallVec_32f_avx2(_src, _dst, kx, _ksize, symmetrical, width, cn);
+        src += i;
+
         if( symmetrical )
         {
             if( _ksize == 1 )
@@ -1751,6 +1866,9 @@ struct SymmColumnVec_32f
         float* dst = (float*)_dst;
         __m128 d4 = _mm_set1_ps(delta);
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmColumnVec_32f_avx2(_src, _dst, ky, ksize2, symmetrical, delta, width);
+
         if( symmetrical )
         {
             for( ; i <= width - 16; i += 16 )
@@ -1891,6 +2009,9 @@ struct SymmColumnSmallVec_32f
         float* dst = (float*)_dst;
         __m128 d4 = _mm_set1_ps(delta);
 
+        if( checkHardwareSupport(CV_CPU_AVX2) )
+            i = SymmColumnSmallVec_32f_avx2(_src, _dst, ky, symmetrical, delta, width);
+
         if( symmetrical )
         {
             if( ky[0] == 2 && ky[1] == 1 )
@@ -2467,6 +2588,8 @@ template<class CastOp, class VecOp> struct ColumnFilter : public BaseColumnFilte
                    (kernel.rows == 1 || kernel.cols == 1));
     }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new ColumnFilter(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         const ST* ky = (const ST*)kernel.data;
@@ -2530,6 +2653,8 @@ template<class CastOp, class VecOp> struct SymmColumnFilter : public ColumnFilte
         CV_Assert( (symmetryType & (KERNEL_SYMMETRICAL | KERNEL_ASYMMETRICAL)) != 0 );
     }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new SymmColumnFilter(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         int ksize2 = this->ksize/2;
@@ -2636,6 +2761,8 @@ struct SymmColumnSmallFilter : public SymmColumnFilter<CastOp, VecOp>
         CV_Assert( this->ksize == 3 );
     }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new SymmColumnSmallFilter(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         int ksize2 = this->ksize/2;
@@ -3125,6 +3252,8 @@ template<typename ST, class CastOp, class VecOp> struct Filter2D : public BaseFi
         ptrs.resize( coords.size() );
     }
 
+    Ptr<BaseFilter> clone() const { return Ptr<BaseFilter>(new Filter2D(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width, int cn)
     {
         KT _delta = delta;
@@ -68,9 +68,237 @@ CvLinePolar;
 
 /*=====================================================================================*/
 
-#define hough_cmp_gt(l1,l2) (aux[l1] > aux[l2])
+namespace cv
+{
 
-static CV_IMPLEMENT_QSORT_EX( icvHoughSortDescent32s, int, hough_cmp_gt, const int* )
+struct HoughCmpGt
+{
+    HoughCmpGt( const int* _aux ) : aux(_aux) {}
+    bool operator()( int l1, int l2 ) const
+    {
+        return aux[l1] > aux[l2] || (aux[l1] == aux[l2] && l1 < l2);
+    }
+    const int* aux;
+};
+
+/*
+Orders the first min(K,total) elements of idx by descending aux value (ties by
+ascending index) without sorting the remaining ones.
+*/
+static void houghSortTopK( int* idx, int total, int K, const int* aux )
+{
+    K = std::min(K, total);
+    if( K <= 0 )
+        return;
+    if( K < total )
+        std::nth_element( idx, idx + K - 1, idx + total, HoughCmpGt(aux) );
+    std::sort( idx, idx + K, HoughCmpGt(aux) );
+}
+
+/*
+Votes the point (x, y) into every theta row of the accumulator; ofs[n] is the offset of
+the zero rho bin of the n-th row.
+*/
+static inline void houghVotePoint( int x, int y, const float* tabCos, const float* tabSin,
+                                   const int* ofs, int numangle, int* accum, bool useSIMD )
+{
+    int n = 0;
+
+#if CV_SSE2
+    if( useSIMD )
+    {
+        int CV_DECL_ALIGNED(16) idx[4];
+        __m128 fx = _mm_set1_ps((float)x), fy = _mm_set1_ps((float)y);
+
+        for( ; n <= numangle - 4; n += 4 )
+        {
+            __m128 r = _mm_add_ps( _mm_mul_ps(fx, _mm_loadu_ps(tabCos + n)),
+                                   _mm_mul_ps(fy, _mm_loadu_ps(tabSin + n)) );
+            _mm_store_si128( (__m128i*)idx, _mm_add_epi32( _mm_cvtps_epi32(r),
+                                   _mm_loadu_si128((const __m128i*)(ofs + n)) ) );
+            accum[idx[0]]++;
+            accum[idx[1]]++;
+            accum[idx[2]]++;
+            accum[idx[3]]++;
+        }
+    }
+#else
+    (void)useSIMD;
+#endif
+
+    for( ; n < numangle; n++ )
+        accum[cvRound( x * tabCos[n] + y * tabSin[n] ) + ofs[n]]++;
+}
+
+class HoughLinesAccumInvoker : public ParallelLoopBody
+{
+public:
+    HoughLinesAccumInvoker( const CvMat* _img, const float* _tabCos, const float* _tabSin,
+                            const int* _ofs, int _numangle, int** _accums, size_t _accumSize,
+                            int _nStripes )
+        : ParallelLoopBody(), img(_img), tabCos(_tabCos), tabSin(_tabSin), ofs(_ofs),
+          numangle(_numangle), accums(_accums), accumSize(_accumSize), nStripes(_nStripes)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int row0 = img->rows*range.start/nStripes, row1 = img->rows*range.end/nStripes;
+        int* accum = accums[range.start];
+        bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+
+        for( int k = range.start; k < range.end; k++ )
+            memset( accums[k], 0, accumSize*sizeof(accum[0]) );
+
+        for( int i = row0; i < row1; i++ )
+        {
+            const uchar* image = img->data.ptr + (size_t)img->step*i;
+            for( int j = 0; j < img->cols; j++ )
+                if( image[j] != 0 )
+                    houghVotePoint( j, i, tabCos, tabSin, ofs, numangle, accum, useSIMD );
+        }
+    }
+
+private:
+    const CvMat* img;
+    const float* tabCos;
+    const float* tabSin;
+    const int* ofs;
+    int numangle;
+    int** accums;
+    size_t accumSize;
+    int nStripes;
+};
+
+class HoughSDivAccumInvoker : public ParallelLoopBody
+{
+public:
+    HoughSDivAccumInvoker( const int* _x, const int* _y, int _count, float _rho, float _theta,
+                           int _rn, int _tn, uchar** _accums, int _nStripes )
+        : ParallelLoopBody(), x(_x), y(_y), count(_count), rho(_rho), theta(_theta),
+          rn(_rn), tn(_tn), accums(_accums), nStripes(_nStripes)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int start = count*range.start/nStripes, end = count*range.end/nStripes;
+        uchar* caccum = accums[range.start];
+        const float d2r = (float)(Pi / 180);
+        float irho = 1 / rho, itheta = 1 / theta;
+
+        for( int k = range.start; k < range.end; k++ )
+            if( k > 0 )
+                memset( accums[k], 0, (size_t)rn * tn );
+
+        for( int index = start; index < end; index++ )
+        {
+            int halftn, ti0, ti1, i;
+            float r, t, r0, rv;
+            float scale_factor;
+            int iprev = -1;
+            float phi, phi1;
+            float theta_it;     /* Value of theta for iterating */
+
+            float yc = (float) y[index] + 0.5f;
+            float xc = (float) x[index] + 0.5f;
+
+            /* Update the accumulator */
+            t = (float) fabs( cvFastArctan( yc, xc ) * d2r );
+            r = (float) sqrt( (double)xc * xc + (double)yc * yc );
+            r0 = r * irho;
+            ti0 = cvFloor( (t + Pi / 2) * itheta );
+
+            caccum[ti0]++;
+
+            theta_it = rho / r;
+            theta_it = theta_it < theta ? theta_it : theta;
+            scale_factor = theta_it * itheta;
+            halftn = cvFloor( Pi / theta_it );
+            for( ti1 = 1, phi = theta_it - halfPi, phi1 = (theta_it + t) * itheta;
+                 ti1 < halftn; ti1++, phi += theta_it, phi1 += scale_factor )
+            {
+                rv = r0 * _cos( phi );
+                i = cvFloor( rv ) * tn;
+                i += cvFloor( phi1 );
+                assert( i >= 0 );
+                assert( i < rn * tn );
+                caccum[i] = (uchar) (caccum[i] + ((i ^ iprev) != 0));
+                iprev = i;
+            }
+        }
+    }
+
+private:
+    const int* x;
+    const int* y;
+    int count;
+    float rho;
+    float theta;
+    int rn;
+    int tn;
+    uchar** accums;
+    int nStripes;
+};
+
+/*
+Adds up the per-stripe accumulators into the first one; the sum wraps around the same way
+for narrow accumulator types, so the result does not depend on the number of stripes.
+*/
+template<typename T> class HoughMergeInvoker : public ParallelLoopBody
+{
+public:
+    HoughMergeInvoker( T** _accums, int _count, size_t _rowSize )
+        : ParallelLoopBody(), accums(_accums), count(_count), rowSize(_rowSize)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        size_t start = range.start*rowSize, end = range.end*rowSize;
+        T* dst = accums[0];
+
+        for( int k = 1; k < count; k++ )
+        {
+            const T* src = accums[k];
+            if( !src )
+                continue;
+            for( size_t i = start; i < end; i++ )
+                dst[i] = (T)(dst[i] + src[i]);
+        }
+    }
+
+private:
+    T** accums;
+    int count;
+    size_t rowSize;
+};
+
+/*
+Splits `work` votes between per-stripe accumulators of `rows` x `rowSize` elements;
+the accumulator of the first stripe is `accum` itself.
+*/
+template<typename T> static int
+houghPrepareAccums( T* accum, int rows, size_t rowSize, double work,
+                    std::vector<T*>& accums, AutoBuffer<T>& extra )
+{
+    // every extra stripe costs a pass over its accumulator when merging
+    int nStripes = 1, nthreads = getNumThreads();
+    if( nthreads > 1 )
+        nStripes = std::max((int)std::min((double)nthreads, work/((double)rows*rowSize)), 1);
+
+    accums.assign(nStripes, (T*)0);
+    accums[0] = accum;
+    if( nStripes > 1 )
+    {
+        extra.allocate((nStripes - 1)*rows*rowSize);
+        for( int k = 1; k < nStripes; k++ )
+            accums[k] = (T*)extra + (k - 1)*rows*rowSize;
+    }
+    return nStripes;
+}
+
+}
 
 /*
 Here image is an input raster;
@@ -122,18 +350,35 @@ icvHoughLinesStandard( const CvMat* img, float rho, float theta,
         tabCos[n] = (float)(cos((double)ang) * irho);
     }
 
-    // stage 1. fill accumulator
-    for( i = 0; i < height; i++ )
-        for( j = 0; j < width; j++ )
-        {
-            if( image[i * step + j] != 0 )
-                for(int n = 0; n < numangle; n++ )
-                {
-                    int r = cvRound( j * tabCos[n] + i * tabSin[n] );
-                    r += (numrho - 1) / 2;
-                    accum[(n+1) * (numrho+2) + r+1]++;
-                }
-        }
+    cv::AutoBuffer<int> _ofs(numangle);
+    int* ofs = _ofs;
+    for(int n = 0; n < numangle; n++ )
+        ofs[n] = (n+1) * (numrho+2) + 1 + (numrho - 1) / 2;
+
+    // stage 1. fill accumulator; the stripes vote into their own accumulators
+    std::vector<int*> accums;
+    cv::AutoBuffer<int> _extra;
+    int nStripes = cv::houghPrepareAccums( accum, numangle+2, (size_t)(numrho+2),
+                                           (double)cvCountNonZero(img)*numangle, accums, _extra );
+
+    if( nStripes > 1 )
+    {
+        cv::parallel_for_( cv::Range(0, nStripes),
+            cv::HoughLinesAccumInvoker( img, tabCos, tabSin, ofs, numangle, &accums[0],
+                                        (size_t)(numangle+2) * (numrho+2), nStripes ) );
+        cv::parallel_for_( cv::Range(0, numangle+2),
+            cv::HoughMergeInvoker<int>( &accums[0], nStripes, (size_t)(numrho+2) ) );
+    }
+    else
+    {
+        bool useSIMD = cv::checkHardwareSupport(CV_CPU_SSE2);
+        for( i = 0; i < height; i++ )
+            for( j = 0; j < width; j++ )
+            {
+                if( image[i * step + j] != 0 )
+                    cv::houghVotePoint( j, i, tabCos, tabSin, ofs, numangle, accum, useSIMD );
+            }
+    }
 
     // stage 2. find local maximums
     for(int r = 0; r < numrho; r++ )
@@ -146,8 +391,8 @@ icvHoughLinesStandard( const CvMat* img, float rho, float theta,
                 sort_buf[total++] = base;
         }
 
-    // stage 3. sort the detected lines by accumulator value
-    icvHoughSortDescent32s( sort_buf, total, accum );
+    // stage 3. sort the best min(total,linesMax) detected lines by accumulator value
+    cv::houghSortTopK( sort_buf, total, linesMax, accum );
 
     // stage 4. store the first min(total,linesMax) lines to the output buffer
     linesMax = MIN(linesMax, total);
@@ -210,7 +455,6 @@ icvHoughLinesSDiv( const CvMat* img,
     int sfn = srn * stn;
     int fi;
     int count;
-    int cmax = 0;
 
     CVPOS pos;
     _index *pindex;
@@ -262,57 +506,28 @@ icvHoughLinesSDiv( const CvMat* img,
     x = &_x[0];
     y = &_y[0];
 
-    /* Full Hough Transform (it's accumulator update part) */
+    /* Remember the feature points */
     fi = 0;
     for( row = 0; row < h; row++ )
-    {
         for( col = 0; col < w; col++ )
-        {
             if( _POINT( row, col ))
             {
-                int halftn;
-                float r0;
-                float scale_factor;
-                int iprev = -1;
-                float phi, phi1;
-                float theta_it;     /* Value of theta for iterating */
-
-                /* Remember the feature point */
                 x[fi] = col;
                 y[fi] = row;
                 fi++;
+            }
 
-                yc = (float) row + 0.5f;
-                xc = (float) col + 0.5f;
-
-                /* Update the accumulator */
-                t = (float) fabs( cvFastArctan( yc, xc ) * d2r );
-                r = (float) sqrt( (double)xc * xc + (double)yc * yc );
-                r0 = r * irho;
-                ti0 = cvFloor( (t + Pi / 2) * itheta );
-
-                caccum[ti0]++;
+    /* Full Hough Transform (it's accumulator update part) */
+    std::vector<uchar*> caccums;
+    cv::AutoBuffer<uchar> _extra;
+    int nStripes = cv::houghPrepareAccums( caccum, rn, (size_t)tn, (double)fn*tn/2,
+                                           caccums, _extra );
 
-                theta_it = rho / r;
-                theta_it = theta_it < theta ? theta_it : theta;
-                scale_factor = theta_it * itheta;
-                halftn = cvFloor( Pi / theta_it );
-                for( ti1 = 1, phi = theta_it - halfPi, phi1 = (theta_it + t) * itheta;
-                     ti1 < halftn; ti1++, phi += theta_it, phi1 += scale_factor )
-                {
-                    rv = r0 * _cos( phi );
-                    i = cvFloor( rv ) * tn;
-                    i += cvFloor( phi1 );
-                    assert( i >= 0 );
-                    assert( i < rn * tn );
-                    caccum[i] = (uchar) (caccum[i] + ((i ^ iprev) != 0));
-                    iprev = i;
-                    if( cmax < caccum[i] )
-                        cmax = caccum[i];
-                }
-            }
-        }
-    }
+    cv::parallel_for_( cv::Range(0, nStripes),
+        cv::HoughSDivAccumInvoker( x, y, fn, rho, theta, rn, tn, &caccums[0], nStripes ) );
+    if( nStripes > 1 )
+        cv::parallel_for_( cv::Range(0, rn),
+            cv::HoughMergeInvoker<uchar>( &caccums[0], nStripes, (size_t)tn ) );
 
     /* Starting additional analysis */
     count = 0;
@@ -453,101 +668,120 @@ icvHoughLinesSDiv( const CvMat* img,
 *                              Probabilistic Hough Transform                             *
 \****************************************************************************************/
 
-static void
-icvHoughLinesProbabilistic( CvMat* image,
-                            float rho, float theta, int threshold,
-                            int lineLength, int lineGap,
-                            CvSeq *lines, int linesMax )
+namespace cv
 {
-    cv::Mat accum, mask;
-    cv::vector<float> trigtab;
-    cv::MemStorage storage(cvCreateMemStorage(0));
 
-    CvSeq* seq;
-    CvSeqWriter writer;
-    int width, height;
-    int numangle, numrho;
-    float ang;
-    int r, n, count;
-    CvPoint pt;
-    float irho = 1 / rho;
-    CvRNG rng = cvRNG(-1);
-    const float* ttab;
-    uchar* mdata0;
+/*
+Computes the accumulator offsets of the point (x, y) for every theta; ofs[n] is the
+offset of the zero rho bin of the n-th row.
+*/
+static inline void houghRhoIndices( int x, int y, const float* tabCos, const float* tabSin,
+                                    const int* ofs, int numangle, int* idx, bool useSIMD )
+{
+    int n = 0;
 
-    CV_Assert( CV_IS_MAT(image) && CV_MAT_TYPE(image->type) == CV_8UC1 );
+#if CV_SSE2
+    if( useSIMD )
+    {
+        __m128 fx = _mm_set1_ps((float)x), fy = _mm_set1_ps((float)y);
 
-    width = image->cols;
-    height = image->rows;
+        for( ; n <= numangle - 4; n += 4 )
+        {
+            __m128 r = _mm_add_ps( _mm_mul_ps(fx, _mm_loadu_ps(tabCos + n)),
+                                   _mm_mul_ps(fy, _mm_loadu_ps(tabSin + n)) );
+            _mm_storeu_si128( (__m128i*)(idx + n), _mm_add_epi32( _mm_cvtps_epi32(r),
+                                   _mm_loadu_si128((const __m128i*)(ofs + n)) ) );
+        }
+    }
+#else
+    (void)useSIMD;
+#endif
 
-    numangle = cvRound(CV_PI / theta);
-    numrho = cvRound(((width + height) * 2 + 1) / rho);
+    for( ; n < numangle; n++ )
+        idx[n] = cvRound( x * tabCos[n] + y * tabSin[n] ) + ofs[n];
+}
 
-    accum.create( numangle, numrho, CV_32SC1 );
-    mask.create( height, width, CV_8UC1 );
-    trigtab.resize(numangle*2);
-    accum = cv::Scalar(0);
+/*
+Progressive probabilistic Hough transform of one image (or tile). The feature points are
+kept in a compact array of T coordinates; at most linesMax segments are extracted.
+*/
+template<typename T> static void
+houghLinesProbabilistic( const Mat& image, float rho, float theta, int threshold,
+                         int lineLength, int lineGap, std::vector<Vec4i>& lines, int linesMax )
+{
+    int width = image.cols, height = image.rows;
+    int numangle = cvRound(CV_PI / theta);
+    int numrho = cvRound(((width + height) * 2 + 1) / rho);
+    float irho = 1 / rho;
+    float ang;
+    int n, count;
+    RNG rng((uint64)-1);
+    bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+
+    Mat accum = Mat::zeros( numangle, numrho, CV_32SC1 );
+    Mat mask( height, width, CV_8UC1 );
+    AutoBuffer<float> _tabCos(numangle), _tabSin(numangle);
+    AutoBuffer<int> _ofs(numangle), _ridx(numangle);
+    float *tabCos = _tabCos, *tabSin = _tabSin;
+    int *ofs = _ofs, *ridx = _ridx;
 
     for( ang = 0, n = 0; n < numangle; ang += theta, n++ )
     {
-        trigtab[n*2] = (float)(cos(ang) * irho);
-        trigtab[n*2+1] = (float)(sin(ang) * irho);
+        tabCos[n] = (float)(cos(ang) * irho);
+        tabSin[n] = (float)(sin(ang) * irho);
+        ofs[n] = n * numrho + (numrho - 1) / 2;
     }
-    ttab = &trigtab[0];
-    mdata0 = mask.data;
-
-    cvStartWriteSeq( CV_32SC2, sizeof(CvSeq), sizeof(CvPoint), storage, &writer );
+    uchar* mdata0 = mask.data;
+    std::vector<Point_<T> > points;
 
     // stage 1. collect non-zero image points
-    for( pt.y = 0, count = 0; pt.y < height; pt.y++ )
+    for( int y = 0; y < height; y++ )
     {
-        const uchar* data = image->data.ptr + pt.y*image->step;
-        uchar* mdata = mdata0 + pt.y*width;
-        for( pt.x = 0; pt.x < width; pt.x++ )
+        const uchar* data = image.ptr(y);
+        uchar* mdata = mdata0 + y*width;
+        for( int x = 0; x < width; x++ )
         {
-            if( data[pt.x] )
+            if( data[x] )
             {
-                mdata[pt.x] = (uchar)1;
-                CV_WRITE_SEQ_ELEM( pt, writer );
+                mdata[x] = (uchar)1;
+                points.push_back( Point_<T>((T)x, (T)y) );
             }
             else
-                mdata[pt.x] = 0;
+                mdata[x] = 0;
         }
     }
 
-    seq = cvEndWriteSeq( &writer );
-    count = seq->total;
+    count = (int)points.size();
 
     // stage 2. process all the points in random order
     for( ; count > 0; count-- )
     {
         // choose random point out of the remaining ones
-        int idx = cvRandInt(&rng) % count;
+        int idx = rng.next() % count;
         int max_val = threshold-1, max_n = 0;
-        CvPoint* point = (CvPoint*)cvGetSeqElem( seq, idx );
-        CvPoint line_end[2] = {{0,0}, {0,0}};
+        Point_<T>& point = points[idx];
+        Point line_end[2] = { Point(0,0), Point(0,0) };
         float a, b;
         int* adata = (int*)accum.data;
         int i, j, k, x0, y0, dx0, dy0, xflag;
         int good_line;
         const int shift = 16;
 
-        i = point->y;
-        j = point->x;
+        i = point.y;
+        j = point.x;
 
         // "remove" it by overriding it with the last element
-        *point = *(CvPoint*)cvGetSeqElem( seq, count-1 );
+        point = points[count-1];
 
         // check if it has been excluded already (i.e. belongs to some other line)
         if( !mdata0[i*width + j] )
             continue;
 
         // update accumulator, find the most probable line
-        for( n = 0; n < numangle; n++, adata += numrho )
+        houghRhoIndices( j, i, tabCos, tabSin, ofs, numangle, ridx, useSIMD );
+        for( n = 0; n < numangle; n++ )
         {
-            r = cvRound( j * ttab[n*2] + i * ttab[n*2+1] );
-            r += (numrho - 1) / 2;
-            int val = ++adata[r];
+            int val = ++adata[ridx[n]];
             if( max_val < val )
             {
                 max_val = val;
@@ -561,8 +795,8 @@ icvHoughLinesProbabilistic( CvMat* image,
 
         // from the current point walk in each direction
         // along the found line and extract the line segment
-        a = -ttab[max_n*2+1];
-        b = ttab[max_n*2];
+        a = -tabSin[max_n];
+        b = tabCos[max_n];
         x0 = j;
         y0 = i;
         if( fabs(a) > fabs(b) )
@@ -625,8 +859,8 @@ icvHoughLinesProbabilistic( CvMat* image,
             }
         }
 
-        good_line = abs(line_end[1].x - line_end[0].x) >= lineLength ||
-                    abs(line_end[1].y - line_end[0].y) >= lineLength;
+        good_line = std::abs(line_end[1].x - line_end[0].x) >= lineLength ||
+                    std::abs(line_end[1].y - line_end[0].y) >= lineLength;
 
         for( k = 0; k < 2; k++ )
         {
@@ -663,13 +897,9 @@ icvHoughLinesProbabilistic( CvMat* image,
                 {
                     if( good_line )
                     {
-                        adata = (int*)accum.data;
-                        for( n = 0; n < numangle; n++, adata += numrho )
-                        {
-                            r = cvRound( j1 * ttab[n*2] + i1 * ttab[n*2+1] );
-                            r += (numrho - 1) / 2;
-                            adata[r]--;
-                        }
+                        houghRhoIndices( j1, i1, tabCos, tabSin, ofs, numangle, ridx, useSIMD );
+                        for( n = 0; n < numangle; n++ )
+                            adata[ridx[n]]--;
                     }
                     *mdata = 0;
                 }
@@ -681,14 +911,90 @@ icvHoughLinesProbabilistic( CvMat* image,
 
         if( good_line )
         {
-            CvRect lr = { line_end[0].x, line_end[0].y, line_end[1].x, line_end[1].y };
-            cvSeqPush( lines, &lr );
-            if( lines->total >= linesMax )
+            lines.push_back( Vec4i(line_end[0].x, line_end[0].y, line_end[1].x, line_end[1].y) );
+            if( (int)lines.size() >= linesMax )
                 return;
         }
     }
 }
 
+static void
+houghLinesProbabilistic( const Mat& image, float rho, float theta, int threshold,
+                         int lineLength, int lineGap, std::vector<Vec4i>& lines, int linesMax )
+{
+    CV_Assert( image.type() == CV_8UC1 );
+
+    if( image.cols <= USHRT_MAX && image.rows <= USHRT_MAX )
+        houghLinesProbabilistic<ushort>( image, rho, theta, threshold, lineLength, lineGap,
+                                         lines, linesMax );
+    else
+        houghLinesProbabilistic<int>( image, rho, theta, threshold, lineLength, lineGap,
+                                      lines, linesMax );
+}
+
+class HoughLinesPTileInvoker : public ParallelLoopBody
+{
+public:
+    HoughLinesPTileInvoker( const Mat& _image, Size _tileSize, float _rho, float _theta,
+                            int _threshold, int _lineLength, int _lineGap, int _linesMax,
+                            std::vector<Vec4i>* _tileLines )
+        : ParallelLoopBody(), image(&_image), tileSize(_tileSize), rho(_rho), theta(_theta),
+          threshold(_threshold), lineLength(_lineLength), lineGap(_lineGap), linesMax(_linesMax),
+          tileLines(_tileLines)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int tilesX = (image->cols + tileSize.width - 1)/tileSize.width;
+
+        for( int t = range.start; t < range.end; t++ )
+        {
+            Rect roi( (t % tilesX)*tileSize.width, (t / tilesX)*tileSize.height,
+                      tileSize.width, tileSize.height );
+            roi &= Rect(0, 0, image->cols, image->rows);
+
+            std::vector<Vec4i>& lines = tileLines[t];
+            houghLinesProbabilistic( (*image)(roi), rho, theta, threshold, lineLength, lineGap,
+                                     lines, linesMax );
+            for( size_t k = 0; k < lines.size(); k++ )
+                lines[k] += Vec4i(roi.x, roi.y, roi.x, roi.y);
+        }
+    }
+
+private:
+    const Mat* image;
+    Size tileSize;
+    float rho;
+    float theta;
+    int threshold;
+    int lineLength;
+    int lineGap;
+    int linesMax;
+    std::vector<Vec4i>* tileLines;
+};
+
+}
+
+static void
+icvHoughLinesProbabilistic( CvMat* image,
+                            float rho, float theta, int threshold,
+                            int lineLength, int lineGap,
+                            CvSeq *lines, int linesMax )
+{
+    CV_Assert( CV_IS_MAT(image) && CV_MAT_TYPE(image->type) == CV_8UC1 );
+
+    std::vector<cv::Vec4i> segments;
+    cv::houghLinesProbabilistic( cv::cvarrToMat(image), rho, theta, threshold,
+                                 lineLength, lineGap, segments, linesMax );
+
+    for( size_t i = 0; i < segments.size(); i++ )
+    {
+        CvRect lr = { segments[i][0], segments[i][1], segments[i][2], segments[i][3] };
+        cvSeqPush( lines, &lr );
+    }
+}
+
 /* Wrapper function for standard hough transform */
 CV_IMPL CvSeq*
 cvHoughLines2( CvArr* src_image, void* lineStorage, int method,
@@ -791,144 +1097,289 @@ cvHoughLines2( CvArr* src_image, void* lineStorage, int method,
 *                                     Circle Detection                                   *
 \****************************************************************************************/
 
-static void
-icvHoughCirclesGradient( CvMat* img, float dp, float min_dist,
-                         int min_radius, int max_radius,
-                         int canny_threshold, int acc_threshold,
-                         CvSeq* circles, int circles_max )
+namespace cv
 {
-    const int SHIFT = 10, ONE = 1 << SHIFT;
-    cv::Ptr<CvMat> dx, dy;
-    cv::Ptr<CvMat> edges, accum, dist_buf;
-    std::vector<int> sort_buf;
-    cv::Ptr<CvMemStorage> storage;
 
-    int x, y, i, j, k, center_count, nz_count;
-    float min_radius2 = (float)min_radius*min_radius;
-    float max_radius2 = (float)max_radius*max_radius;
-    int rows, cols, arows, acols;
-    int astep, *adata;
-    float* ddata;
-    CvSeq *nz, *centers;
-    float idp, dr;
-    CvSeqReader reader;
+struct HoughCircleEdge
+{
+    int x, y;       // edge pixel
+    int sx, sy;     // gradient direction in the fixed-point accumulator units
+};
 
-    edges = cvCreateMat( img->rows, img->cols, CV_8UC1 );
-    cvCanny( img, edges, MAX(canny_threshold/2,1), canny_threshold, 3 );
+struct HoughCircleCenter
+{
+    int value;      // accumulator value
+    int ofs;        // y*(acols+2) + x
+};
 
-    dx = cvCreateMat( img->rows, img->cols, CV_16SC1 );
-    dy = cvCreateMat( img->rows, img->cols, CV_16SC1 );
-    cvSobel( img, dx, 1, 0, 3 );
-    cvSobel( img, dy, 0, 1, 3 );
+static inline int64 houghFloorDiv( int64 a, int64 b )
+{
+    return a >= 0 ? a/b : -((-a + b - 1)/b);
+}
 
-    if( dp < 1.f )
-        dp = 1.f;
-    idp = 1.f/dp;
-    accum = cvCreateMat( cvCeil(img->rows*idp)+2, cvCeil(img->cols*idp)+2, CV_32SC1 );
-    cvZero(accum);
+/*
+Narrows [r0, r1] to the integer r for which lo <= c + r*s < hi;
+returns false if the range becomes empty.
+*/
+static inline bool houghClipRay( int64 c, int64 s, int64 lo, int64 hi, int64& r0, int64& r1 )
+{
+    if( s > 0 )
+    {
+        r0 = std::max(r0, -houghFloorDiv(c - lo, s));
+        r1 = std::min(r1, houghFloorDiv(hi - 1 - c, s));
+    }
+    else if( s < 0 )
+    {
+        r0 = std::max(r0, -houghFloorDiv(hi - 1 - c, -s));
+        r1 = std::min(r1, houghFloorDiv(c - lo, -s));
+    }
+    else if( c < lo || c >= hi )
+        return false;
+    return r0 <= r1;
+}
 
-    storage = cvCreateMemStorage();
-    nz = cvCreateSeq( CV_32SC2, sizeof(CvSeq), sizeof(CvPoint), storage );
-    centers = cvCreateSeq( CV_32SC1, sizeof(CvSeq), sizeof(int), storage );
+/*
+Collects the edge pixels with a non-zero gradient. The 3x3 Sobel derivatives (with
+replicated border) are only evaluated at the edge pixels.
+*/
+static void houghCircleEdges( const Mat& img, const Mat& edges, float idp, int ONE,
+                              std::vector<HoughCircleEdge>& pts )
+{
+    int rows = img.rows, cols = img.cols;
 
-    rows = img->rows;
-    cols = img->cols;
-    arows = accum->rows - 2;
-    acols = accum->cols - 2;
-    adata = accum->data.i;
-    astep = accum->step/sizeof(adata[0]);
-    // Accumulate circle evidence for each edge pixel
-    for( y = 0; y < rows; y++ )
+    for( int y = 0; y < rows; y++ )
     {
-        const uchar* edges_row = edges->data.ptr + y*edges->step;
-        const short* dx_row = (const short*)(dx->data.ptr + y*dx->step);
-        const short* dy_row = (const short*)(dy->data.ptr + y*dy->step);
+        const uchar* edges_row = edges.ptr(y);
+        const uchar* r0 = img.ptr(std::max(y - 1, 0));
+        const uchar* r1 = img.ptr(y);
+        const uchar* r2 = img.ptr(std::min(y + 1, rows - 1));
 
-        for( x = 0; x < cols; x++ )
+        for( int x = 0; x < cols; x++ )
         {
-            float vx, vy;
-            int sx, sy, x0, y0, x1, y1, r;
-            CvPoint pt;
+            if( !edges_row[x] )
+                continue;
 
-            vx = dx_row[x];
-            vy = dy_row[x];
+            int xl = std::max(x - 1, 0), xr = std::min(x + 1, cols - 1);
+            float vx = (float)((r0[xr] - r0[xl]) + 2*(r1[xr] - r1[xl]) + (r2[xr] - r2[xl]));
+            float vy = (float)((r2[xl] + 2*r2[x] + r2[xr]) - (r0[xl] + 2*r0[x] + r0[xr]));
 
-            if( !edges_row[x] || (vx == 0 && vy == 0) )
+            if( vx == 0 && vy == 0 )
                 continue;
 
-            float mag = sqrt(vx*vx+vy*vy);
+            float mag = std::sqrt(vx*vx+vy*vy);
             assert( mag >= 1 );
-            sx = cvRound((vx*idp)*ONE/mag);
-            sy = cvRound((vy*idp)*ONE/mag);
+            HoughCircleEdge pt;
+            pt.x = x;
+            pt.y = y;
+            pt.sx = cvRound((vx*idp)*ONE/mag);
+            pt.sy = cvRound((vy*idp)*ONE/mag);
+            pts.push_back(pt);
+        }
+    }
+}
+
+/*
+Accumulates the circle evidence band by band: every band of accumulator rows gets its own
+small buffer, the rays of the edge points are clipped to the band analytically, and the
+local maxima of the band are reported as candidate centers. The full accumulator is never
+allocated.
+*/
+class HoughCirclesAccumInvoker : public ParallelLoopBody
+{
+public:
+    enum { SHIFT = 10 };
+
+    HoughCirclesAccumInvoker( const std::vector<HoughCircleEdge>& _pts, float _idp,
+                              int _min_radius, int _max_radius, int _acc_threshold,
+                              int _arows, int _acols, int _bandRows,
+                              std::vector<HoughCircleCenter>* _centers )
+        : ParallelLoopBody(), pts(&_pts), idp(_idp), min_radius(_min_radius),
+          max_radius(_max_radius), acc_threshold(_acc_threshold), arows(_arows), acols(_acols),
+          bandRows(_bandRows), centers(_centers)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        const int ONE = 1 << SHIFT;
+        const HoughCircleEdge* edge = pts->empty() ? 0 : &(*pts)[0];
+        int npts = (int)pts->size();
+
+        // the vote of a point moves at most max_radius*(idp + 1/ONE) accumulator rows away
+        float reach = (max_radius*(idp + 1.f/ONE) + 2)/idp + 1;
+
+        for( int b = range.start; b < range.end; b++ )
+        {
+            // candidate center rows [c0, c1) need the votes of rows [c0-1, c1+1)
+            int c0 = 1 + b*bandRows, c1 = std::min(c0 + bandRows, arows - 1);
+            int ar0 = c0 - 1, ar1 = c1 + 1;
+            AutoBuffer<int> _buf((ar1 - ar0)*acols);
+            int* buf = _buf;
+            memset( buf, 0, (ar1 - ar0)*acols*sizeof(buf[0]) );
+
+            float ylo = ar0/idp - reach, yhi = ar1/idp + reach;
+            int lo = 0, hi = npts;
+            while( lo < hi )
+            {
+                int mid = (lo + hi)/2;
+                if( edge[mid].y < ylo ) lo = mid + 1; else hi = mid;
+            }
 
-            x0 = cvRound((x*idp)*ONE);
-            y0 = cvRound((y*idp)*ONE);
-            // Step from min_radius to max_radius in both directions of the gradient
-            for(int k1 = 0; k1 < 2; k1++ )
+            for( int i = lo; i < npts && edge[i].y <= yhi; i++ )
             {
-                x1 = x0 + min_radius * sx;
-                y1 = y0 + min_radius * sy;
+                int x0 = cvRound((edge[i].x*idp)*ONE);
+                int y0 = cvRound((edge[i].y*idp)*ONE);
+                int sx = edge[i].sx, sy = edge[i].sy;
 
-                for( r = min_radius; r <= max_radius; x1 += sx, y1 += sy, r++ )
+                // Step from min_radius to max_radius in both directions of the gradient;
+                // a ray stops once it leaves the accumulator
+                for( int k1 = 0; k1 < 2; k1++, sx = -sx, sy = -sy )
                 {
-                    int x2 = x1 >> SHIFT, y2 = y1 >> SHIFT;
-                    if( (unsigned)x2 >= (unsigned)acols ||
-                        (unsigned)y2 >= (unsigned)arows )
-                        break;
-                    adata[y2*astep + x2]++;
+                    int64 r0 = INT_MIN, r1 = INT_MAX;
+                    if( !houghClipRay(x0, sx, 0, (int64)acols << SHIFT, r0, r1) ||
+                        !houghClipRay(y0, sy, 0, (int64)arows << SHIFT, r0, r1) ||
+                        r0 > min_radius || r1 < min_radius )
+                        continue;
+
+                    r0 = min_radius;
+                    r1 = std::min(r1, (int64)max_radius);
+                    if( !houghClipRay(y0, sy, (int64)ar0 << SHIFT, (int64)ar1 << SHIFT, r0, r1) )
+                        continue;
+
+                    int x1 = x0 + (int)r0*sx, y1 = y0 + (int)r0*sy;
+                    for( int64 r = r0; r <= r1; r++, x1 += sx, y1 += sy )
+                        buf[((y1 >> SHIFT) - ar0)*acols + (x1 >> SHIFT)]++;
                 }
-
-                sx = -sx; sy = -sy;
             }
 
-            pt.x = x; pt.y = y;
-            cvSeqPush( nz, &pt );
+            //Find possible circle centers
+            std::vector<HoughCircleCenter>& bandCenters = centers[b];
+            for( int y = c0; y < c1; y++ )
+            {
+                const int* arow = buf + (y - ar0)*acols;
+                for( int x = 1; x < acols - 1; x++ )
+                {
+                    int v = arow[x];
+                    if( v > acc_threshold &&
+                        v > arow[x-1] && v > arow[x+1] &&
+                        v > arow[x-acols] && v > arow[x+acols] )
+                    {
+                        HoughCircleCenter c;
+                        c.value = v;
+                        c.ofs = y*(acols+2) + x;
+                        bandCenters.push_back(c);
+                    }
+                }
+            }
         }
     }
 
-    nz_count = nz->total;
-    if( !nz_count )
+private:
+    const std::vector<HoughCircleEdge>* pts;
+    float idp;
+    int min_radius;
+    int max_radius;
+    int acc_threshold;
+    int arows;
+    int acols;
+    int bandRows;
+    std::vector<HoughCircleCenter>* centers;
+};
+
+}
+
+#define hough_center_gt(c1,c2) ((c1).value > (c2).value)
+
+static CV_IMPLEMENT_QSORT_EX( icvHoughSortCenters, cv::HoughCircleCenter, hough_center_gt, int )
+
+static void
+icvHoughCirclesGradient( CvMat* img, float dp, float min_dist,
+                         int min_radius, int max_radius,
+                         int canny_threshold, int acc_threshold,
+                         CvSeq* circles, int circles_max )
+{
+    const int SHIFT = cv::HoughCirclesAccumInvoker::SHIFT, ONE = 1 << SHIFT;
+    const int CELL = 32;
+
+    int x, y, i, j, nz_count;
+    float min_radius2 = (float)min_radius*min_radius;
+    float max_radius2 = (float)max_radius*max_radius;
+    int rows, cols, arows, acols;
+    float idp, dr;
+
+    cv::Mat src = cv::cvarrToMat(img), edges;
+    cv::Canny( src, edges, MAX(canny_threshold/2,1), canny_threshold, 3 );
+
+    if( dp < 1.f )
+        dp = 1.f;
+    idp = 1.f/dp;
+
+    rows = img->rows;
+    cols = img->cols;
+    arows = cvCeil(rows*idp);
+    acols = cvCeil(cols*idp);
+
+    // Accumulate circle evidence for each edge pixel
+    std::vector<cv::HoughCircleEdge> pts;
+    cv::houghCircleEdges( src, edges, idp, ONE, pts );
+    edges.release();
+
+    nz_count = (int)pts.size();
+    if( !nz_count || arows < 3 || acols < 3 )
         return;
-    //Find possible circle centers
-    for( y = 1; y < arows - 1; y++ )
-    {
-        for( x = 1; x < acols - 1; x++ )
-        {
-            int base = y*(acols+2) + x;
-            if( adata[base] > acc_threshold &&
-                adata[base] > adata[base-1] && adata[base] > adata[base+1] &&
-                adata[base] > adata[base-acols-2] && adata[base] > adata[base+acols+2] )
-                cvSeqPush(centers, &base);
-        }
-    }
 
-    center_count = centers->total;
-    if( !center_count )
+    // bands of at most ~1M accumulator cells, enough of them to keep the threads busy
+    int nthreads = cv::getNumThreads();
+    int bandRows = std::max(std::min((1 << 20)/acols, (arows - 2 + nthreads*2 - 1)/(nthreads*2)), 1);
+    int nbands = (arows - 2 + bandRows - 1)/bandRows;
+    std::vector<std::vector<cv::HoughCircleCenter> > bandCenters(nbands);
+
+    cv::parallel_for_( cv::Range(0, nbands),
+        cv::HoughCirclesAccumInvoker( pts, idp, min_radius, max_radius, acc_threshold,
+                                      arows, acols, bandRows, &bandCenters[0] ) );
+
+    std::vector<cv::HoughCircleCenter> centers;
+    for( i = 0; i < nbands; i++ )
+        centers.insert( centers.end(), bandCenters[i].begin(), bandCenters[i].end() );
+
+    if( centers.empty() )
         return;
 
-    sort_buf.resize( MAX(center_count,nz_count) );
-    cvCvtSeqToArray( centers, &sort_buf[0] );
+    icvHoughSortCenters( &centers[0], (int)centers.size(), 0 );
+
+    // bucket the edge points into CELLxCELL cells, so that the radius estimation
+    // only visits the cells that intersect the annulus around a center
+    int gcols = (cols + CELL - 1)/CELL, grows = (rows + CELL - 1)/CELL;
+    std::vector<int> cellStart(gcols*grows + 1, 0);
+    std::vector<cv::Point> cellPts(nz_count);
 
-    icvHoughSortDescent32s( &sort_buf[0], center_count, adata );
-    cvClearSeq( centers );
-    cvSeqPushMulti( centers, &sort_buf[0], center_count );
+    for( j = 0; j < nz_count; j++ )
+        cellStart[(pts[j].y/CELL)*gcols + pts[j].x/CELL + 1]++;
+    for( j = 0; j < gcols*grows; j++ )
+        cellStart[j+1] += cellStart[j];
+    {
+        std::vector<int> cellPos(cellStart.begin(), cellStart.end() - 1);
+        for( j = 0; j < nz_count; j++ )
+            cellPts[cellPos[(pts[j].y/CELL)*gcols + pts[j].x/CELL]++] = cv::Point(pts[j].x, pts[j].y);
+    }
+    pts.clear();
 
-    dist_buf = cvCreateMat( 1, nz_count, CV_32FC1 );
-    ddata = dist_buf->data.fl;
+    std::vector<float> dist_buf(nz_count);
+    float* ddata = &dist_buf[0];
 
     dr = dp;
     min_dist = MAX( min_dist, dp );
     min_dist *= min_dist;
     // For each found possible center
     // Estimate radius and check support
-    for( i = 0; i < centers->total; i++ )
+    for( i = 0; i < (int)centers.size(); i++ )
     {
-        int ofs = *(int*)cvGetSeqElem( centers, i );
+        int ofs = centers[i].ofs;
         y = ofs/(acols+2);
         x = ofs - (y)*(acols+2);
         //Calculate circle's center in pixels
         float cx = (float)((x + 0.5f)*dp), cy = (float)(( y + 0.5f )*dp);
-        float start_dist, dist_sum;
+        float start_dist;
         float r_best = 0;
         int max_count = 0;
         // Check distance with previously detected circles
@@ -941,41 +1392,60 @@ icvHoughCirclesGradient( CvMat* img, float dp, float min_dist,
 
         if( j < circles->total )
             continue;
-        // Estimate best radius
-        cvStartReadSeq( nz, &reader );
-        for( j = k = 0; j < nz_count; j++ )
+        // Estimate best radius from the points of the cells that may intersect the annulus;
+        // the bounds are widened a bit to stay on the safe side of the float rounding
+        double rmax2 = max_radius2*(1 + 1e-5) + 1, rmin2 = min_radius2*(1 - 1e-5) - 1;
+        int gx0 = std::max(cvFloor((cx - max_radius)/CELL) - 1, 0);
+        int gx1 = std::min(cvFloor((cx + max_radius)/CELL) + 1, gcols - 1);
+        int gy0 = std::max(cvFloor((cy - max_radius)/CELL) - 1, 0);
+        int gy1 = std::min(cvFloor((cy + max_radius)/CELL) + 1, grows - 1);
+        int k = 0;
+
+        for( int gy = gy0; gy <= gy1; gy++ )
         {
-            CvPoint pt;
-            float _dx, _dy, _r2;
-            CV_READ_SEQ_ELEM( pt, reader );
-            _dx = cx - pt.x; _dy = cy - pt.y;
-            _r2 = _dx*_dx + _dy*_dy;
-            if(min_radius2 <= _r2 && _r2 <= max_radius2 )
+            double py0 = gy*CELL - cy, py1 = std::min(gy*CELL + CELL, rows) - 1 - cy;
+            double dymin = py0 > 0 ? py0 : py1 < 0 ? -py1 : 0;
+            double dymax = std::max(std::abs(py0), std::abs(py1));
+
+            for( int gx = gx0; gx <= gx1; gx++ )
             {
-                ddata[k] = _r2;
-                sort_buf[k] = k;
-                k++;
+                double px0 = gx*CELL - cx, px1 = std::min(gx*CELL + CELL, cols) - 1 - cx;
+                double dxmin = px0 > 0 ? px0 : px1 < 0 ? -px1 : 0;
+                double dxmax = std::max(std::abs(px0), std::abs(px1));
+
+                if( dxmin*dxmin + dymin*dymin > rmax2 || dxmax*dxmax + dymax*dymax < rmin2 )
+                    continue;
+
+                int cell = gy*gcols + gx;
+                for( int p = cellStart[cell]; p < cellStart[cell+1]; p++ )
+                {
+                    float _dx, _dy, _r2;
+                    _dx = cx - cellPts[p].x; _dy = cy - cellPts[p].y;
+                    _r2 = _dx*_dx + _dy*_dy;
+                    if(min_radius2 <= _r2 && _r2 <= max_radius2 )
+                        ddata[k++] = _r2;
+                }
             }
         }
 
         int nz_count1 = k, start_idx = nz_count1 - 1;
         if( nz_count1 == 0 )
             continue;
-        dist_buf->cols = nz_count1;
-        cvPow( dist_buf, dist_buf, 0.5 );
-        icvHoughSortDescent32s( &sort_buf[0], nz_count1, (int*)ddata );
+        for( j = 0; j < nz_count1; j++ )
+            ddata[j] = std::sqrt(ddata[j]);
+        std::sort( ddata, ddata + nz_count1, std::greater<float>() );
 
-        dist_sum = start_dist = ddata[sort_buf[nz_count1-1]];
+        start_dist = ddata[nz_count1-1];
         for( j = nz_count1 - 2; j >= 0; j-- )
         {
-            float d = ddata[sort_buf[j]];
+            float d = ddata[j];
 
             if( d > max_radius )
                 break;
 
             if( d - start_dist > dr )
             {
-                float r_cur = ddata[sort_buf[(j + start_idx)/2]];
+                float r_cur = ddata[(j + start_idx)/2];
                 if( (start_idx - j)*r_best >= max_count*r_cur ||
                     (r_best < FLT_EPSILON && start_idx - j >= max_count) )
                 {
@@ -984,9 +1454,7 @@ icvHoughCirclesGradient( CvMat* img, float dp, float min_dist,
                 }
                 start_dist = d;
                 start_idx = j;
-                dist_sum = 0;
             }
-            dist_sum += d;
         }
         // Check if the circle has enough support
         if( max_count > acc_threshold )
@@ -1086,8 +1554,6 @@ cvHoughCircles( CvArr* src_image, void* circle_storage,
 namespace cv
 {
 
-const int STORAGE_SIZE = 1 << 12;
-
 static void seqToMat(const CvSeq* seq, OutputArray _arr)
 {
     if( seq && seq->total > 0 )
@@ -1106,7 +1572,7 @@ void cv::HoughLines( InputArray _image, OutputArray _lines,
                      double rho, double theta, int threshold,
                      double srn, double stn )
 {
-    Ptr<CvMemStorage> storage = cvCreateMemStorage(STORAGE_SIZE);
+    ThreadMemStorage storage;
     Mat image = _image.getMat();
     CvMat c_image = image;
     CvSeq* seq = cvHoughLines2( &c_image, storage, srn == 0 && stn == 0 ?
@@ -1117,14 +1583,57 @@ void cv::HoughLines( InputArray _image, OutputArray _lines,
 
 void cv::HoughLinesP( InputArray _image, OutputArray _lines,
                       double rho, double theta, int threshold,
-                      double minLineLength, double maxGap )
+                      double minLineLength, double maxGap,
+                      int maxLines, Size tileSize )
 {
-    Ptr<CvMemStorage> storage = cvCreateMemStorage(STORAGE_SIZE);
     Mat image = _image.getMat();
-    CvMat c_image = image;
-    CvSeq* seq = cvHoughLines2( &c_image, storage, CV_HOUGH_PROBABILISTIC,
-                    rho, theta, threshold, minLineLength, maxGap );
-    seqToMat(seq, _lines);
+
+    if( image.type() != CV_8UC1 )
+        CV_Error( CV_StsBadArg, "The source image must be 8-bit, single-channel" );
+
+    if( rho <= 0 || theta <= 0 || threshold <= 0 )
+        CV_Error( CV_StsOutOfRange, "rho, theta and threshold must be positive" );
+
+    if( maxLines <= 0 )
+        maxLines = INT_MAX;
+
+    std::vector<Vec4i> lines;
+    int lineLength = cvRound(minLineLength), lineGap = cvRound(maxGap);
+
+    if( tileSize.width <= 0 || tileSize.height <= 0 ||
+        (tileSize.width >= image.cols && tileSize.height >= image.rows) )
+    {
+        houghLinesProbabilistic( image, (float)rho, (float)theta, threshold,
+                                 lineLength, lineGap, lines, maxLines );
+    }
+    else
+    {
+        int ntiles = ((image.cols + tileSize.width - 1)/tileSize.width)*
+                     ((image.rows + tileSize.height - 1)/tileSize.height);
+        std::vector<std::vector<Vec4i> > tileLines(ntiles);
+
+        parallel_for_( Range(0, ntiles),
+                       HoughLinesPTileInvoker( image, tileSize, (float)rho, (float)theta, threshold,
+                                               lineLength, lineGap, maxLines, &tileLines[0] ) );
+
+        for( int t = 0; t < ntiles && (int)lines.size() < maxLines; t++ )
+        {
+            size_t n = std::min(tileLines[t].size(), (size_t)(maxLines - lines.size()));
+            lines.insert( lines.end(), tileLines[t].begin(), tileLines[t].begin() + n );
+        }
+    }
+
+    if( !lines.empty() )
+        Mat(1, (int)lines.size(), CV_32SC4, &lines[0]).copyTo(_lines);
+    else
+        _lines.release();
+}
+
+void cv::HoughLinesP( InputArray _image, OutputArray _lines,
+                      double rho, double theta, int threshold,
+                      double minLineLength, double maxGap )
+{
+    HoughLinesP( _image, _lines, rho, theta, threshold, minLineLength, maxGap, 0, Size() );
 }
 
 void cv::HoughCircles( InputArray _image, OutputArray _circles,
@@ -1132,7 +1641,7 @@ void cv::HoughCircles( InputArray _image, OutputArray _circles,
                        double param1, double param2,
                        int minRadius, int maxRadius )
 {
-    Ptr<CvMemStorage> storage = cvCreateMemStorage(STORAGE_SIZE);
+    ThreadMemStorage storage;
     Mat image = _image.getMat();
     CvMat c_image = image;
     CvSeq* seq = cvHoughCircles( &c_image, storage, method,
@@ -127,6 +127,8 @@ public:
                             int dstcount, int width) = 0;
     //! resets the internal buffers, if any
     virtual void reset();
+    //! returns an independent copy of the filter for another thread; empty if the filter can not be copied
+    virtual Ptr<BaseColumnFilter> clone() const;
     int ksize, anchor;
 };
 
@@ -153,6 +155,8 @@ public:
                             int dstcount, int width, int cn) = 0;
     //! resets the internal buffers, if any
     virtual void reset();
+    //! returns an independent copy of the filter for another thread; empty if the filter can not be copied
+    virtual Ptr<BaseFilter> clone() const;
     Size ksize;
     Point anchor;
 };
@@ -261,6 +265,7 @@ public:
     virtual int proceed(const uchar* src, int srcStep, int srcCount,
                         uchar* dst, int dstStep);
     //! applies filter to the specified ROI of the image. if srcRoi=(0,0,-1,-1), the whole image is filtered.
+    //! Large non-overlapping images are split into horizontal stripes processed in parallel.
     virtual void apply( const Mat& src, Mat& dst,
                         const Rect& srcRoi=Rect(0,0,-1,-1),
                         Point dstOfs=Point(0,0),
@@ -367,7 +372,7 @@ CV_EXPORTS_W Mat getGaborKernel( Size ksize, double sigma, double theta, double
 enum { MORPH_ERODE=CV_MOP_ERODE, MORPH_DILATE=CV_MOP_DILATE,
        MORPH_OPEN=CV_MOP_OPEN, MORPH_CLOSE=CV_MOP_CLOSE,
        MORPH_GRADIENT=CV_MOP_GRADIENT, MORPH_TOPHAT=CV_MOP_TOPHAT,
-       MORPH_BLACKHAT=CV_MOP_BLACKHAT };
+       MORPH_BLACKHAT=CV_MOP_BLACKHAT, MORPH_HITMISS=CV_MOP_HITMISS };
 
 //! returns horizontal 1D morphological filter
 CV_EXPORTS Ptr<BaseRowFilter> getMorphologyRowFilter(int op, int type, int ksize, int anchor=-1);
@@ -405,10 +410,20 @@ CV_EXPORTS_W void GaussianBlur( InputArray src,
                                                OutputArray dst, Size ksize,
                                                double sigmaX, double sigmaY=0,
                                                int borderType=BORDER_DEFAULT );
+//! smooths the image using the recursive (IIR) Gaussian; the cost per pixel does not depend on sigma
+CV_EXPORTS_W void recursiveGaussianBlur( InputArray src, OutputArray dst,
+                                         double sigmaX, double sigmaY=0,
+                                         int borderType=BORDER_DEFAULT );
 //! smooths the image using bilateral filter
 CV_EXPORTS_W void bilateralFilter( InputArray src, OutputArray dst, int d,
                                    double sigmaColor, double sigmaSpace,
                                    int borderType=BORDER_DEFAULT );
+//! approximates bilateralFilter on single-channel images with a bilateral grid sampled at spaceSampling*sigmaSpace
+//! pixels and colorSampling*sigmaColor intensity levels; color images and grids larger than the image use bilateralFilter
+CV_EXPORTS_W void bilateralGridFilter( InputArray src, OutputArray dst, int d,
+                                       double sigmaColor, double sigmaSpace,
+                                       int borderType=BORDER_DEFAULT,
+                                       double spaceSampling=1, double colorSampling=1 );
 //! smooths the image using adaptive bilateral filter
 CV_EXPORTS_W void adaptiveBilateralFilter( InputArray src, OutputArray dst, Size ksize,
                                            double sigmaSpace, double maxSigmaColor = 20.0, Point anchor=Point(-1, -1),
@@ -498,6 +513,12 @@ CV_EXPORTS_W void HoughLinesP( InputArray image, OutputArray lines,
                                double rho, double theta, int threshold,
                                double minLineLength=0, double maxLineGap=0 );
 
+//! the same, but returns at most maxLines segments if it is positive; non-empty tileSize processes independent tiles in parallel
+CV_EXPORTS void HoughLinesP( InputArray image, OutputArray lines,
+                             double rho, double theta, int threshold,
+                             double minLineLength, double maxLineGap,
+                             int maxLines, Size tileSize=Size() );
+
 //! finds circles in the grayscale image using 2+1 gradient Hough transform
 CV_EXPORTS_W void HoughCircles( InputArray image, OutputArray circles,
                                int method, double dp, double minDist,
@@ -559,6 +580,14 @@ CV_EXPORTS_W void morphologyEx( InputArray src, OutputArray dst,
                                 int borderType=BORDER_CONSTANT,
                                 const Scalar& borderValue=morphologyDefaultBorderValue() );
 
+//! applies a morphological operation to a binary mask (zero/non-zero, 8UC1), packed to 1 bit per pixel.
+//! The result is 0/255. For MORPH_HITMISS the kernel holds 1 (foreground), -1 (background) and 0 (ignored).
+CV_EXPORTS_W void binaryMorphologyEx( InputArray src, OutputArray dst,
+                                      int op, InputArray kernel,
+                                      Point anchor=Point(-1,-1), int iterations=1,
+                                      int borderType=BORDER_CONSTANT,
+                                      const Scalar& borderValue=morphologyDefaultBorderValue() );
+
 //! interpolation algorithm
 enum
 {
@@ -839,6 +868,10 @@ CV_EXPORTS_AS(distanceTransformWithLabels) void distanceTransform( InputArray sr
 CV_EXPORTS_W void distanceTransform( InputArray src, OutputArray dst,
                                      int distanceType, int maskSize );
 
+//! the same, but dstType is CV_32F, CV_16U (rounded) or CV_8U (CV_DIST_L1 only, saturated at 255)
+CV_EXPORTS void distanceTransform( InputArray src, OutputArray dst,
+                                   int distanceType, int maskSize, int dstType );
+
 enum { FLOODFILL_FIXED_RANGE = 1 << 16, FLOODFILL_MASK_ONLY = 1 << 17 };
 
 //! fills the semi-uniform image region starting from the specified seed point
@@ -853,6 +886,26 @@ CV_EXPORTS_W int floodFill( InputOutputArray image, InputOutputArray mask,
                             Scalar loDiff=Scalar(), Scalar upDiff=Scalar(),
                             int flags=4 );
 
+//! statistics returned by connectedComponentsWithStats, one column each
+enum
+{
+    CC_STAT_LEFT   = 0, //!< leftmost column of the component bounding box
+    CC_STAT_TOP    = 1, //!< topmost row of the component bounding box
+    CC_STAT_WIDTH  = 2, //!< width of the component bounding box
+    CC_STAT_HEIGHT = 3, //!< height of the component bounding box
+    CC_STAT_AREA   = 4, //!< number of pixels in the component
+    CC_STAT_MAX    = 5
+};
+
+//! labels the connected components of a binary (zero/non-zero, 8UC1) image; returns the number of labels, background (0) included
+CV_EXPORTS_W int connectedComponents( InputArray image, OutputArray labels,
+                                      int connectivity=8, int ltype=CV_32S );
+
+//! labels the connected components and computes their bounding boxes, areas and centroids
+CV_EXPORTS_W int connectedComponentsWithStats( InputArray image, OutputArray labels,
+                                               OutputArray stats, OutputArray centroids,
+                                               int connectivity=8, int ltype=CV_32S );
+
 
 enum
 {
@@ -1143,6 +1196,27 @@ enum { TM_SQDIFF=0, TM_SQDIFF_NORMED=1, TM_CCORR=2, TM_CCORR_NORMED=3, TM_CCOEFF
 CV_EXPORTS_W void matchTemplate( InputArray image, InputArray templ,
                                  OutputArray result, int method );
 
+//! matchTemplate with one template over many images, keeping the template spectra and statistics between calls
+class CV_EXPORTS_W TemplateMatcher : public Algorithm
+{
+public:
+    CV_WRAP virtual void match(InputArray image, OutputArray result) = 0;
+
+    CV_WRAP virtual void setTemplate(InputArray templ) = 0;
+    CV_WRAP virtual Mat getTemplate() const = 0;
+
+    CV_WRAP virtual void setMethod(int method) = 0;
+    CV_WRAP virtual int getMethod() const = 0;
+
+    CV_WRAP virtual void setImageSize(Size imageSize) = 0;
+    CV_WRAP virtual Size getImageSize() const = 0;
+
+    CV_WRAP virtual void collectGarbage() = 0;
+};
+//! creates the matcher; the template is prepared lazily for the first image type and re-prepared when the image size changes
+CV_EXPORTS_W Ptr<TemplateMatcher> createTemplateMatcher(InputArray templ, int method=TM_CCOEFF_NORMED,
+                                                        Size imageSize=Size());
+
 //! mode of the contour retrieval algorithm
 enum
 {
@@ -363,7 +363,8 @@ enum
     CV_MOP_CLOSE        =3,
     CV_MOP_GRADIENT     =4,
     CV_MOP_TOPHAT       =5,
-    CV_MOP_BLACKHAT     =6
+    CV_MOP_BLACKHAT     =6,
+    CV_MOP_HITMISS      =7
 };
 
 /* Spatial and central moments */
@@ -49,6 +49,7 @@
 */
 
 #include "precomp.hpp"
+#include "avx2/morph_avx2.hpp"
 #include <limits.h>
 #include <stdio.h>
 
@@ -98,6 +99,21 @@ template<typename T> struct MaxOp
 template<> inline uchar MinOp<uchar>::operator ()(const uchar a, const uchar b) const { return CV_MIN_8U(a, b); }
 template<> inline uchar MaxOp<uchar>::operator ()(const uchar a, const uchar b) const { return CV_MAX_8U(a, b); }
 
+// Plain compare-and-select versions of MinOp/MaxOp. The van Herk/Gil-Werman filters
+// below run long serial chains of them, where the table lookup in CV_MIN_8U/CV_MAX_8U
+// is on the critical path and costs far more than a conditional move.
+template<typename T> struct MinSelOp
+{
+    typedef T rtype;
+    T operator ()(const T a, const T b) const { return std::min(a, b); }
+};
+
+template<typename T> struct MaxSelOp
+{
+    typedef T rtype;
+    T operator ()(const T a, const T b) const { return std::max(a, b); }
+};
+
 struct MorphRowNoVec
 {
     MorphRowNoVec(int, int) {}
@@ -718,6 +734,8 @@ template<class Op, class VecOp> struct MorphColumnFilter : public BaseColumnFilt
         anchor = _anchor;
     }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new MorphColumnFilter(*this)); }
+
     void operator()(const uchar** _src, uchar* dst, int dststep, int count, int width)
     {
         int i, k, _ksize = ksize;
@@ -819,6 +837,8 @@ template<class Op, class VecOp> struct MorphFilter : BaseFilter
         ptrs.resize( coords.size() );
     }
 
+    Ptr<BaseFilter> clone() const { return Ptr<BaseFilter>(new MorphFilter(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width, int cn)
     {
         const Point* pt = &coords[0];
@@ -867,6 +887,178 @@ template<class Op, class VecOp> struct MorphFilter : BaseFilter
     VecOp vecOp;
 };
 
+
+/*
+ van Herk/Gil-Werman running min/max. The input is split into blocks of ksize;
+ every window covers the tail of one block and the head of the next, so
+ its extremum is op(suffix of the first block, prefix of the second) and each
+ output costs about 3 comparisons whatever the kernel size is.
+*/
+template<class Op> struct MorphRowVHGWFilter : public BaseRowFilter
+{
+    typedef typename Op::rtype T;
+
+    MorphRowVHGWFilter( int _ksize, int _anchor )
+    {
+        ksize = _ksize;
+        anchor = _anchor;
+    }
+
+    void operator()(const uchar* src, uchar* dst, int width, int cn)
+    {
+        int j, k, b, n = width + ksize - 1, step = ksize*cn;
+        const T* S = (const T*)src;
+        T* D = (T*)dst;
+        Op op;
+
+        for( k = 0; k < cn; k++, S++, D++ )
+        {
+            // block suffixes go straight to dst. Every block is a serial
+            // dependency chain, so four blocks are interleaved at a time
+            for( b = 0; b + ksize*4 <= width; b += ksize*4 )
+            {
+                const T* s = S + b*cn;
+                T* d = D + b*cn;
+                j = step - cn;
+                T m0 = s[j], m1 = s[j+step], m2 = s[j+step*2], m3 = s[j+step*3];
+                d[j] = m0; d[j+step] = m1; d[j+step*2] = m2; d[j+step*3] = m3;
+
+                for( j -= cn; j >= 0; j -= cn )
+                {
+                    d[j] = m0 = op(m0, s[j]);
+                    d[j+step] = m1 = op(m1, s[j+step]);
+                    d[j+step*2] = m2 = op(m2, s[j+step*2]);
+                    d[j+step*3] = m3 = op(m3, s[j+step*3]);
+                }
+            }
+
+            for( ; b < width; b += ksize )
+            {
+                int e = b + ksize - 1;
+                T m = S[e*cn];
+                for( j = e - 1; j >= width; j-- )
+                    m = op(m, S[j*cn]);
+                if( e < width )
+                    D[e*cn] = m;
+                for( j = std::min(e, width) - 1; j >= b; j-- )
+                    D[j*cn] = m = op(m, S[j*cn]);
+            }
+
+            // block prefixes, each one completes the window that ends at it.
+            // The first block is skipped: it would only complete D[0],
+            // which already is the extremum of that block
+            for( b = ksize; b + ksize*4 <= n; b += ksize*4 )
+            {
+                const T* s = S + b*cn;
+                T* d = D + (b - ksize + 1)*cn;
+                T m0 = s[0], m1 = s[step], m2 = s[step*2], m3 = s[step*3];
+                d[0] = op(d[0], m0); d[step] = op(d[step], m1);
+                d[step*2] = op(d[step*2], m2); d[step*3] = op(d[step*3], m3);
+
+                for( j = cn; j < step; j += cn )
+                {
+                    m0 = op(m0, s[j]); d[j] = op(d[j], m0);
+                    m1 = op(m1, s[j+step]); d[j+step] = op(d[j+step], m1);
+                    m2 = op(m2, s[j+step*2]); d[j+step*2] = op(d[j+step*2], m2);
+                    m3 = op(m3, s[j+step*3]); d[j+step*3] = op(d[j+step*3], m3);
+                }
+            }
+
+            for( ; b < n; b += ksize )
+            {
+                int e = std::min(b + ksize, n);
+                T m = S[b*cn];
+                D[(b - ksize + 1)*cn] = op(D[(b - ksize + 1)*cn], m);
+                for( j = b + 1; j < e; j++ )
+                {
+                    m = op(m, S[j*cn]);
+                    D[(j - ksize + 1)*cn] = op(D[(j - ksize + 1)*cn], m);
+                }
+            }
+        }
+    }
+};
+
+
+/*
+ Column version of the van Herk/Gil-Werman filter. Blocks are aligned to the
+ output rows since the last reset(): on the first row of a block the window
+ is exactly that block and its row suffixes are saved; the following rows
+ combine a saved suffix with the running prefix of the next block, which is
+ updated with the newest row of the window. All the row operations are
+ vectorized across the columns.
+*/
+template<class Op, class VecOp> struct MorphColumnVHGWFilter : public BaseColumnFilter
+{
+    typedef typename Op::rtype T;
+
+    MorphColumnVHGWFilter( int _ksize, int _anchor )
+    {
+        ksize = _ksize;
+        anchor = _anchor;
+        row = 0;
+    }
+
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter(*this)); }
+
+    void reset() { row = 0; }
+
+    void operator()(const uchar** _src, uchar* dst, int dststep, int count, int width)
+    {
+        const T** src = (const T**)_src;
+        int j;
+
+        if( suffix.size() != (size_t)(ksize + 1)*width )
+        {
+            suffix.resize((ksize + 1)*width);
+            row = 0;
+        }
+        T* prefix = &suffix[ksize*width];
+
+        for( ; count > 0; count--, dst += dststep, src++, row++ )
+        {
+            int phase = row % ksize;
+            T* D = (T*)dst;
+
+            if( phase == 0 )
+            {
+                T* H = &suffix[(ksize - 1)*width];
+                memcpy( H, src[ksize-1], width*sizeof(T) );
+                for( j = ksize - 2; j >= 0; j--, H -= width )
+                    update( src[j], H, H - width, width );
+                memcpy( D, &suffix[0], width*sizeof(T) );
+            }
+            else
+            {
+                if( phase == 1 )
+                    memcpy( prefix, src[ksize-1], width*sizeof(T) );
+                else
+                    update( prefix, src[ksize-1], prefix, width );
+                update( &suffix[phase*width], prefix, D, width );
+            }
+        }
+    }
+
+    void update( const T* a, const T* b, T* d, int width ) const
+    {
+        uchar* ptrs[] = { (uchar*)a, (uchar*)b };
+        Op op;
+        int i = vecOp(ptrs, 2, (uchar*)d, width);
+        for( ; i < width; i++ )
+            d[i] = op(a[i], b[i]);
+    }
+
+    vector<T> suffix;
+    int row;
+    VecOp vecOp;
+};
+
+// Kernel sizes, per depth, from which the van Herk/Gil-Werman filters beat the direct ones.
+// The SIMD row filters process many pixels per instruction, so the crossover is much
+// later for 8u rows than for 32f/64f ones; 8s and 32s are not supported by either.
+static const int vhgwMinRowKSize[] = { 40, INT_MAX, 16, 16, INT_MAX, 7, 5, INT_MAX };
+static const int vhgwMinColumnKSize[] = { 5, INT_MAX, 7, 7, INT_MAX, 13, 9, INT_MAX };
+
 }
 
 /////////////////////////////////// External Interface /////////////////////////////////////
@@ -877,6 +1069,36 @@ cv::Ptr<cv::BaseRowFilter> cv::getMorphologyRowFilter(int op, int type, int ksiz
     if( anchor < 0 )
         anchor = ksize/2;
     CV_Assert( op == MORPH_ERODE || op == MORPH_DILATE );
+    if( ksize >= vhgwMinRowKSize[depth] )
+    {
+        if( op == MORPH_ERODE )
+        {
+            if( depth == CV_8U )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MinSelOp<uchar> >(ksize, anchor));
+            if( depth == CV_16U )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MinSelOp<ushort> >(ksize, anchor));
+            if( depth == CV_16S )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MinSelOp<short> >(ksize, anchor));
+            if( depth == CV_32F )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MinSelOp<float> >(ksize, anchor));
+            if( depth == CV_64F )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MinSelOp<double> >(ksize, anchor));
+        }
+        else
+        {
+            if( depth == CV_8U )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MaxSelOp<uchar> >(ksize, anchor));
+            if( depth == CV_16U )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MaxSelOp<ushort> >(ksize, anchor));
+            if( depth == CV_16S )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MaxSelOp<short> >(ksize, anchor));
+            if( depth == CV_32F )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MaxSelOp<float> >(ksize, anchor));
+            if( depth == CV_64F )
+                return Ptr<BaseRowFilter>(new MorphRowVHGWFilter<MaxSelOp<double> >(ksize, anchor));
+        }
+    }
+
     if( op == MORPH_ERODE )
     {
         if( depth == CV_8U )
@@ -924,6 +1146,46 @@ cv::Ptr<cv::BaseColumnFilter> cv::getMorphologyColumnFilter(int op, int type, in
     if( anchor < 0 )
         anchor = ksize/2;
     CV_Assert( op == MORPH_ERODE || op == MORPH_DILATE );
+    if( ksize >= vhgwMinColumnKSize[depth] )
+    {
+        if( op == MORPH_ERODE )
+        {
+            if( depth == CV_8U )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MinSelOp<uchar>,
+                                             ErodeVec8u>(ksize, anchor));
+            if( depth == CV_16U )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MinSelOp<ushort>,
+                                             ErodeVec16u>(ksize, anchor));
+            if( depth == CV_16S )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MinSelOp<short>,
+                                             ErodeVec16s>(ksize, anchor));
+            if( depth == CV_32F )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MinSelOp<float>,
+                                             ErodeVec32f>(ksize, anchor));
+            if( depth == CV_64F )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MinSelOp<double>,
+                                             ErodeVec64f>(ksize, anchor));
+        }
+        else
+        {
+            if( depth == CV_8U )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MaxSelOp<uchar>,
+                                             DilateVec8u>(ksize, anchor));
+            if( depth == CV_16U )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MaxSelOp<ushort>,
+                                             DilateVec16u>(ksize, anchor));
+            if( depth == CV_16S )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MaxSelOp<short>,
+                                             DilateVec16s>(ksize, anchor));
+            if( depth == CV_32F )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MaxSelOp<float>,
+                                             DilateVec32f>(ksize, anchor));
+            if( depth == CV_64F )
+                return Ptr<BaseColumnFilter>(new MorphColumnVHGWFilter<MaxSelOp<double>,
+                                             DilateVec64f>(ksize, anchor));
+        }
+    }
+
     if( op == MORPH_ERODE )
     {
         if( depth == CV_8U )
@@ -1389,6 +1651,179 @@ static void morphOp( int op, InputArray _src, OutputArray _dst,
    //    f->apply( dst, dst );
 }
 
+/*
+ OPEN, CLOSE, GRADIENT, TOPHAT and BLACKHAT in a single pass. A compound operation is one or
+ two chains of erode/dilate filter engines (one per iteration, after the same kernel
+ substitutions as in morphOp) that are fed the source rows in small chunks. Each engine keeps
+ its own ring buffer and passes its output rows to the next one through a chunk-sized buffer,
+ and the rows coming out of the chains are combined with the source and stored right away.
+ The intermediate images are treated as isolated, like the temporaries of the unfused version.
+*/
+class MorphCompoundRunner : public ParallelLoopBody
+{
+public:
+    enum { CHUNK_ROWS = 32 };
+
+    MorphCompoundRunner(const Mat& _src, Mat& _dst, int _op, const Mat& _kernel, Point _anchor,
+                        int _iterations, int _borderType, const Scalar& _borderValue, int _nStripes) :
+        src(_src), dst(_dst), op(_op), kernel(_kernel), anchor(_anchor), iterations(_iterations),
+        borderType(_borderType), borderValue(_borderValue), nStripes(_nStripes)
+    {
+    }
+
+    void operator () ( const Range& range ) const
+    {
+        int row0 = src.rows*range.start/nStripes, row1 = src.rows*range.end/nStripes;
+        if( row0 >= row1 )
+            return;
+
+        int first = op == MORPH_OPEN || op == MORPH_TOPHAT ? MORPH_ERODE : MORPH_DILATE;
+        int nchains = op == MORPH_GRADIENT ? 2 : 1;
+        int nstages = op == MORPH_GRADIENT ? iterations : iterations*2;
+        bool isolated = (borderType & BORDER_ISOLATED) != 0;
+        int btype = borderType & ~BORDER_ISOLATED;
+        int c, k, esz = (int)src.elemSize();
+        int bufStep = (int)alignSize(src.cols*esz, 16), bufRows = 0;
+        std::vector<Ptr<FilterEngine> > stages(nchains*nstages);
+        std::vector<int> bufOfs(stages.size());
+
+        Point ofs;
+        Size wsz(src.cols, src.rows);
+        if( !isolated )
+            src.locateROI( wsz, ofs );
+
+        // the second chain of GRADIENT erodes; it has the geometry of the first one, so both
+        // consume and produce the same number of rows at every step
+        for( c = 0; c < nchains; c++ )
+        {
+            Rect roi(0, row0, src.cols, row1 - row0);
+            for( k = nstages - 1; k >= 0; k-- )
+            {
+                int stageOp = c > 0 ? MORPH_ERODE : (k < nstages/2 || op == MORPH_GRADIENT) ? first :
+                    first == MORPH_ERODE ? MORPH_DILATE : MORPH_ERODE;
+                Ptr<FilterEngine> f = createMorphologyFilter(stageOp, src.type(), kernel, anchor,
+                                                             btype, btype, borderValue);
+                if( k > 0 )
+                    f->start(src.size(), roi);
+                else
+                    f->start(wsz, roi + ofs);
+                roi = Rect(0, f->startY, src.cols, f->endY - f->startY);
+                stages[c*nstages + k] = f;
+            }
+        }
+
+        // a stage outputs at most ksize.height - 1 rows more than it is given
+        for( k = 0; k < (int)stages.size(); k++ )
+        {
+            bufOfs[k] = bufRows*bufStep;
+            bufRows += CHUNK_ROWS + (k % nstages + 1)*kernel.rows;
+        }
+        AutoBuffer<uchar> _buf(bufRows*bufStep + 16);
+        uchar* buf = alignPtr((uchar*)_buf, 16);
+
+        bool direct = op == MORPH_OPEN || op == MORPH_CLOSE;
+        const FilterEngine& f0 = *stages[0];
+        const uchar* sptr = src.data + (f0.startY - ofs.y)*src.step;
+        int remaining = f0.endY - f0.startY, y = row0;
+        Mat dstImg = dst;
+
+        while( remaining > 0 )
+        {
+            int count = std::min(remaining, (int)CHUNK_ROWS), n = 0;
+
+            for( c = 0; c < nchains; c++ )
+            {
+                const uchar* in = sptr;
+                int instep = (int)src.step;
+                n = count;
+                for( k = 0; k < nstages && n > 0; k++ )
+                {
+                    bool last = k == nstages - 1;
+                    uchar* out = last && direct ? dstImg.ptr(y) : buf + bufOfs[c*nstages + k];
+                    int outstep = last && direct ? (int)dst.step : bufStep;
+                    n = stages[c*nstages + k]->proceed(in, instep, n, out, outstep);
+                    in = out;
+                    instep = outstep;
+                }
+            }
+
+            if( n > 0 && !direct )
+            {
+                Mat a(n, src.cols, src.type(), buf + bufOfs[nstages - 1], bufStep);
+                Mat srcRows = src.rowRange(y, y + n), dstRows = dst.rowRange(y, y + n);
+                if( op == MORPH_GRADIENT )
+                    subtract(a, Mat(n, src.cols, src.type(), buf + bufOfs[nstages*2 - 1], bufStep), dstRows);
+                else if( op == MORPH_TOPHAT )
+                    subtract(srcRows, a, dstRows);
+                else
+                    subtract(a, srcRows, dstRows);
+            }
+
+            y += n;
+            sptr += count*src.step;
+            remaining -= count;
+        }
+        CV_Assert( y == row1 );
+    }
+
+private:
+    Mat src;
+    Mat dst;
+    int op;
+    Mat kernel;
+    Point anchor;
+    int iterations;
+    int borderType;
+    Scalar borderValue;
+    int nStripes;
+};
+
+static void morphCompoundOp( int op, const Mat& src, Mat& dst, InputArray _kernel,
+                             Point anchor, int iterations,
+                             int borderType, const Scalar& borderValue )
+{
+    Mat kernel = _kernel.getMat();
+    Size ksize = kernel.data ? kernel.size() : Size(3,3);
+    anchor = normalizeAnchor(anchor, ksize);
+
+    CV_Assert( anchor.inside(Rect(0, 0, ksize.width, ksize.height)) );
+
+    if( iterations == 0 || kernel.rows*kernel.cols == 1 )
+    {
+        if( op == MORPH_OPEN || op == MORPH_CLOSE )
+            src.copyTo(dst);
+        else
+            dst = Scalar::all(0);
+        return;
+    }
+
+    if( !kernel.data )
+    {
+        kernel = getStructuringElement(MORPH_RECT, Size(1+iterations*2,1+iterations*2));
+        anchor = Point(iterations, iterations);
+        iterations = 1;
+    }
+    else if( iterations > 1 && countNonZero(kernel) == kernel.rows*kernel.cols )
+    {
+        anchor = Point(anchor.x*iterations, anchor.y*iterations);
+        kernel = getStructuringElement(MORPH_RECT,
+                                       Size(ksize.width + (iterations-1)*(ksize.width-1),
+                                            ksize.height + (iterations-1)*(ksize.height-1)),
+                                       anchor);
+        iterations = 1;
+    }
+
+    // the stripes recompute the rows of every stage around their boundaries, so keep them
+    // tall; in-place processing relies on the rows being processed sequentially
+    int nStripes = 1, nthreads = getNumThreads();
+    int halo = kernel.rows*iterations*(op == MORPH_GRADIENT ? 1 : 2);
+    if( nthreads > 1 && !(dst.datastart < src.dataend && src.datastart < dst.dataend) )
+        nStripes = std::max(std::min(std::min(nthreads*2, (int)(src.total()>> 15)), src.rows/(halo*4)), 1);
+
+    parallel_for_(Range(0, nStripes),
+                  MorphCompoundRunner(src, dst, op, kernel, anchor, iterations, borderType, borderValue, nStripes));
+}
+
 template<> void Ptr<IplConvKernel>::delete_obj()
 { cvReleaseStructuringElement(&obj); }
 
@@ -1430,6 +1865,15 @@ void cv::morphologyEx( InputArray _src, OutputArray _dst, int op,
     _dst.create(src.size(), src.type());
     Mat dst = _dst.getMat();
 
+#ifndef _TI66X
+    if( op == MORPH_OPEN || op == MORPH_CLOSE || op == MORPH_GRADIENT ||
+        op == MORPH_TOPHAT || op == MORPH_BLACKHAT )
+    {
+        morphCompoundOp( op, src, dst, kernel, anchor, iterations, borderType, borderValue );
+        return;
+    }
+#endif
+
     switch( op )
     {
     case MORPH_ERODE:
@@ -1465,11 +1909,586 @@ void cv::morphologyEx( InputArray _src, OutputArray _dst, int op,
         erode( temp, temp, kernel, anchor, iterations, borderType, borderValue );
         dst = temp - src;
         break;
+    case MORPH_HITMISS:
+        binaryMorphologyEx( src, dst, op, kernel, anchor, iterations, borderType, borderValue );
+        break;
     default:
         CV_Error( CV_StsBadArg, "unknown morphological operation" );
     }
 }
 
+
+/****************************************************************************************\
+                          Binary Morphology on Bit-Packed Masks
+\****************************************************************************************/
+
+namespace cv
+{
+
+enum { BINARY_COPY = 0, BINARY_AND = 1, BINARY_OR = 2, BINARY_ANDNOT = 3 };
+
+// 1 bit per pixel, least significant bit first. Every row has padX pixels (a multiple of 64)
+// of border on both sides; there are padY border rows above and below and a row of guard
+// words at the end, since the shifted reads go one word past the data.
+struct BinaryMask
+{
+    void create( Size size, int _padX, int _padY )
+    {
+        rows = size.height;
+        cols = size.width;
+        padX = (_padX + 63) & -64;
+        padY = _padY;
+        nwords = (cols + 63) >> 6;
+        wstep = nwords + (padX >> 5);
+        buf.resize((size_t)(rows + padY*2 + 1)*wstep);
+    }
+
+    // word that holds pixel 0 of row y, -padY <= y < rows + padY
+    uint64* ptr(int y) { return &buf[(size_t)(y + padY)*wstep + (padX >> 6)]; }
+    const uint64* ptr(int y) const { return &buf[(size_t)(y + padY)*wstep + (padX >> 6)]; }
+
+    int rows, cols, nwords, padX, padY, wstep;
+    vector<uint64> buf;
+};
+
+static inline int getMaskBit( const uint64* row, int x )
+{
+    return (int)(row[x >> 6] >> (x & 63)) & 1;
+}
+
+static inline void setMaskBit( uint64* row, int x, int bit )
+{
+    uint64 m = (uint64)1 << (x & 63);
+    row[x >> 6] = bit ? row[x >> 6] | m : row[x >> 6] & ~m;
+}
+
+// dst[k] = dst[k] <op> w[k], w being the bit string of src that starts at bit shift (0..63)
+static void combineShiftedWords( uint64* dst, const uint64* src, int shift, int nwords, int op )
+{
+    int k = 0;
+
+    if( checkHardwareSupport(CV_CPU_AVX2) )
+        k = BinaryCombineShifted_avx2(dst, src, shift, nwords, op);
+
+#if CV_SSE2
+    if( checkHardwareSupport(CV_CPU_SSE2) )
+    {
+        __m128i sr = _mm_cvtsi32_si128(shift), sl = _mm_cvtsi32_si128(64 - shift);
+        for( ; k <= nwords - 2; k += 2 )
+        {
+            __m128i w = _mm_or_si128(_mm_srl_epi64(_mm_loadu_si128((const __m128i*)(src + k)), sr),
+                                     _mm_sll_epi64(_mm_loadu_si128((const __m128i*)(src + k + 1)), sl));
+            __m128i* d = (__m128i*)(dst + k);
+            if( op == BINARY_AND )
+                w = _mm_and_si128(_mm_loadu_si128(d), w);
+            else if( op == BINARY_OR )
+                w = _mm_or_si128(_mm_loadu_si128(d), w);
+            _mm_storeu_si128(d, w);
+        }
+    }
+#endif
+
+    for( ; k < nwords; k++ )
+    {
+        uint64 w = shift ? (src[k] >> shift) | (src[k+1] << (64 - shift)) : src[k];
+        dst[k] = op == BINARY_AND ? dst[k] & w : op == BINARY_OR ? dst[k] | w : w;
+    }
+}
+
+static void packMaskRow( const uchar* src, uint64* dst, int width, bool invert )
+{
+    int x = 0;
+    uint64 flip = invert ? 0 : ~(uint64)0;
+
+    if( checkHardwareSupport(CV_CPU_AVX2) )
+        x = BinaryPackRow_avx2(src, dst, width, invert);
+
+#if CV_SSE2
+    if( checkHardwareSupport(CV_CPU_SSE2) )
+    {
+        __m128i z = _mm_setzero_si128();
+        for( ; x <= width - 64; x += 64 )
+        {
+            // the masks have bits set for the zero pixels
+            uint64 m0 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + x)), z));
+            uint64 m1 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + x + 16)), z));
+            uint64 m2 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + x + 32)), z));
+            uint64 m3 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(src + x + 48)), z));
+            dst[x >> 6] = (m0 | (m1 << 16) | (m2 << 32) | (m3 << 48)) ^ flip;
+        }
+    }
+#endif
+
+    for( ; x < width; x += 64 )
+    {
+        int j, n = std::min(width - x, 64);
+        uint64 w = 0;
+        for( j = 0; j < n; j++ )
+            w |= (uint64)(src[x + j] != 0) << j;
+        dst[x >> 6] = invert ? ~w : w;
+    }
+}
+
+static void unpackMaskRow( const uint64* a, const uint64* b, int op, uchar* dst, int width )
+{
+    int x = 0;
+
+    if( checkHardwareSupport(CV_CPU_AVX2) )
+        x = BinaryUnpackRow_avx2(a, b, op, dst, width);
+
+#if CV_SSE2
+    if( checkHardwareSupport(CV_CPU_SSE2) )
+    {
+        __m128i bits = _mm_set_epi8((char)128, 64, 32, 16, 8, 4, 2, 1, (char)128, 64, 32, 16, 8, 4, 2, 1);
+        for( ; x <= width - 64; x += 64 )
+        {
+            uint64 w = a[x >> 6];
+            if( op == BINARY_AND )
+                w &= b[x >> 6];
+            else if( op == BINARY_ANDNOT )
+                w &= ~b[x >> 6];
+
+            for( int j = 0; j < 64; j += 16, w >>= 16 )
+            {
+                // spread every bit of the 16-bit chunk over a byte and expand it to 0/255
+                __m128i v = _mm_cvtsi32_si128((int)(w & 0xffff));
+                v = _mm_unpacklo_epi8(v, v);
+                v = _mm_unpacklo_epi16(v, v);
+                v = _mm_unpacklo_epi32(v, v);
+                v = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+                _mm_storeu_si128((__m128i*)(dst + x + j), v);
+            }
+        }
+    }
+#endif
+
+    for( ; x < width; x += 64 )
+    {
+        int j, n = std::min(width - x, 64);
+        uint64 w = a[x >> 6];
+        if( op == BINARY_AND )
+            w &= b[x >> 6];
+        else if( op == BINARY_ANDNOT )
+            w &= ~b[x >> 6];
+        for( j = 0; j < n; j++ )
+            dst[x + j] = (uchar)-(int)((w >> j) & 1);
+    }
+}
+
+
+// Packs src into dst, border included. Like FilterEngine, the pixels outside a non-isolated
+// ROI are taken from the parent image; the border is only extrapolated beyond the parent.
+class BinaryPackInvoker : public ParallelLoopBody
+{
+public:
+    BinaryPackInvoker( const Mat& _src, BinaryMask& _dst, int _kx,
+                       int _borderType, int _borderBit, bool _invert ) :
+        src(&_src), dst(&_dst), kx(_kx), borderType(_borderType & ~BORDER_ISOLATED),
+        borderBit(_borderBit), invert(_invert)
+    {
+        if( _borderType & BORDER_ISOLATED )
+        {
+            wholeSize = src->size();
+            ofs = Point();
+        }
+        else
+            src->locateROI(wholeSize, ofs);
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int x, y, cols = src->cols;
+
+        // the range counts the border rows too
+        for( y = range.start - dst->padY; y < range.end - dst->padY; y++ )
+        {
+            uint64* D = dst->ptr(y);
+            int sy = y + ofs.y;
+
+            if( (unsigned)sy >= (unsigned)wholeSize.height )
+            {
+                if( borderType == BORDER_CONSTANT )
+                {
+                    uint64* row = D - (dst->padX >> 6);
+                    std::fill(row, row + dst->wstep, borderBit ? ~(uint64)0 : (uint64)0);
+                    continue;
+                }
+                sy = borderInterpolate(sy, wholeSize.height, borderType);
+            }
+
+            // sy is in the parent coordinates, S points to the pixel 0 of the ROI
+            const uchar* S = src->data + (sy - ofs.y)*src->step;
+            packMaskRow(S, D, cols, invert);
+
+            for( x = kx > 0 ? -kx : cols; x < cols + kx; x = x + 1 == 0 ? cols : x + 1 )
+            {
+                int sx = x + ofs.x, bit = borderBit;
+                if( (unsigned)sx < (unsigned)wholeSize.width )
+                    bit = (S[x] != 0) ^ invert;
+                else if( borderType != BORDER_CONSTANT )
+                    bit = (S[borderInterpolate(sx, wholeSize.width, borderType) - ofs.x] != 0) ^ invert;
+                setMaskBit(D, x, bit);
+            }
+        }
+    }
+
+private:
+    const Mat* src;
+    BinaryMask* dst;
+    int kx, borderType, borderBit;
+    bool invert;
+    Size wholeSize;
+    Point ofs;
+};
+
+
+// Extrapolates the border of an intermediate result, which is always treated as isolated
+static void fillMaskBorder( BinaryMask& m, int kx, int ky, int borderType, int borderBit )
+{
+    int x, y, cols = m.cols, rows = m.rows;
+    uint64 fillWord = borderBit ? ~(uint64)0 : (uint64)0;
+    borderType &= ~BORDER_ISOLATED;
+
+    for( y = 0; y < rows; y++ )
+    {
+        uint64* row = m.ptr(y);
+        for( x = kx > 0 ? -kx : cols; x < cols + kx; x = x + 1 == 0 ? cols : x + 1 )
+            setMaskBit(row, x, borderType == BORDER_CONSTANT ? borderBit :
+                       getMaskBit(row, borderInterpolate(x, cols, borderType)));
+    }
+
+    for( y = ky > 0 ? -ky : rows; y < rows + ky; y = y + 1 == 0 ? rows : y + 1 )
+    {
+        uint64* row = m.ptr(y) - (m.padX >> 6);
+        if( borderType == BORDER_CONSTANT )
+            std::fill(row, row + m.wstep, fillWord);
+        else
+            memcpy(row, m.ptr(borderInterpolate(y, rows, borderType)) - (m.padX >> 6),
+                   m.wstep*sizeof(row[0]));
+    }
+}
+
+
+// Structuring element split into horizontal runs of ones; the runs of the same length and
+// column in consecutive rows are merged into blocks. A block is (dx, dy, width, height),
+// (dx, dy) being the offset of its top left pixel from the anchor. The blocks are sorted
+// by width.
+struct BinaryMorphKernel
+{
+    BinaryMorphKernel( const Mat& kernel, Point anchor )
+    {
+        vector<Vec4i> runs;
+        int i, j;
+
+        for( i = 0; i < kernel.rows; i++ )
+        {
+            const uchar* k = kernel.ptr(i);
+            for( j = 0; j < kernel.cols; j++ )
+            {
+                if( !k[j] )
+                    continue;
+                int j0 = j;
+                while( j + 1 < kernel.cols && k[j+1] )
+                    j++;
+                runs.push_back(Vec4i(j0 - anchor.x, i - anchor.y, j - j0 + 1, 1));
+            }
+        }
+
+        std::sort(runs.begin(), runs.end(), BlockLess());
+        for( i = 0; i < (int)runs.size(); i++ )
+        {
+            const Vec4i& r = runs[i];
+            Vec4i* last = blocks.empty() ? 0 : &blocks.back();
+            if( last && (*last)[0] == r[0] && (*last)[2] == r[2] && (*last)[1] + (*last)[3] == r[1] )
+                (*last)[3]++;
+            else
+                blocks.push_back(r);
+        }
+    }
+
+    struct BlockLess
+    {
+        bool operator()(const Vec4i& a, const Vec4i& b) const
+        { return a[2] < b[2] || (a[2] == b[2] && (a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]))); }
+    };
+
+    vector<Vec4i> blocks;
+};
+
+
+// One erosion (BINARY_AND) or dilation (BINARY_OR) pass over a stripe of rows. The extrema
+// H_W of the source rows over the block widths W are grown block after block by doubling;
+// the blocks then combine their rows of H_W vertically, also by doubling when they are tall.
+// So a pass costs about log2 of the kernel size word operations per row for rectangles and
+// two per kernel row for the other usual shapes.
+class BinaryMorphInvoker : public ParallelLoopBody
+{
+public:
+    BinaryMorphInvoker( const BinaryMask& _src, BinaryMask& _dst, const BinaryMorphKernel& _kernel,
+                        int _op, int _stripeRows ) :
+        src(&_src), dst(&_dst), kernel(&_kernel), op(_op), stripeRows(_stripeRows)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        // blocks at least that tall are combined by doubling
+        const int MIN_DOUBLING_HEIGHT = 4;
+        const vector<Vec4i>& blocks = kernel->blocks;
+        int i, j, W = 0, n = (int)blocks.size(), nwords = dst->nwords, first = 1;
+        int y0 = range.start*stripeRows, y1 = std::min(range.end*stripeRows, dst->rows);
+        int padY = src->padY, padW = src->padX >> 6;
+
+        if( n == 0 )
+        {
+            for( int y = y0; y < y1; y++ )
+                std::fill(dst->ptr(y), dst->ptr(y) + nwords, op == BINARY_AND ? ~(uint64)0 : (uint64)0);
+            return;
+        }
+
+        // The extrema of the stripe rows and the padY rows around them. The buffers have the
+        // layout of src, so whole stripes are processed as one bit string: the bits that the
+        // shifts move between rows only land in the border and guard words.
+        int wstep = src->wstep, nrows = y1 - y0 + padY*2, nbuf = nrows*wstep;
+        AutoBuffer<uint64> _hbuf(nbuf + wstep), _vbuf;
+        uint64 *H = _hbuf, *V = 0;
+        uint64* D = dst->ptr(y0);
+
+        for( i = 0; i < n; i++ )
+        {
+            const Vec4i& b = blocks[i];
+            int dx = b[0], dy = b[1], bw = b[2], bh = b[3];
+
+            if( W == 0 )
+            {
+                memcpy(H, src->ptr(y0 - padY) - padW, nbuf*sizeof(H[0]));
+                W = 1;
+            }
+
+            // H_{W+d}(x) = H_W(x) <op> H_W(x+d) for d <= W; it is computed in place,
+            // as every word only depends on itself and the words after it
+            while( W < bw )
+            {
+                int d = std::min(bw - W, W);
+                combineShiftedWords(H, H + (d >> 6), d & 63, nbuf, op);
+                W += d;
+            }
+
+            // the pixel 0 word of the H row that goes with the first stripe row
+            const uint64* S = H + (padY + dy)*wstep + padW + (dx >> 6);
+
+            if( bh >= MIN_DOUBLING_HEIGHT )
+            {
+                // the same in place doubling over the rows of a copy of H
+                int vrows = y1 - y0 + bh - 1, h = 1;
+                if( !V )
+                {
+                    _vbuf.allocate(nbuf + wstep);
+                    V = _vbuf;
+                }
+                memcpy(V, S - padW - (dx >> 6), vrows*wstep*sizeof(V[0]));
+                for( ; h < bh; )
+                {
+                    int d = std::min(bh - h, h);
+                    h += d;
+                    combineShiftedWords(V, V + d*wstep, 0, (vrows - h + 1)*wstep, op);
+                }
+                S = V + padW + (dx >> 6);
+                bh = 1;
+            }
+
+            for( j = 0; j < bh; j++, first = 0 )
+                combineShiftedWords(D, S + j*wstep, dx & 63, (y1 - y0)*wstep, first ? BINARY_COPY : op);
+        }
+    }
+
+private:
+    const BinaryMask* src;
+    BinaryMask* dst;
+    const BinaryMorphKernel* kernel;
+    int op, stripeRows;
+};
+
+
+class BinaryUnpackInvoker : public ParallelLoopBody
+{
+public:
+    BinaryUnpackInvoker( const BinaryMask& _a, const BinaryMask* _b, int _op, Mat& _dst ) :
+        a(&_a), b(_b), op(_op), dst(&_dst)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int y = range.start; y < range.end; y++ )
+            unpackMaskRow(a->ptr(y), b ? b->ptr(y) : 0, op, dst->ptr(y), dst->cols);
+    }
+
+private:
+    const BinaryMask* a;
+    const BinaryMask* b;
+    int op;
+    Mat* dst;
+};
+
+
+struct BinaryMorphology
+{
+    BinaryMorphology( Size _size, int _kx, int _ky, int _borderType ) :
+        size(_size), kx(_kx), ky(_ky), borderType(_borderType)
+    {
+    }
+
+    BinaryMask* mask( int i )
+    {
+        if( masks[i].buf.empty() )
+            masks[i].create(size, kx, ky);
+        return &masks[i];
+    }
+
+    BinaryMask* pack( const Mat& src, int i, int borderBit, bool invert=false )
+    {
+        parallel_for_(Range(0, size.height + ky*2),
+                      BinaryPackInvoker(src, *mask(i), kx, borderType, borderBit, invert));
+        return &masks[i];
+    }
+
+    // Runs the passes ping-ponging between a and b; returns the one that holds the result.
+    // The border of a is filled first unless it comes straight from pack().
+    BinaryMask* run( BinaryMask* a, BinaryMask* b, const BinaryMorphKernel& kernel, int op,
+                     int iterations, int borderBit, bool fillBorder )
+    {
+        // short stripes keep the run extrema in cache; ky rows above and below are redone
+        int stripeRows = std::max(ky*4, 32), nstripes = (size.height + stripeRows - 1)/stripeRows;
+
+        for( int i = 0; i < iterations; i++ )
+        {
+            if( i > 0 || fillBorder )
+                fillMaskBorder(*a, kx, ky, borderType, borderBit);
+            parallel_for_(Range(0, nstripes), BinaryMorphInvoker(*a, *b, kernel, op, stripeRows));
+            std::swap(a, b);
+        }
+        return a;
+    }
+
+    BinaryMask* other( BinaryMask* m, int i, int j ) { return m == &masks[i] ? mask(j) : mask(i); }
+
+    void unpack( Mat& dst, const BinaryMask* a, const BinaryMask* b=0, int op=BINARY_COPY )
+    {
+        parallel_for_(Range(0, size.height), BinaryUnpackInvoker(*a, b, op, dst));
+    }
+
+    Size size;
+    int kx, ky, borderType;
+    BinaryMask masks[4];
+};
+
+}
+
+
+void cv::binaryMorphologyEx( InputArray _src, OutputArray _dst, int op,
+                             InputArray _kernel, Point anchor, int iterations,
+                             int borderType, const Scalar& borderValue )
+{
+    Mat src = _src.getMat(), kernel = _kernel.getMat(), hit, miss;
+    CV_Assert( src.type() == CV_8UC1 );
+
+    Size ksize = kernel.data ? kernel.size() : Size(3,3);
+    anchor = normalizeAnchor(anchor, ksize);
+
+    if( op == MORPH_HITMISS )
+    {
+        CV_Assert( kernel.data && kernel.channels() == 1 );
+        Mat k32;
+        kernel.convertTo(k32, CV_32S);
+        hit = k32 > 0;
+        miss = k32 < 0;
+        iterations = 1;
+    }
+    else
+    {
+        if( op < MORPH_ERODE || op > MORPH_BLACKHAT )
+            CV_Error( CV_StsBadArg, "unknown morphological operation" );
+
+        // the same kernel substitutions as in morphOp()
+        if( !kernel.data )
+        {
+            kernel = getStructuringElement(MORPH_RECT, Size(1+iterations*2,1+iterations*2));
+            anchor = Point(iterations, iterations);
+            iterations = 1;
+        }
+        else if( iterations > 1 && countNonZero(kernel) == kernel.rows*kernel.cols )
+        {
+            anchor = Point(anchor.x*iterations, anchor.y*iterations);
+            kernel = getStructuringElement(MORPH_RECT,
+                                           Size(ksize.width + (iterations-1)*(ksize.width-1),
+                                                ksize.height + (iterations-1)*(ksize.height-1)),
+                                           anchor);
+            iterations = 1;
+        }
+        hit = kernel != 0;
+    }
+    if( iterations != 0 )
+        iterations = std::max(iterations, 1);
+
+    // like in createMorphologyFilter(), the default constant border never affects the result
+    bool defaultBorder = borderValue == morphologyDefaultBorderValue();
+    int borderBit = saturate_cast<uchar>(borderValue[0]) != 0;
+    int erodeBit = defaultBorder ? 1 : borderBit, dilateBit = defaultBorder ? 0 : borderBit;
+
+    BinaryMorphKernel k(hit, anchor);
+    BinaryMorphology m(src.size(), std::max(anchor.x, hit.cols - 1 - anchor.x),
+                       std::max(anchor.y, hit.rows - 1 - anchor.y), borderType);
+
+    // everything is packed before dst is written, so dst may be src
+    BinaryMask *a, *b = 0;
+    switch( op )
+    {
+    case MORPH_ERODE:
+        a = m.run(m.pack(src, 0, erodeBit), m.mask(1), k, BINARY_AND, iterations, erodeBit, false);
+        break;
+    case MORPH_DILATE:
+        a = m.run(m.pack(src, 0, dilateBit), m.mask(1), k, BINARY_OR, iterations, dilateBit, false);
+        break;
+    case MORPH_OPEN:
+    case MORPH_TOPHAT:
+        a = m.run(m.pack(src, 0, erodeBit), m.mask(1), k, BINARY_AND, iterations, erodeBit, false);
+        a = m.run(a, m.other(a, 0, 1), k, BINARY_OR, iterations, dilateBit, true);
+        b = op == MORPH_TOPHAT ? m.pack(src, 2, 0) : 0;
+        break;
+    case MORPH_CLOSE:
+    case MORPH_BLACKHAT:
+        a = m.run(m.pack(src, 0, dilateBit), m.mask(1), k, BINARY_OR, iterations, dilateBit, false);
+        a = m.run(a, m.other(a, 0, 1), k, BINARY_AND, iterations, erodeBit, true);
+        b = op == MORPH_BLACKHAT ? m.pack(src, 2, 0) : 0;
+        break;
+    case MORPH_GRADIENT:
+        a = m.run(m.pack(src, 0, dilateBit), m.mask(1), k, BINARY_OR, iterations, dilateBit, false);
+        b = m.run(m.pack(src, 2, erodeBit), m.mask(3), k, BINARY_AND, iterations, erodeBit, false);
+        break;
+    default: // MORPH_HITMISS
+        {
+        // the background part erodes the complement of the mask
+        BinaryMorphKernel mk(miss, anchor);
+        a = m.run(m.pack(src, 0, erodeBit), m.mask(1), k, BINARY_AND, 1, erodeBit, false);
+        b = m.run(m.pack(src, 2, defaultBorder ? 1 : !borderBit, true), m.mask(3), mk,
+                  BINARY_AND, 1, erodeBit, false);
+        }
+    }
+
+    _dst.create(src.size(), CV_8UC1);
+    Mat dst = _dst.getMat();
+
+    if( op == MORPH_HITMISS )
+        m.unpack(dst, a, b, BINARY_AND);
+    else if( op == MORPH_GRADIENT || op == MORPH_BLACKHAT )
+        m.unpack(dst, a, b, BINARY_ANDNOT);
+    else if( op == MORPH_TOPHAT )
+        m.unpack(dst, b, a, BINARY_ANDNOT);
+    else
+        m.unpack(dst, a);
+}
+
 CV_IMPL IplConvKernel *
 cvCreateStructuringElementEx( int cols, int rows,
                               int anchorX, int anchorY,
@@ -1696,15 +2715,103 @@ bool cv::morph(InputArray _src, OutputArray _dst, InputArray _kernel, int iterat
    return false;
 }
 
-CV_IMPL bool cvMorph(const CvArr* restrict srcarr, CvArr* restrict dstarr, IplConvKernel* element, int iterations, int op) {
-    
+#else  /* host version of the padded-image algorithm above */
+
+namespace cv
+{
+
+// One iteration of cv::morph over a stripe of rows: the valid area of src shrinks by the
+// kernel margins into dst, both images keeping the padded coordinates. The kernel is
+// applied by the SIMD 2D morphology filter.
+class MorphPaddedInvoker : public ParallelLoopBody
+{
+public:
+    MorphPaddedInvoker( const Mat& _src, Mat& _dst, Rect _roi, const Ptr<BaseFilter>& _filter ) :
+        src(&_src), dst(&_dst), roi(_roi), filter(_filter)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        Ptr<BaseFilter> f = filter->clone();
+        int i, count = range.end - range.start, esz = (int)src->elemSize();
+        int y0 = roi.y + range.start - f->anchor.y, x0 = roi.x - f->anchor.x;
+        AutoBuffer<const uchar*> _rows(count + f->ksize.height - 1);
+        const uchar** rows = _rows;
+
+        for( i = 0; i < count + f->ksize.height - 1; i++ )
+            rows[i] = src->ptr(y0 + i) + x0*esz;
+
+        (*f)(rows, dst->ptr(roi.y + range.start) + roi.x*esz, (int)dst->step,
+             count, roi.width, src->channels());
+    }
+
+private:
+    const Mat* src;
+    Mat* dst;
+    Rect roi;
+    Ptr<BaseFilter> filter;
+};
+
+}
+
+bool cv::morph(InputArray _src, OutputArray _dst, InputArray _kernel, int iterations, int op) {
+
+   Mat src = _src.getMat(), kernel = _kernel.getMat();
+
+   CV_Assert( op == MORPH_ERODE || op == MORPH_DILATE );
+
+   if (kernel.data == NULL)  /* default structuring element is 3x3 matrix, all 1's */
+      kernel = getStructuringElement(MORPH_RECT, Size(3,3));
+
+   Point anchor(kernel.cols/2, kernel.rows/2);
+   int top = anchor.y, bottom = kernel.rows-1-anchor.y, left = anchor.x, right = kernel.cols-1-anchor.x;
+
+/* The image is padded with black and the morphology is computed over the whole plane, so pixels
+   outside the image may change between iterations and feed back into it, as with VLIB.  A single
+   iteration, or any number of them with an all 1's element (equivalent to one bigger rectangle),
+   is exactly a constant-0 border erode / dilate, which also uses the separable filters.  So is
+   the degenerate empty element */
+
+   int nz = countNonZero(kernel);
+   if (iterations <= 1 || nz == 0 || nz == kernel.rows*kernel.cols) {
+
+      if (op == MORPH_ERODE)
+         erode(src, _dst, kernel, anchor, iterations, BORDER_CONSTANT, Scalar::all(0));
+      else
+         dilate(src, _dst, kernel, anchor, iterations, BORDER_CONSTANT, Scalar::all(0));
+
+      return true;
+   }
+
+/* padded src and dst images, with room for the shrinking of the valid area at each iteration */
+
+   Mat buf[2];
+   copyMakeBorder(src, buf[0], top*iterations, bottom*iterations, left*iterations, right*iterations, BORDER_CONSTANT, Scalar::all(0));
+   buf[1].create(buf[0].size(), buf[0].type());
+
+   Ptr<BaseFilter> filter = getMorphologyFilter(op, src.type(), kernel, anchor);
+
+   for (int i=0; i<iterations; i++) {
+
+      Rect roi(left*(i+1), top*(i+1), buf[0].cols - (left+right)*(i+1), buf[0].rows - (top+bottom)*(i+1));
+      parallel_for_(Range(0, roi.height), MorphPaddedInvoker(buf[i & 1], buf[(i+1) & 1], roi, filter), roi.height/32.);
+   }
+
+   buf[iterations & 1](Rect(left*iterations, top*iterations, src.cols, src.rows)).copyTo(_dst);
+
+   return true;
+}
+
+#endif
+
+CV_IMPL bool cvMorph(const CvArr* srcarr, CvArr* dstarr, IplConvKernel* element, int iterations, int op) {
+
     cv::Mat src = cv::cvarrToMat(srcarr); cv::Mat dst0 = cv::cvarrToMat(dstarr), dst = dst0, kernel;
     cv::Point anchor;
     convertConvKernel( element, kernel, anchor );
-    return cv::morph(src, dst, kernel, iterations, op);   
-}    
-
-#endif
+    return cv::morph(src, dst, kernel, iterations, op);
+}
 
 
 CV_IMPL void cvErode(const CvArr* srcarr, CvArr* dstarr, IplConvKernel* element, int iterations) {
@@ -90,6 +90,20 @@ static inline Point normalizeAnchor( Point anchor, Size ksize )
 }
 
 void preprocess2DKernel( const Mat& kernel, vector<Point>& coords, vector<uchar>& coeffs );
+// DFT-based correlation with a fixed template: the template spectra and the block
+// layout are computed once by create() and reused by every apply()
+struct CrossCorrPlan
+{
+    CrossCorrPlan() : depth(0), cn(0), ctype(0), maxDepth(0), bufSize(0) {}
+    void create( const Mat& templ, int imgType, Size corrsize, int ctype );
+    void apply( const Mat& img, Mat& corr, Point anchor=Point(0,0), double delta=0,
+                int borderType=BORDER_REFLECT_101 ) const;
+
+    Mat templ, dftTempl;
+    Size corrsize, blocksize, dftsize;
+    int depth, cn, ctype, maxDepth, bufSize;
+};
+
 void crossCorr( const Mat& src, const Mat& templ, Mat& dst,
                 Size corrsize, int ctype,
                 Point anchor=Point(0,0), double delta=0,
@@ -109,6 +109,8 @@ template<typename ST, typename T> struct ColumnSum : public BaseColumnFilter
 
     void reset() { sumCount = 0; }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new ColumnSum(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         int i;
@@ -209,6 +211,8 @@ template<> struct ColumnSum<int, uchar> : public BaseColumnFilter
 
     void reset() { sumCount = 0; }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new ColumnSum(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         int i;
@@ -350,6 +354,8 @@ template<> struct ColumnSum<int, short> : public BaseColumnFilter
 
     void reset() { sumCount = 0; }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new ColumnSum(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         int i;
@@ -488,6 +494,8 @@ template<> struct ColumnSum<int, ushort> : public BaseColumnFilter
 
     void reset() { sumCount = 0; }
 
+    Ptr<BaseColumnFilter> clone() const { return Ptr<BaseColumnFilter>(new ColumnSum(*this)); }
+
     void operator()(const uchar** src, uchar* dst, int dststep, int count, int width)
     {
         int i;
@@ -877,6 +885,274 @@ void cv::GaussianBlur( InputArray _src, OutputArray _dst, Size ksize,
 }
 
 
+/****************************************************************************************\
+                                Recursive Gaussian Blur
+\****************************************************************************************/
+
+namespace cv
+{
+
+/*
+ Young & van Vliet third-order recursive approximation of the Gaussian filter:
+   w[n] = B*x[n] + a1*w[n-1] + a2*w[n-2] + a3*w[n-3]   (causal pass)
+   y[n] = B*w[n] + a1*y[n+1] + a2*y[n+2] + a3*y[n+3]   (anti-causal pass)
+ For large sigma B gets tiny and the poles approach 1, so the recursion
+ is run in double precision; in float the round-off reaches a few gray
+ levels at sigma ~100.
+*/
+struct RecursiveGaussianCoeffs
+{
+    RecursiveGaussianCoeffs( double sigma )
+    {
+        sigma = std::max(sigma, 0.5);
+        double q = sigma >= 2.5 ? 0.98711*sigma - 0.96330 :
+            3.97156 - 4.14554*std::sqrt(1 - 0.26891*sigma);
+        double q2 = q*q, q3 = q2*q;
+        double b0 = 1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+        double b1 = 2.44413*q + 2.85619*q2 + 1.26661*q3;
+        double b2 = -(1.4281*q2 + 1.26661*q3);
+        double b3 = 0.422205*q3;
+        a1 = b1/b0; a2 = b2/b0; a3 = b3/b0;
+        // unit DC gain, so a constant signal (and the replicated start values) passes unchanged
+        B = 1. - (a1 + a2 + a3);
+    }
+
+    double B, a1, a2, a3;
+};
+
+
+// Runs both passes down the columns of a CV_64F buffer in place. Rows outside
+// the buffer are assumed to repeat the first/last row, which is the steady
+// state of the filter. Columns are independent: the loop is vectorized across
+// them and the buffer is split into vertical stripes for parallel_for_.
+class RecursiveGaussianColumnInvoker : public ParallelLoopBody
+{
+public:
+    RecursiveGaussianColumnInvoker( Mat& _buf, const RecursiveGaussianCoeffs& _c, int _stripeWidth ) :
+        ParallelLoopBody(), buf(&_buf), c(_c), stripeWidth(_stripeWidth)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int width = buf->cols*buf->channels(), rows = buf->rows;
+        int x0 = range.start*stripeWidth, x1 = std::min(range.end*stripeWidth, width);
+        int y;
+
+        for( y = 1; y < rows; y++ )
+            updateRow( buf->ptr<double>(y), buf->ptr<double>(y-1),
+                       buf->ptr<double>(std::max(y-2, 0)), buf->ptr<double>(std::max(y-3, 0)), x0, x1 );
+
+        for( y = rows - 2; y >= 0; y-- )
+            updateRow( buf->ptr<double>(y), buf->ptr<double>(y+1),
+                       buf->ptr<double>(std::min(y+2, rows-1)), buf->ptr<double>(std::min(y+3, rows-1)), x0, x1 );
+    }
+
+private:
+    void updateRow( double* D, const double* W1, const double* W2, const double* W3, int x0, int x1 ) const
+    {
+        double B = c.B, a1 = c.a1, a2 = c.a2, a3 = c.a3;
+        int x = x0;
+
+        #if CV_SSE2
+        if( checkHardwareSupport(CV_CPU_SSE2) )
+        {
+            __m128d b = _mm_set1_pd(B), k1 = _mm_set1_pd(a1), k2 = _mm_set1_pd(a2), k3 = _mm_set1_pd(a3);
+            for( ; x <= x1 - 4; x += 4 )
+            {
+                __m128d s0 = _mm_mul_pd(_mm_loadu_pd(D + x), b);
+                __m128d s1 = _mm_mul_pd(_mm_loadu_pd(D + x + 2), b);
+                s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(W1 + x), k1));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(W1 + x + 2), k1));
+                s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(W2 + x), k2));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(W2 + x + 2), k2));
+                s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(W3 + x), k3));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(W3 + x + 2), k3));
+                _mm_storeu_pd(D + x, s0);
+                _mm_storeu_pd(D + x + 2, s1);
+            }
+        }
+        #endif
+
+        for( ; x < x1; x++ )
+            D[x] = D[x]*B + W1[x]*a1 + W2[x]*a2 + W3[x]*a3;
+    }
+
+    Mat* buf;
+    RecursiveGaussianCoeffs c;
+    int stripeWidth;
+};
+
+
+// Runs both passes along the rows of a CV_64F buffer in place. The recursion
+// is serial along a row, so the vector code runs two rows per register and
+// two registers at once instead of vectorizing along x.
+class RecursiveGaussianRowInvoker : public ParallelLoopBody
+{
+public:
+    enum { ROWS_PER_STRIPE = 4 };
+
+    RecursiveGaussianRowInvoker( Mat& _buf, const RecursiveGaussianCoeffs& _c ) :
+        ParallelLoopBody(), buf(&_buf), c(_c)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int y = range.start*ROWS_PER_STRIPE, y1 = std::min(range.end*ROWS_PER_STRIPE, buf->rows);
+
+        #if CV_SSE2
+        if( checkHardwareSupport(CV_CPU_SSE2) )
+            for( ; y <= y1 - 4; y += 4 )
+                updateRows4( buf->ptr<double>(y), buf->ptr<double>(y+1),
+                             buf->ptr<double>(y+2), buf->ptr<double>(y+3) );
+        #endif
+
+        for( ; y < y1; y++ )
+            updateRow( buf->ptr<double>(y) );
+    }
+
+private:
+    void updateRow( double* D ) const
+    {
+        double B = c.B, a1 = c.a1, a2 = c.a2, a3 = c.a3;
+        double w1[4], w2[4], w3[4];
+        int cn = buf->channels(), n = buf->cols*cn, i, k;
+
+        for( k = 0; k < cn; k++ )
+            w1[k] = w2[k] = w3[k] = D[k];
+        for( i = 0; i < n; i += cn )
+            for( k = 0; k < cn; k++ )
+            {
+                double w = D[i+k]*B + w1[k]*a1 + w2[k]*a2 + w3[k]*a3;
+                w3[k] = w2[k]; w2[k] = w1[k]; w1[k] = D[i+k] = w;
+            }
+
+        for( k = 0; k < cn; k++ )
+            w1[k] = w2[k] = w3[k] = D[n-cn+k];
+        for( i = n - cn; i >= 0; i -= cn )
+            for( k = 0; k < cn; k++ )
+            {
+                double w = D[i+k]*B + w1[k]*a1 + w2[k]*a2 + w3[k]*a3;
+                w3[k] = w2[k]; w2[k] = w1[k]; w1[k] = D[i+k] = w;
+            }
+    }
+
+    #if CV_SSE2
+    void updateRows4( double* D0, double* D1, double* D2, double* D3 ) const
+    {
+        __m128d b = _mm_set1_pd(c.B), k1 = _mm_set1_pd(c.a1), k2 = _mm_set1_pd(c.a2), k3 = _mm_set1_pd(c.a3);
+        __m128d p1[4], p2[4], p3[4], q1[4], q2[4], q3[4];
+        int cn = buf->channels(), n = buf->cols*cn, i, k;
+
+        for( k = 0; k < cn; k++ )
+        {
+            p1[k] = p2[k] = p3[k] = _mm_loadh_pd(_mm_load_sd(D0 + k), D1 + k);
+            q1[k] = q2[k] = q3[k] = _mm_loadh_pd(_mm_load_sd(D2 + k), D3 + k);
+        }
+        for( i = 0; i < n; i += cn )
+            for( k = 0; k < cn; k++ )
+            {
+                __m128d s0 = _mm_mul_pd(_mm_loadh_pd(_mm_load_sd(D0 + i + k), D1 + i + k), b);
+                __m128d s1 = _mm_mul_pd(_mm_loadh_pd(_mm_load_sd(D2 + i + k), D3 + i + k), b);
+                s0 = _mm_add_pd(s0, _mm_mul_pd(p1[k], k1));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(q1[k], k1));
+                s0 = _mm_add_pd(s0, _mm_mul_pd(p2[k], k2));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(q2[k], k2));
+                s0 = _mm_add_pd(s0, _mm_mul_pd(p3[k], k3));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(q3[k], k3));
+                p3[k] = p2[k]; p2[k] = p1[k]; p1[k] = s0;
+                q3[k] = q2[k]; q2[k] = q1[k]; q1[k] = s1;
+                _mm_storel_pd(D0 + i + k, s0); _mm_storeh_pd(D1 + i + k, s0);
+                _mm_storel_pd(D2 + i + k, s1); _mm_storeh_pd(D3 + i + k, s1);
+            }
+
+        for( k = 0; k < cn; k++ )
+        {
+            p1[k] = p2[k] = p3[k] = _mm_loadh_pd(_mm_load_sd(D0 + n - cn + k), D1 + n - cn + k);
+            q1[k] = q2[k] = q3[k] = _mm_loadh_pd(_mm_load_sd(D2 + n - cn + k), D3 + n - cn + k);
+        }
+        for( i = n - cn; i >= 0; i -= cn )
+            for( k = 0; k < cn; k++ )
+            {
+                __m128d s0 = _mm_mul_pd(_mm_loadh_pd(_mm_load_sd(D0 + i + k), D1 + i + k), b);
+                __m128d s1 = _mm_mul_pd(_mm_loadh_pd(_mm_load_sd(D2 + i + k), D3 + i + k), b);
+                s0 = _mm_add_pd(s0, _mm_mul_pd(p1[k], k1));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(q1[k], k1));
+                s0 = _mm_add_pd(s0, _mm_mul_pd(p2[k], k2));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(q2[k], k2));
+                s0 = _mm_add_pd(s0, _mm_mul_pd(p3[k], k3));
+                s1 = _mm_add_pd(s1, _mm_mul_pd(q3[k], k3));
+                p3[k] = p2[k]; p2[k] = p1[k]; p1[k] = s0;
+                q3[k] = q2[k]; q2[k] = q1[k]; q1[k] = s1;
+                _mm_storel_pd(D0 + i + k, s0); _mm_storeh_pd(D1 + i + k, s0);
+                _mm_storel_pd(D2 + i + k, s1); _mm_storeh_pd(D3 + i + k, s1);
+            }
+    }
+    #endif
+
+    Mat* buf;
+    RecursiveGaussianCoeffs c;
+};
+
+
+static void recursiveGaussianColumns( Mat& buf, double sigma )
+{
+    // stripes of whole cache lines, enough of them to keep all the threads busy
+    const int STRIPE_ALIGN = 8;
+    int width = buf.cols*buf.channels();
+    int nstripes = std::max(std::min(getNumThreads()*4, width/(STRIPE_ALIGN*8)), 1);
+    int stripeWidth = alignSize((width + nstripes - 1)/nstripes, STRIPE_ALIGN);
+    nstripes = (width + stripeWidth - 1)/stripeWidth;
+
+    parallel_for_( Range(0, nstripes), RecursiveGaussianColumnInvoker(buf, RecursiveGaussianCoeffs(sigma), stripeWidth) );
+}
+
+
+static void recursiveGaussianRows( Mat& buf, double sigma )
+{
+    int nstripes = (buf.rows + RecursiveGaussianRowInvoker::ROWS_PER_STRIPE - 1)/
+        RecursiveGaussianRowInvoker::ROWS_PER_STRIPE;
+    parallel_for_( Range(0, nstripes), RecursiveGaussianRowInvoker(buf, RecursiveGaussianCoeffs(sigma)) );
+}
+
+}
+
+
+void cv::recursiveGaussianBlur( InputArray _src, OutputArray _dst,
+                                double sigma1, double sigma2, int borderType )
+{
+    Mat src = _src.getMat();
+    int cn = src.channels();
+
+    CV_Assert( sigma1 > 0 && cn <= 4 );
+    if( sigma2 <= 0 )
+        sigma2 = sigma1;
+
+    // the recursive filter only pays off (and is only accurate) for large kernels
+    if( sigma1 < 2 && sigma2 < 2 )
+    {
+        GaussianBlur( src, _dst, Size(), sigma1, sigma2, borderType );
+        return;
+    }
+
+    // enough border for the start-up transient of the recursion to die out
+    int padx = cvCeil(sigma1*4), pady = cvCeil(sigma2*4);
+
+    // copyMakeBorder takes the pixels outside a non-isolated ROI from the parent matrix
+    Mat padded, buf;
+    copyMakeBorder( src, padded, pady, pady, padx, padx, borderType );
+    padded.convertTo( buf, CV_64F );
+
+    recursiveGaussianColumns( buf, sigma2 );
+    Mat inner = buf.rowRange(pady, pady + src.rows);
+    recursiveGaussianRows( inner, sigma1 );
+
+    _dst.create( src.size(), src.type() );
+    inner.colRange(padx, padx + src.cols).convertTo( _dst, src.depth() );
+}
+
+
 /****************************************************************************************\
                                       Median Filter
 \****************************************************************************************/
@@ -1436,16 +1712,18 @@ typedef MinMax32f MinMaxVec32f;
 
 #endif
 
+// processes the rows [range.start, range.end) of _dst; images of a single row or column
+// must be processed at once
 template<class Op, class VecOp>
 static void
-medianBlur_SortNet( const Mat& _src, Mat& _dst, int m )
+medianBlur_SortNet( const Mat& _src, Mat& _dst, int m, const Range& range )
 {
     typedef typename Op::value_type T;
     typedef typename Op::arg_type WT;
     typedef typename VecOp::arg_type VT;
 
     const T* src = (const T*)_src.data;
-    T* dst = (T*)_dst.data;
+    T* dst = (T*)_dst.ptr(range.start);
     int sstep = (int)(_src.step/sizeof(T));
     int dstep = (int)(_dst.step/sizeof(T));
     Size size = _dst.size();
@@ -1477,7 +1755,7 @@ medianBlur_SortNet( const Mat& _src, Mat& _dst, int m )
         }
 
         size.width *= cn;
-        for( i = 0; i < size.height; i++, dst += dstep )
+        for( i = range.start; i < range.end; i++, dst += dstep )
         {
             const T* row0 = src + std::max(i - 1, 0)*sstep;
             const T* row1 = src + i*sstep;
@@ -1549,7 +1827,7 @@ medianBlur_SortNet( const Mat& _src, Mat& _dst, int m )
         }
 
         size.width *= cn;
-        for( i = 0; i < size.height; i++, dst += dstep )
+        for( i = range.start; i < range.end; i++, dst += dstep )
         {
             const T* row[5];
             row[0] = src + std::max(i - 2, 0)*sstep;
@@ -1648,6 +1926,240 @@ medianBlur_SortNet( const Mat& _src, Mat& _dst, int m )
     }
 }
 
+
+template<class Op, class VecOp>
+class MedianBlurSortNetInvoker : public ParallelLoopBody
+{
+public:
+    MedianBlurSortNetInvoker( const Mat& _src, Mat& _dst, int _m ) :
+        ParallelLoopBody(), src(&_src), dst(&_dst), m(_m)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        medianBlur_SortNet<Op, VecOp>( *src, *dst, m, range );
+    }
+
+private:
+    const Mat* src;
+    Mat* dst;
+    int m;
+};
+
+template<class Op, class VecOp>
+static void medianBlurSortNet( const Mat& src, Mat& dst, int m )
+{
+    Range all(0, dst.rows);
+    if( dst.rows == 1 || dst.cols == 1 )
+        medianBlur_SortNet<Op, VecOp>( src, dst, m, all );
+    else
+        parallel_for_( all, MedianBlurSortNetInvoker<Op, VecOp>(src, dst, m), dst.total()/(double)(1<<16) );
+}
+
+
+typedef void (*MedianBlurFunc)( const Mat& src, Mat& dst, int ksize );
+
+// Runs a histogram-based median over vertical stripes of an image padded by ksize/2 columns
+// on each side; the columns of the result only depend on their padded neighbourhood.
+class MedianBlurColumnInvoker : public ParallelLoopBody
+{
+public:
+    MedianBlurColumnInvoker( const Mat& _src, Mat& _dst, int _ksize, MedianBlurFunc _func ) :
+        ParallelLoopBody(), src(&_src), dst(&_dst), ksize(_ksize), func(_func)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        Mat dstStripe = dst->colRange(range.start, range.end);
+        func( src->colRange(range.start, range.end + ksize - 1), dstStripe, ksize );
+    }
+
+private:
+    const Mat* src;
+    Mat* dst;
+    int ksize;
+    MedianBlurFunc func;
+};
+
+static void medianBlurColumns( const Mat& src, Mat& dst, int ksize, MedianBlurFunc func )
+{
+    // every stripe initializes its histograms from the first ksize rows
+    int nstripes = std::max(std::min(getNumThreads(), dst.cols/(ksize*4)), 1);
+    parallel_for_( Range(0, dst.cols), MedianBlurColumnInvoker(src, dst, ksize, func), nstripes );
+}
+
+
+/*
+ Huang's sliding histogram for 16-bit and floating-point images. The histogram is indexed by
+ the bin of every pixel: the 16-bit values themselves, or the ranks of the sorted distinct
+ values of a float image. The window moves along the columns of a vertical stripe in a snake
+ order, so every step adds and removes ksize pixels. The median is tracked by a pointer into
+ the histogram together with the number of pixels below it, and a coarse level of the
+ histogram lets the pointer skip over empty ranges.
+*/
+template<typename IT, typename T> class MedianBlurBinsInvoker : public ParallelLoopBody
+{
+public:
+    // 64 bins per coarse bin keeps both the walks inside a bin and the jumps over them short
+    enum { COARSE_SHIFT = 6 };
+
+    MedianBlurBinsInvoker( const Mat& _bins, Mat& _dst, int _m, const T* _values, int _nbins ) :
+        ParallelLoopBody(), bins(&_bins), dst(&_dst), m(_m), values(_values), nbins(_nbins)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int cn = dst->channels(), rows = dst->rows, n2 = m*m/2;
+        int c, k, x, y, shift = COARSE_SHIFT;
+        int binsz = 1 << shift, ncoarse = (nbins + binsz - 1) >> shift;
+
+        AutoBuffer<int> _hist(ncoarse*(binsz + 1));
+        int *fine = _hist, *coarse = fine + ncoarse*binsz;
+        size_t bstep = bins->step/sizeof(IT);
+
+        for( c = 0; c < cn; c++ )
+        {
+            memset( fine, 0, ncoarse*(binsz + 1)*sizeof(fine[0]) );
+
+            int p = 0, lt = 0, dy = 1;
+            x = range.start; y = 0;
+            for( k = 0; k < m; k++ )
+                update( bins->ptr<IT>(k) + x*cn + c, cn, fine, coarse, shift, p, lt, 1 );
+
+            for( ;; )
+            {
+                // move the median pointer down or up until it is at the median
+                while( lt > n2 )
+                {
+                    if( (p & (binsz - 1)) == 0 && lt - coarse[(p >> shift) - 1] > n2 )
+                        p -= binsz, lt -= coarse[p >> shift];
+                    else
+                        lt -= fine[--p];
+                }
+                while( lt + fine[p] <= n2 )
+                {
+                    if( (p & (binsz - 1)) == 0 && lt + coarse[p >> shift] <= n2 )
+                        lt += coarse[p >> shift], p += binsz;
+                    else
+                        lt += fine[p++];
+                }
+
+                dst->ptr<T>(y)[x*cn + c] = values[p];
+
+                const IT* row = bins->ptr<IT>(y) + x*cn + c;
+                if( dy > 0 ? y < rows - 1 : y > 0 )
+                {
+                    update( dy > 0 ? row : row + (m-1)*bstep, cn, fine, coarse, shift, p, lt, -1 );
+                    update( dy > 0 ? row + m*bstep : row - bstep, cn, fine, coarse, shift, p, lt, 1 );
+                    y += dy;
+                }
+                else if( ++x < range.end )
+                {
+                    for( k = 0; k < m; k++, row += bstep )
+                    {
+                        updateBin( row[0], fine, coarse, shift, p, lt, -1 );
+                        updateBin( row[m*cn], fine, coarse, shift, p, lt, 1 );
+                    }
+                    dy = -dy;
+                }
+                else
+                    break;
+            }
+        }
+    }
+
+private:
+    static inline void updateBin( int b, int* fine, int* coarse, int shift, int p, int& lt, int delta )
+    {
+        fine[b] += delta;
+        coarse[b >> shift] += delta;
+        lt += b < p ? delta : 0;
+    }
+
+    void update( const IT* row, int cn, int* fine, int* coarse, int shift, int p, int& lt, int delta ) const
+    {
+        for( int k = 0; k < m*cn; k += cn )
+            updateBin( row[k], fine, coarse, shift, p, lt, delta );
+    }
+
+    const Mat* bins;
+    Mat* dst;
+    int m;
+    const T* values;
+    int nbins;
+};
+
+template<typename IT, typename T>
+static void medianBlurBins( const Mat& bins, Mat& dst, int m, const T* values, int nbins )
+{
+    // every stripe fills the histogram once, then the window moves one pixel at a time
+    int nstripes = std::max(std::min(getNumThreads(), dst.cols/(m*4)), 1);
+    parallel_for_( Range(0, dst.cols), MedianBlurBinsInvoker<IT, T>(bins, dst, m, values, nbins), nstripes );
+}
+
+static void
+medianBlur_SortedBins( const Mat& src, Mat& dst, int m )
+{
+    int depth = src.depth(), r = m/2;
+    Mat bins;
+
+    if( depth == CV_16U || depth == CV_16S )
+    {
+        AutoBuffer<ushort> _values(1 << 16);
+        ushort* values = _values;
+        int bias = depth == CV_16S ? 32768 : 0;
+        for( int i = 0; i < (1 << 16); i++ )
+            values[i] = (ushort)(i - bias);
+
+        Mat src16 = src;
+        if( depth == CV_16S )
+            src.convertTo(src16, CV_16U, 1, bias);
+        copyMakeBorder( src16, bins, r, r, r, r, BORDER_REPLICATE | BORDER_ISOLATED );
+        medianBlurBins<ushort, ushort>( bins, dst, m, values, 1 << 16 );
+    }
+    else if( depth == CV_32F )
+    {
+        // order the floats by their bit patterns with the sign bit flipped into a two's
+        // complement order; one sort of (key, pixel index) pairs gives both the distinct
+        // values and the rank of every pixel
+        Mat keys = src.reshape(1), ranks(keys.size(), CV_32S);
+        int y, x, cols = keys.cols, nbins = 0;
+        vector<uint64> pairs;
+        pairs.reserve(keys.total());
+        for( y = 0; y < keys.rows; y++ )
+        {
+            const int* k = keys.ptr<int>(y);
+            for( x = 0; x < cols; x++ )
+            {
+                unsigned key = (unsigned)(k[x] ^ ((k[x] >> 31) & 0x7fffffff)) ^ 0x80000000u;
+                pairs.push_back(((uint64)key << 32) | (unsigned)(y*cols + x));
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        vector<int> sorted(pairs.size());
+        int* rank = (int*)ranks.data;
+        for( size_t i = 0; i < pairs.size(); i++ )
+        {
+            int key = (int)((unsigned)(pairs[i] >> 32) ^ 0x80000000u);
+            if( nbins == 0 || sorted[nbins-1] != key )
+                sorted[nbins++] = key;
+            rank[(unsigned)pairs[i]] = nbins - 1;
+        }
+
+        for( int i = 0; i < nbins; i++ )
+            sorted[i] ^= (sorted[i] >> 31) & 0x7fffffff;
+
+        copyMakeBorder( ranks.reshape(src.channels()), bins, r, r, r, r, BORDER_REPLICATE );
+        medianBlurBins<int, float>( bins, dst, m, (const float*)&sorted[0], nbins );
+    }
+    else
+        CV_Error(CV_StsUnsupportedFormat, "");
+}
+
 }
 
 void cv::medianBlur( InputArray _src0, OutputArray _dst, int ksize )
@@ -1684,18 +2196,23 @@ void cv::medianBlur( InputArray _src0, OutputArray _dst, int ksize )
             src0.copyTo(src);
 
         if( src.depth() == CV_8U )
-            medianBlur_SortNet<MinMax8u, MinMaxVec8u>( src, dst, ksize );
+            medianBlurSortNet<MinMax8u, MinMaxVec8u>( src, dst, ksize );
         else if( src.depth() == CV_16U )
-            medianBlur_SortNet<MinMax16u, MinMaxVec16u>( src, dst, ksize );
+            medianBlurSortNet<MinMax16u, MinMaxVec16u>( src, dst, ksize );
         else if( src.depth() == CV_16S )
-            medianBlur_SortNet<MinMax16s, MinMaxVec16s>( src, dst, ksize );
+            medianBlurSortNet<MinMax16s, MinMaxVec16s>( src, dst, ksize );
         else if( src.depth() == CV_32F )
-            medianBlur_SortNet<MinMax32f, MinMaxVec32f>( src, dst, ksize );
+            medianBlurSortNet<MinMax32f, MinMaxVec32f>( src, dst, ksize );
         else
             CV_Error(CV_StsUnsupportedFormat, "");
 
         return;
     }
+    else if( src0.depth() != CV_8U )
+    {
+        // the image is converted to padded bins before dst is written, so it may be in-place
+        medianBlur_SortedBins( src0, dst, ksize );
+    }
     else
     {
         cv::copyMakeBorder( src0, src, 0, 0, ksize/2, ksize/2, BORDER_REPLICATE );
@@ -1705,9 +2222,9 @@ void cv::medianBlur( InputArray _src0, OutputArray _dst, int ksize )
 
         double img_size_mp = (double)(src0.total())/(1 << 20);
         if( ksize <= 3 + (img_size_mp < 1 ? 12 : img_size_mp < 4 ? 6 : 2)*(MEDIAN_HAVE_SIMD && checkHardwareSupport(CV_CPU_SSE2) ? 1 : 3))
-            medianBlur_8u_Om( src, dst, ksize );
+            medianBlurColumns( src, dst, ksize, medianBlur_8u_Om );
         else
-            medianBlur_8u_O1( src, dst, ksize );
+            medianBlurColumns( src, dst, ksize, medianBlur_8u_O1 );
     }
 }
 
@@ -2273,6 +2790,328 @@ void cv::bilateralFilter( InputArray _src, OutputArray _dst, int d,
 }
 
 
+/****************************************************************************************\
+                                  Bilateral Grid Filtering
+\****************************************************************************************/
+
+namespace cv
+{
+
+/*
+ The bilateral grid (Paris & Durand; Chen, Paris & Durand): the pixels of a single-channel
+ image are splatted into a coarse 3D grid over (x, y, intensity). Every cell holds the sum
+ of the pixel values and the number of pixels. The grid is blurred with a Gaussian along
+ the three axes and the result is read back by trilinear interpolation at every pixel.
+ Space and range are sampled at fractions of sigmaSpace and sigmaColor, which controls the
+ accuracy; the cost does not depend on the size of the spatial kernel. One range axis can
+ not tell apart colors with the same channel sum, so color images go to bilateralFilter.
+*/
+struct BilateralGrid
+{
+    BilateralGrid( int _width, int _height, int _depth ) :
+        width(_width), height(_height), depth(_depth),
+        zstep(2), xstep(_depth*2), ystep((size_t)_width*_depth*2),
+        buf(ystep*_height*2)
+    {
+        memset( (float*)buf, 0, ystep*height*2*sizeof(float) );
+    }
+
+    float* plane( int k ) { return (float*)buf + ystep*height*k; }
+
+    int width, height, depth;
+    int zstep, xstep;
+    size_t ystep;
+    AutoBuffer<float> buf;
+};
+
+template<typename T> class BilateralGridSplatInvoker : public ParallelLoopBody
+{
+public:
+    BilateralGridSplatInvoker( const Mat& _src, BilateralGrid& _grid, float _sscale, float _rscale,
+                               float _rmin, int _margin ) :
+        ParallelLoopBody(), src(&_src), grid(&_grid), sscale(_sscale), rscale(_rscale),
+        rmin(_rmin), margin(_margin)
+    {
+    }
+
+    // every stripe owns a range of grid rows and splats the rows of pixels that fall into them
+    void operator()( const Range& range ) const
+    {
+        float* data = grid->plane(0);
+
+        for( int y = 0; y < src->rows; y++ )
+        {
+            int gy = cvRound(y*sscale) + margin;
+            if( gy < range.start || gy >= range.end )
+                continue;
+
+            const T* sptr = src->ptr<T>(y);
+            float* grow = data + grid->ystep*gy;
+            for( int x = 0; x < src->cols; x++ )
+            {
+                float v = (float)sptr[x];
+                if( !(v >= -FLT_MAX && v <= FLT_MAX) )
+                    continue;
+
+                float* cell = grow + grid->xstep*(cvRound(x*sscale) + margin) +
+                    grid->zstep*(cvRound((v - rmin)*rscale) + margin);
+                cell[0] += v;
+                cell[1] += 1.f;
+            }
+        }
+    }
+
+private:
+    const Mat* src;
+    BilateralGrid* grid;
+    float sscale, rscale, rmin;
+    int margin;
+};
+
+// Gaussian blur of the grid along one axis (0 - range, 1 - x, 2 - y) from plane 'from' to
+// the other one; the cells outside of the grid are empty. Along every axis a line of cells is
+// a contiguous array of blocks, so the blur is a sum of shifted copies of the line.
+class BilateralGridBlurInvoker : public ParallelLoopBody
+{
+public:
+    BilateralGridBlurInvoker( BilateralGrid& _grid, int _axis, int _from, const float* _kernel, int _radius ) :
+        ParallelLoopBody(), grid(&_grid), axis(_axis), from(_from), kernel(_kernel), radius(_radius)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        const float* src = grid->plane(from);
+        float* dst = grid->plane(1 - from);
+
+        if( axis == 2 )
+        {
+            blurLine( src, dst, grid->height, grid->ystep, range.start, range.end );
+            return;
+        }
+
+        // the range blur goes first, while the range margins of every cell column are still
+        // empty and wider than the kernel, so it may run over a whole row of columns at once
+        for( int y = range.start; y < range.end; y++ )
+        {
+            size_t ofs = grid->ystep*y;
+            if( axis == 1 )
+                blurLine( src + ofs, dst + ofs, grid->width, grid->xstep, 0, grid->width );
+            else
+                blurLine( src + ofs, dst + ofs, grid->width*grid->depth, grid->zstep, 0, grid->width*grid->depth );
+        }
+    }
+
+private:
+    // dst[i] = sum_k kernel[k]*src[i + (k - radius)*blk] for the blocks [pos0, pos1) of a line of len blocks
+    void blurLine( const float* src, float* dst, int len, size_t blk, int pos0, int pos1 ) const
+    {
+        ptrdiff_t i0 = pos0*blk, i1 = pos1*blk, n = len*blk;
+        memset( dst + i0, 0, (i1 - i0)*sizeof(dst[0]) );
+
+        for( int k = 0; k <= radius*2; k++ )
+        {
+            ptrdiff_t shift = (k - radius)*(ptrdiff_t)blk;
+            ptrdiff_t a = std::max(i0, -shift), b = std::min(i1, n - shift);
+            float w = kernel[k];
+            const float* sptr = src + shift;
+            for( ptrdiff_t i = a; i < b; i++ )
+                dst[i] += w*sptr[i];
+        }
+    }
+
+    BilateralGrid* grid;
+    int axis, from;
+    const float* kernel;
+    int radius;
+};
+
+template<typename T> class BilateralGridSliceInvoker : public ParallelLoopBody
+{
+public:
+    BilateralGridSliceInvoker( const Mat& _src, Mat& _dst, BilateralGrid& _grid, int _from, int _pad,
+                               float _sscale, float _rscale, float _rmin, int _margin ) :
+        ParallelLoopBody(), src(&_src), dst(&_dst), grid(&_grid), from(_from), pad(_pad),
+        sscale(_sscale), rscale(_rscale), rmin(_rmin), margin(_margin)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int x, cols = dst->cols;
+        size_t xstep = grid->xstep, ystep = grid->ystep;
+
+        // the cell offsets and interpolation weights along x are the same in every row
+        AutoBuffer<int> _xofs(cols);
+        AutoBuffer<float> _xw(cols);
+        int* xofs = _xofs;
+        float* xw = _xw;
+        for( x = 0; x < cols; x++ )
+        {
+            float fx = (x + pad)*sscale + margin;
+            int ix = cvFloor(fx);
+            xofs[x] = ix*grid->xstep;
+            xw[x] = fx - ix;
+        }
+
+        for( int y = range.start; y < range.end; y++ )
+        {
+            const T* sptr = src->ptr<T>(y + pad) + pad;
+            T* dptr = dst->ptr<T>(y);
+            float fy = (y + pad)*sscale + margin;
+            int iy = cvFloor(fy);
+            float wy = fy - iy;
+            const float* row = grid->plane(from) + ystep*iy;
+
+            for( x = 0; x < cols; x++ )
+            {
+                float v = (float)sptr[x];
+                if( !(v >= -FLT_MAX && v <= FLT_MAX) )
+                {
+                    dptr[x] = sptr[x];
+                    continue;
+                }
+
+                float fz = (v - rmin)*rscale + margin;
+                int iz = cvFloor(fz);
+                float wz = fz - iz, wx = xw[x];
+                const float* p00 = row + xofs[x] + iz*grid->zstep;
+                const float* p01 = p00 + xstep;
+                const float* p10 = p00 + ystep;
+                const float* p11 = p10 + xstep;
+                float acc[2];
+
+                // bilinear in the two planes of range, then linear between them
+                for( int c = 0; c < 2; c++ )
+                {
+                    float a = p00[c] + (p01[c] - p00[c])*wx, b = p10[c] + (p11[c] - p10[c])*wx;
+                    float a1 = p00[c+2] + (p01[c+2] - p00[c+2])*wx;
+                    float b1 = p10[c+2] + (p11[c+2] - p10[c+2])*wx;
+                    a += (b - a)*wy; a1 += (b1 - a1)*wy;
+                    acc[c] = a + (a1 - a)*wz;
+                }
+
+                float scale = 1.f/acc[1];
+                dptr[x] = saturate_cast<T>(acc[0]*scale);
+            }
+        }
+    }
+
+private:
+    const Mat* src;
+    Mat* dst;
+    BilateralGrid* grid;
+    int from, pad;
+    float sscale, rscale, rmin;
+    int margin;
+};
+
+static void bilateralGridKernel( double sigma, vector<float>& kernel, int& radius )
+{
+    radius = std::max(cvCeil(sigma*2), 1);
+    kernel.resize(radius*2 + 1);
+    double sum = 0;
+    for( int i = -radius; i <= radius; i++ )
+        sum += kernel[i + radius] = (float)std::exp(-0.5*i*i/(sigma*sigma));
+    for( int i = 0; i <= radius*2; i++ )
+        kernel[i] = (float)(kernel[i]/sum);
+}
+
+}
+
+void cv::bilateralGridFilter( InputArray _src, OutputArray _dst, int d,
+                              double sigmaColor, double sigmaSpace, int borderType,
+                              double spaceSampling, double colorSampling )
+{
+    Mat src = _src.getMat();
+    int depth = src.depth();
+
+    CV_Assert( (depth == CV_8U || depth == CV_32F) && spaceSampling > 0 && colorSampling > 0 );
+
+    if( src.channels() != 1 )
+    {
+        bilateralFilter( src, _dst, d, sigmaColor, sigmaSpace, borderType );
+        return;
+    }
+
+    if( sigmaColor <= 0 )
+        sigmaColor = 1;
+    if( sigmaSpace <= 0 )
+        sigmaSpace = 1;
+
+    int radius = d <= 0 ? cvRound(sigmaSpace*1.5) : d/2;
+    radius = MAX(radius, 1);
+
+    Mat temp;
+    copyMakeBorder( src, temp, radius, radius, radius, radius, borderType );
+
+    // the range of the finite values; NaNs and infinities are passed through as they are
+    double rmin = 0, rmax = 255;
+    if( depth == CV_32F )
+    {
+        float vmin = FLT_MAX, vmax = -FLT_MAX;
+        for( int y = 0; y < temp.rows; y++ )
+        {
+            const float* ptr = temp.ptr<float>(y);
+            for( int x = 0; x < temp.cols; x++ )
+                if( ptr[x] >= -FLT_MAX && ptr[x] <= FLT_MAX )
+                    vmin = std::min(vmin, ptr[x]), vmax = std::max(vmax, ptr[x]);
+        }
+        if( vmin > vmax )
+        {
+            src.copyTo(_dst);
+            return;
+        }
+        rmin = vmin; rmax = vmax;
+    }
+
+    // the grid steps in pixels and in range units; a range step below 1/1024 of the range
+    // would only make the grid larger
+    double sstep = std::max(sigmaSpace*spaceSampling, 1.), rstep = std::max(sigmaColor*colorSampling, (rmax - rmin)/1024);
+    if( rstep <= 0 )
+        rstep = 1;
+
+    vector<float> skernel, rkernel;
+    int sradius, rradius;
+    bilateralGridKernel( sigmaSpace/sstep, skernel, sradius );
+    bilateralGridKernel( sigmaColor/rstep, rkernel, rradius );
+
+    // the blur runs over the margins too, and slicing reads one cell past the last one
+    int margin = std::max(sradius, rradius) + 1;
+    int gwidth = cvRound((temp.cols - 1)/sstep) + margin*2 + 1;
+    int gheight = cvRound((temp.rows - 1)/sstep) + margin*2 + 1;
+    int gdepth = cvRound((rmax - rmin)/rstep) + margin*2 + 1;
+
+    // with small sigmas the grid gets more cells than the image has pixels and is
+    // both larger and slower than the direct filter
+    if( (double)gwidth*gheight*gdepth > (double)src.total() )
+    {
+        bilateralFilter( src, _dst, d, sigmaColor, sigmaSpace, borderType );
+        return;
+    }
+
+    BilateralGrid grid( gwidth, gheight, gdepth );
+    float sscale = (float)(1./sstep), rscale = (float)(1./rstep);
+
+    if( depth == CV_8U )
+        parallel_for_( Range(0, grid.height), BilateralGridSplatInvoker<uchar>(temp, grid, sscale, rscale, (float)rmin, margin) );
+    else
+        parallel_for_( Range(0, grid.height), BilateralGridSplatInvoker<float>(temp, grid, sscale, rscale, (float)rmin, margin) );
+
+    parallel_for_( Range(0, grid.height), BilateralGridBlurInvoker(grid, 0, 0, &rkernel[0], rradius) );
+    parallel_for_( Range(0, grid.height), BilateralGridBlurInvoker(grid, 1, 1, &skernel[0], sradius) );
+    parallel_for_( Range(0, grid.height), BilateralGridBlurInvoker(grid, 2, 0, &skernel[0], sradius) );
+
+    _dst.create( src.size(), src.type() );
+    Mat dst = _dst.getMat();
+    if( depth == CV_8U )
+        parallel_for_( Range(0, dst.rows), BilateralGridSliceInvoker<uchar>(temp, dst, grid, 1, radius, sscale, rscale, (float)rmin, margin),
+                       dst.total()/(double)(1<<16) );
+    else
+        parallel_for_( Range(0, dst.rows), BilateralGridSliceInvoker<float>(temp, dst, grid, 1, radius, sscale, rscale, (float)rmin, margin),
+                       dst.total()/(double)(1<<16) );
+}
+
 /****************************************************************************************\
                                   Adaptive Bilateral Filtering
 \****************************************************************************************/
@@ -225,6 +225,312 @@ typedef void (*IntegralFunc)(const uchar* src, size_t srcstep, uchar* sum, size_
                              uchar* sqsum, size_t sqsumstep, uchar* tilted, size_t tstep,
                              Size size, int cn );
 
+/*
+   Sums and squared sums without the tilted image are built in two steps: the running
+   sums of each source row are stored into the corresponding output row, then every
+   output row is accumulated into the one below it. These are exactly the additions done
+   by integral_, so the result does not depend on the number of threads, floating-point
+   sums included. The row step is parallel over rows and the column step over column
+   blocks; with one thread both steps are fused row by row. For single-channel 8-bit
+   images the running sums are computed in SSE registers and the squares are summed
+   in 32 bits as long as a whole row of them cannot overflow.
+*/
+
+template<typename T, typename ST, typename QT> static void
+integralRowSums( const T* src, ST* sum, QT* sqsum, int width, int cn, bool )
+{
+    for( int k = 0; k < cn; k++ )
+    {
+        ST s = sum[k] = 0;
+        if( sqsum )
+        {
+            QT sq = sqsum[k] = 0;
+            for( int x = k; x < width; x += cn )
+            {
+                T it = src[x];
+                s += it;
+                sq += (QT)it*it;
+                sum[x + cn] = s;
+                sqsum[x + cn] = sq;
+            }
+        }
+        else
+        {
+            for( int x = k; x < width; x += cn )
+            {
+                s += src[x];
+                sum[x + cn] = s;
+            }
+        }
+    }
+}
+
+static void integralRowSums( const uchar* src, int* sum, double* sqsum, int width, int cn, bool useSIMD )
+{
+#if CV_SSE2
+    if( useSIMD && cn == 1 && (!sqsum || width <= INT_MAX/(255*255)) )
+    {
+        __m128i z = _mm_setzero_si128(), s = z, sq = z;
+        int x = 0, si, sqi;
+
+        *sum++ = 0;
+        if( sqsum )
+            *sqsum++ = 0;
+
+        for( ; x <= width - 8; x += 8 )
+        {
+            __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + x)), z);
+            __m128i p = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+            p = _mm_add_epi16(p, _mm_slli_si128(p, 4));
+            p = _mm_add_epi16(p, _mm_slli_si128(p, 8));
+            __m128i p0 = _mm_add_epi32(_mm_unpacklo_epi16(p, z), s);
+            __m128i p1 = _mm_add_epi32(_mm_unpackhi_epi16(p, z), s);
+            s = _mm_shuffle_epi32(p1, _MM_SHUFFLE(3,3,3,3));
+            _mm_storeu_si128((__m128i*)(sum + x), p0);
+            _mm_storeu_si128((__m128i*)(sum + x + 4), p1);
+
+            if( sqsum )
+            {
+                v = _mm_mullo_epi16(v, v);
+                __m128i q0 = _mm_unpacklo_epi16(v, z), q1 = _mm_unpackhi_epi16(v, z);
+                q0 = _mm_add_epi32(q0, _mm_slli_si128(q0, 4));
+                q1 = _mm_add_epi32(q1, _mm_slli_si128(q1, 4));
+                q0 = _mm_add_epi32(q0, _mm_slli_si128(q0, 8));
+                q1 = _mm_add_epi32(q1, _mm_slli_si128(q1, 8));
+                q0 = _mm_add_epi32(q0, sq);
+                q1 = _mm_add_epi32(q1, _mm_shuffle_epi32(q0, _MM_SHUFFLE(3,3,3,3)));
+                sq = _mm_shuffle_epi32(q1, _MM_SHUFFLE(3,3,3,3));
+                _mm_storeu_pd(sqsum + x, _mm_cvtepi32_pd(q0));
+                _mm_storeu_pd(sqsum + x + 2, _mm_cvtepi32_pd(_mm_unpackhi_epi64(q0, q0)));
+                _mm_storeu_pd(sqsum + x + 4, _mm_cvtepi32_pd(q1));
+                _mm_storeu_pd(sqsum + x + 6, _mm_cvtepi32_pd(_mm_unpackhi_epi64(q1, q1)));
+            }
+        }
+
+        si = _mm_cvtsi128_si32(s);
+        sqi = _mm_cvtsi128_si32(sq);
+        for( ; x < width; x++ )
+        {
+            int it = src[x];
+            sum[x] = si += it;
+            if( sqsum )
+                sqsum[x] = sqi += it*it;
+        }
+        return;
+    }
+#endif
+    integralRowSums<uchar, int, double>( src, sum, sqsum, width, cn, false );
+}
+
+template<typename ST> static void
+integralAddRow( const ST* above, ST* sum, int n, bool )
+{
+    for( int x = 0; x < n; x++ )
+        sum[x] = above[x] + sum[x];
+}
+
+static void integralAddRow( const int* above, int* sum, int n, bool useSIMD )
+{
+    int x = 0;
+#if CV_SSE2
+    if( useSIMD )
+        for( ; x <= n - 8; x += 8 )
+        {
+            __m128i s0 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(above + x)),
+                                       _mm_loadu_si128((const __m128i*)(sum + x)));
+            __m128i s1 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(above + x + 4)),
+                                       _mm_loadu_si128((const __m128i*)(sum + x + 4)));
+            _mm_storeu_si128((__m128i*)(sum + x), s0);
+            _mm_storeu_si128((__m128i*)(sum + x + 4), s1);
+        }
+#endif
+    for( ; x < n; x++ )
+        sum[x] = above[x] + sum[x];
+}
+
+static void integralAddRow( const float* above, float* sum, int n, bool useSIMD )
+{
+    int x = 0;
+#if CV_SSE2
+    if( useSIMD )
+        for( ; x <= n - 8; x += 8 )
+        {
+            __m128 s0 = _mm_add_ps(_mm_loadu_ps(above + x), _mm_loadu_ps(sum + x));
+            __m128 s1 = _mm_add_ps(_mm_loadu_ps(above + x + 4), _mm_loadu_ps(sum + x + 4));
+            _mm_storeu_ps(sum + x, s0);
+            _mm_storeu_ps(sum + x + 4, s1);
+        }
+#endif
+    for( ; x < n; x++ )
+        sum[x] = above[x] + sum[x];
+}
+
+static void integralAddRow( const double* above, double* sum, int n, bool useSIMD )
+{
+    int x = 0;
+#if CV_SSE2
+    if( useSIMD )
+        for( ; x <= n - 4; x += 4 )
+        {
+            __m128d s0 = _mm_add_pd(_mm_loadu_pd(above + x), _mm_loadu_pd(sum + x));
+            __m128d s1 = _mm_add_pd(_mm_loadu_pd(above + x + 2), _mm_loadu_pd(sum + x + 2));
+            _mm_storeu_pd(sum + x, s0);
+            _mm_storeu_pd(sum + x + 2, s1);
+        }
+#endif
+    for( ; x < n; x++ )
+        sum[x] = above[x] + sum[x];
+}
+
+template<typename T, typename ST, typename QT>
+class IntegralRowInvoker : public ParallelLoopBody
+{
+public:
+    IntegralRowInvoker( const Mat& _src, Mat& _sum, Mat& _sqsum, bool _useSIMD )
+        : src(&_src), sum(&_sum), sqsum(&_sqsum), useSIMD(_useSIMD) {}
+
+    void operator()( const Range& range ) const
+    {
+        int cn = src->channels(), width = src->cols*cn;
+
+        for( int y = range.start; y < range.end; y++ )
+            integralRowSums( (const T*)src->ptr(y), (ST*)sum->ptr(y+1),
+                             sqsum->data ? (QT*)sqsum->ptr(y+1) : (QT*)0, width, cn, useSIMD );
+    }
+
+private:
+    const Mat* src;
+    Mat* sum;
+    Mat* sqsum;
+    bool useSIMD;
+};
+
+template<typename ST>
+class IntegralColumnInvoker : public ParallelLoopBody
+{
+public:
+    enum { BLOCK_SIZE = 64 };
+
+    IntegralColumnInvoker( Mat& _sum, bool _useSIMD ) : sum(&_sum), useSIMD(_useSIMD) {}
+
+    void operator()( const Range& range ) const
+    {
+        int n = sum->cols*sum->channels();
+        int x0 = range.start*BLOCK_SIZE, x1 = std::min(range.end*BLOCK_SIZE, n);
+
+        for( int y = 1; y < sum->rows; y++ )
+            integralAddRow( (const ST*)sum->ptr(y-1) + x0, (ST*)sum->ptr(y) + x0, x1 - x0, useSIMD );
+    }
+
+private:
+    Mat* sum;
+    bool useSIMD;
+};
+
+template<typename T, typename ST, typename QT> static void
+integralSums_( const Mat& src, Mat& sum, Mat& sqsum )
+{
+    int cn = src.channels(), width = src.cols*cn, n = width + cn;
+    int nthreads = getNumThreads();
+    bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+
+    memset( sum.data, 0, n*sizeof(ST) );
+    if( sqsum.data )
+        memset( sqsum.data, 0, n*sizeof(QT) );
+
+    if( nthreads > 1 && (double)width*src.rows >= (1 << 16) )
+    {
+        int nblocks = (n + IntegralColumnInvoker<ST>::BLOCK_SIZE - 1)/IntegralColumnInvoker<ST>::BLOCK_SIZE;
+        parallel_for_( Range(0, src.rows), IntegralRowInvoker<T, ST, QT>(src, sum, sqsum, useSIMD),
+                       std::min(src.rows, nthreads*2) );
+        parallel_for_( Range(0, nblocks), IntegralColumnInvoker<ST>(sum, useSIMD),
+                       std::min(nblocks, nthreads*2) );
+        if( sqsum.data )
+            parallel_for_( Range(0, nblocks), IntegralColumnInvoker<QT>(sqsum, useSIMD),
+                           std::min(nblocks, nthreads*2) );
+        return;
+    }
+
+    for( int y = 0; y < src.rows; y++ )
+    {
+        ST* srow = (ST*)sum.ptr(y+1);
+        QT* sqrow = sqsum.data ? (QT*)sqsum.ptr(y+1) : 0;
+
+        integralRowSums( (const T*)src.ptr(y), srow, sqrow, width, cn, useSIMD );
+        integralAddRow( (const ST*)sum.ptr(y), srow, n, useSIMD );
+        if( sqrow )
+            integralAddRow( (const QT*)sqsum.ptr(y), sqrow, n, useSIMD );
+    }
+}
+
+/*
+   Tilted sums of a single-channel 8-bit image. Every output row depends only on the two
+   rows above it: T(x,y) = T(x-1,y-1) + T(x+1,y-1) - T(x,y-2) + I(x-1,y-1) + I(x-1,y-2),
+   with T(0,y) = T(1,y-1) and T(w,y) = T(w-1,y-1) + I(w-1,y-1) + I(w-1,y-2) at the borders,
+   so the row is computed with plain vector arithmetic instead of a running sum.
+*/
+static void integralTilted_8u32s( const Mat& src, Mat& tilted, bool useSIMD )
+{
+    int width = src.cols, height = src.rows;
+    AutoBuffer<int> _zrow(width + 1);
+    AutoBuffer<uchar> _zsrc(width);
+    int* zrow = _zrow;
+    uchar* zsrc = _zsrc;
+
+    memset( zrow, 0, (width + 1)*sizeof(zrow[0]) );
+    memset( zsrc, 0, width*sizeof(zsrc[0]) );
+    memset( tilted.data, 0, (width + 1)*sizeof(int) );
+
+    for( int y = 1; y <= height; y++ )
+    {
+        int* t = (int*)tilted.ptr(y);
+        const int* t1 = (const int*)tilted.ptr(y-1);
+        const int* t2 = y > 1 ? (const int*)tilted.ptr(y-2) : zrow;
+        const uchar* s1 = src.ptr(y-1);
+        const uchar* s2 = y > 1 ? src.ptr(y-2) : zsrc;
+        int x = 1;
+
+        t[0] = t1[1];
+
+#if CV_SSE2
+        if( useSIMD )
+        {
+            __m128i z = _mm_setzero_si128();
+            for( ; x <= width - 8; x += 8 )
+            {
+                __m128i v = _mm_add_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s1 + x - 1)), z),
+                                          _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s2 + x - 1)), z));
+                __m128i a0 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(t1 + x - 1)),
+                                           _mm_loadu_si128((const __m128i*)(t1 + x + 1)));
+                __m128i a1 = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(t1 + x + 3)),
+                                           _mm_loadu_si128((const __m128i*)(t1 + x + 5)));
+                a0 = _mm_sub_epi32(a0, _mm_loadu_si128((const __m128i*)(t2 + x)));
+                a1 = _mm_sub_epi32(a1, _mm_loadu_si128((const __m128i*)(t2 + x + 4)));
+                _mm_storeu_si128((__m128i*)(t + x), _mm_add_epi32(a0, _mm_unpacklo_epi16(v, z)));
+                _mm_storeu_si128((__m128i*)(t + x + 4), _mm_add_epi32(a1, _mm_unpackhi_epi16(v, z)));
+            }
+        }
+#endif
+        for( ; x < width; x++ )
+            t[x] = t1[x-1] + t1[x+1] - t2[x] + s1[x-1] + s2[x-1];
+
+        t[width] = t1[width-1] + s1[width-1] + s2[width-1];
+    }
+}
+
+#define DEF_INTEGRAL_SUMS_FUNC(suffix, T, ST, QT) \
+static void integralSums_##suffix( const Mat& src, Mat& sum, Mat& sqsum ) \
+{ integralSums_<T, ST, QT>(src, sum, sqsum); }
+
+DEF_INTEGRAL_SUMS_FUNC(8u32s, uchar, int, double)
+DEF_INTEGRAL_SUMS_FUNC(8u32f, uchar, float, double)
+DEF_INTEGRAL_SUMS_FUNC(8u64f, uchar, double, double)
+DEF_INTEGRAL_SUMS_FUNC(32f, float, float, double)
+DEF_INTEGRAL_SUMS_FUNC(32f64f, float, double, double)
+DEF_INTEGRAL_SUMS_FUNC(64f, double, double, double)
+
+typedef void (*IntegralSumsFunc)( const Mat& src, Mat& sum, Mat& sqsum );
+
 }
 
 
@@ -299,6 +605,31 @@ void cv::integral( InputArray _src, OutputArray _sum, OutputArray _sqsum, Output
         sqsum = _sqsum.getMat();
     }
 
+    if( !tilted.data || (depth == CV_8U && sdepth == CV_32S && cn == 1) )
+    {
+        IntegralSumsFunc sfunc = 0;
+
+        if( depth == CV_8U && sdepth == CV_32S )
+            sfunc = integralSums_8u32s;
+        else if( depth == CV_8U && sdepth == CV_32F )
+            sfunc = integralSums_8u32f;
+        else if( depth == CV_8U && sdepth == CV_64F )
+            sfunc = integralSums_8u64f;
+        else if( depth == CV_32F && sdepth == CV_32F )
+            sfunc = integralSums_32f;
+        else if( depth == CV_32F && sdepth == CV_64F )
+            sfunc = integralSums_32f64f;
+        else if( depth == CV_64F && sdepth == CV_64F )
+            sfunc = integralSums_64f;
+        else
+            CV_Error( CV_StsUnsupportedFormat, "" );
+
+        sfunc( src, sum, sqsum );
+        if( tilted.data )
+            integralTilted_8u32s( src, tilted, checkHardwareSupport(CV_CPU_SSE2) );
+        return;
+    }
+
     IntegralFunc func = 0;
 
     if( depth == CV_8U && sdepth == CV_32S )
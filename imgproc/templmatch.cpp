@@ -44,20 +44,22 @@
 namespace cv
 {
 
-void crossCorr( const Mat& img, const Mat& _templ, Mat& corr,
-                Size corrsize, int ctype,
-                Point anchor, double delta, int borderType )
+void CrossCorrPlan::create( const Mat& _templ, int imgType, Size _corrsize, int _ctype )
 {
     const double blockScale = 4.5;
     const int minBlockSize = 256;
     std::vector<uchar> buf;
 
-    Mat templ = _templ;
-    int depth = img.depth(), cn = img.channels();
+    templ = _templ;
+    depth = CV_MAT_DEPTH(imgType);
+    cn = CV_MAT_CN(imgType);
+    ctype = _ctype;
+    corrsize = _corrsize;
+
     int tdepth = templ.depth(), tcn = templ.channels();
     int cdepth = CV_MAT_DEPTH(ctype), ccn = CV_MAT_CN(ctype);
 
-    CV_Assert( img.dims <= 2 && templ.dims <= 2 && corr.dims <= 2 );
+    CV_Assert( templ.dims <= 2 );
 
     if( depth != tdepth && tdepth != std::max(CV_32F, depth) )
     {
@@ -66,22 +68,15 @@ void crossCorr( const Mat& img, const Mat& _templ, Mat& corr,
     }
 
     CV_Assert( depth == tdepth || tdepth == CV_32F);
-    CV_Assert( corrsize.height <= img.rows + templ.rows - 1 &&
-               corrsize.width <= img.cols + templ.cols - 1 );
 
-    CV_Assert( ccn == 1 || delta == 0 );
-
-    corr.create(corrsize, ctype);
-
-    int maxDepth = depth > CV_8S ? CV_64F : std::max(std::max(CV_32F, tdepth), cdepth);
-    Size blocksize, dftsize;
+    maxDepth = depth > CV_8S ? CV_64F : std::max(std::max(CV_32F, tdepth), cdepth);
 
     blocksize.width = cvRound(templ.cols*blockScale);
     blocksize.width = std::max( blocksize.width, minBlockSize - templ.cols + 1 );
-    blocksize.width = std::min( blocksize.width, corr.cols );
+    blocksize.width = std::min( blocksize.width, corrsize.width );
     blocksize.height = cvRound(templ.rows*blockScale);
     blocksize.height = std::max( blocksize.height, minBlockSize - templ.rows + 1 );
-    blocksize.height = std::min( blocksize.height, corr.rows );
+    blocksize.height = std::min( blocksize.height, corrsize.height );
 
     dftsize.width = std::max(getOptimalDFTSize(blocksize.width + templ.cols - 1), 2);
     dftsize.height = getOptimalDFTSize(blocksize.height + templ.rows - 1);
@@ -90,28 +85,25 @@ void crossCorr( const Mat& img, const Mat& _templ, Mat& corr,
 
     // recompute block size
     blocksize.width = dftsize.width - templ.cols + 1;
-    blocksize.width = MIN( blocksize.width, corr.cols );
+    blocksize.width = MIN( blocksize.width, corrsize.width );
     blocksize.height = dftsize.height - templ.rows + 1;
-    blocksize.height = MIN( blocksize.height, corr.rows );
+    blocksize.height = MIN( blocksize.height, corrsize.height );
 
-    Mat dftTempl( dftsize.height*tcn, dftsize.width, maxDepth );
-    Mat dftImg( dftsize, maxDepth );
-
-    int i, k, bufSize = 0;
-    if( tcn > 1 && tdepth != maxDepth )
-        bufSize = templ.cols*templ.rows*CV_ELEM_SIZE(tdepth);
+    dftTempl.create( dftsize.height*tcn, dftsize.width, maxDepth );
 
+    // the scratch space needed by one image tile; every tile worker has its own
+    bufSize = 0;
     if( cn > 1 && depth != maxDepth )
-        bufSize = std::max( bufSize, (blocksize.width + templ.cols - 1)*
-            (blocksize.height + templ.rows - 1)*CV_ELEM_SIZE(depth));
+        bufSize = (blocksize.width + templ.cols - 1)*(blocksize.height + templ.rows - 1)*CV_ELEM_SIZE(depth);
 
     if( (ccn > 1 || cn > 1) && cdepth != maxDepth )
         bufSize = std::max( bufSize, blocksize.width*blocksize.height*CV_ELEM_SIZE(cdepth));
 
-    buf.resize(bufSize);
+    if( tcn > 1 && tdepth != maxDepth )
+        buf.resize(templ.cols*templ.rows*CV_ELEM_SIZE(tdepth));
 
     // compute DFT of each template plane
-    for( k = 0; k < tcn; k++ )
+    for( int k = 0; k < tcn; k++ )
     {
         int yofs = k*dftsize.height;
         Mat src = templ;
@@ -135,6 +127,123 @@ void crossCorr( const Mat& img, const Mat& _templ, Mat& corr,
         }
         dft(dst, dst, 0, templ.rows);
     }
+}
+
+
+class CrossCorrInvoker : public ParallelLoopBody
+{
+public:
+    CrossCorrInvoker( const CrossCorrPlan& _plan, const Mat& _img0, Point _roiofs, Mat& _corr,
+                      Point _anchor, double _delta, int _borderType )
+        : plan(&_plan), img0(&_img0), roiofs(_roiofs), corr(&_corr),
+          anchor(_anchor), delta(_delta), borderType(_borderType) {}
+
+    void operator()( const Range& range ) const
+    {
+        const Mat& templ = plan->templ;
+        Size blocksize = plan->blocksize, dftsize = plan->dftsize;
+        int depth = plan->depth, cn = plan->cn, tcn = templ.channels();
+        int cdepth = CV_MAT_DEPTH(plan->ctype), ccn = CV_MAT_CN(plan->ctype);
+        int maxDepth = plan->maxDepth;
+        int tileCountX = (corr->cols + blocksize.width - 1)/blocksize.width;
+
+        Mat dftImg( dftsize, maxDepth );
+        std::vector<uchar> buf(std::max(plan->bufSize, 1));
+
+        for( int i = range.start; i < range.end; i++ )
+        {
+            int x = (i%tileCountX)*blocksize.width;
+            int y = (i/tileCountX)*blocksize.height;
+
+            Size bsz(std::min(blocksize.width, corr->cols - x),
+                     std::min(blocksize.height, corr->rows - y));
+            Size dsz(bsz.width + templ.cols - 1, bsz.height + templ.rows - 1);
+            int x0 = x - anchor.x + roiofs.x, y0 = y - anchor.y + roiofs.y;
+            int x1 = std::max(0, x0), y1 = std::max(0, y0);
+            int x2 = std::min(img0->cols, x0 + dsz.width);
+            int y2 = std::min(img0->rows, y0 + dsz.height);
+            Mat src0(*img0, Range(y1, y2), Range(x1, x2));
+            Mat dst(dftImg, Rect(0, 0, dsz.width, dsz.height));
+            Mat dst1(dftImg, Rect(x1-x0, y1-y0, x2-x1, y2-y1));
+            Mat cdst(*corr, Rect(x, y, bsz.width, bsz.height));
+
+            for( int k = 0; k < cn; k++ )
+            {
+                Mat src = src0;
+                dftImg = Scalar::all(0);
+
+                if( cn > 1 )
+                {
+                    src = depth == maxDepth ? dst1 : Mat(y2-y1, x2-x1, depth, &buf[0]);
+                    int pairs[] = {k, 0};
+                    mixChannels(&src0, 1, &src, 1, pairs, 1);
+                }
+
+                if( dst1.data != src.data )
+                    src.convertTo(dst1, dst1.depth());
+
+                if( x2 - x1 < dsz.width || y2 - y1 < dsz.height )
+                    copyMakeBorder(dst1, dst, y1-y0, dst.rows-dst1.rows-(y1-y0),
+                                   x1-x0, dst.cols-dst1.cols-(x1-x0), borderType);
+
+                dft( dftImg, dftImg, 0, dsz.height );
+                Mat dftTempl1(plan->dftTempl, Rect(0, tcn > 1 ? k*dftsize.height : 0,
+                                                   dftsize.width, dftsize.height));
+                mulSpectrums(dftImg, dftTempl1, dftImg, 0, true);
+                dft( dftImg, dftImg, DFT_INVERSE + DFT_SCALE, bsz.height );
+
+                src = dftImg(Rect(0, 0, bsz.width, bsz.height));
+
+                if( ccn > 1 )
+                {
+                    if( cdepth != maxDepth )
+                    {
+                        Mat plane(bsz, cdepth, &buf[0]);
+                        src.convertTo(plane, cdepth, 1, delta);
+                        src = plane;
+                    }
+                    int pairs[] = {0, k};
+                    mixChannels(&src, 1, &cdst, 1, pairs, 1);
+                }
+                else
+                {
+                    if( k == 0 )
+                        src.convertTo(cdst, cdepth, 1, delta);
+                    else
+                    {
+                        if( maxDepth != cdepth )
+                        {
+                            Mat plane(bsz, cdepth, &buf[0]);
+                            src.convertTo(plane, cdepth);
+                            src = plane;
+                        }
+                        add(src, cdst, cdst);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const CrossCorrPlan* plan;
+    const Mat* img0;
+    Point roiofs;
+    Mat* corr;
+    Point anchor;
+    double delta;
+    int borderType;
+};
+
+
+void CrossCorrPlan::apply( const Mat& img, Mat& corr, Point anchor, double delta, int borderType ) const
+{
+    CV_Assert( img.dims <= 2 && img.depth() == depth && img.channels() == cn );
+    CV_Assert( corrsize.height <= img.rows + templ.rows - 1 &&
+               corrsize.width <= img.cols + templ.cols - 1 );
+    CV_Assert( CV_MAT_CN(ctype) == 1 || delta == 0 );
+
+    corr.create(corrsize, ctype);
+    CV_Assert( corr.dims <= 2 );
 
     int tileCountX = (corr.cols + blocksize.width - 1)/blocksize.width;
     int tileCountY = (corr.rows + blocksize.height - 1)/blocksize.height;
@@ -152,169 +261,290 @@ void crossCorr( const Mat& img, const Mat& _templ, Mat& corr,
     }
     borderType |= BORDER_ISOLATED;
 
-    // calculate correlation by blocks
-    for( i = 0; i < tileCount; i++ )
+    // calculate correlation by blocks; the tiles write disjoint parts of corr
+    parallel_for_( Range(0, tileCount),
+                   CrossCorrInvoker(*this, img0, roiofs, corr, anchor, delta, borderType) );
+}
+
+void crossCorr( const Mat& img, const Mat& templ, Mat& corr,
+                Size corrsize, int ctype,
+                Point anchor, double delta, int borderType )
+{
+    CrossCorrPlan plan;
+    plan.create( templ, img.type(), corrsize, ctype );
+    plan.apply( img, corr, anchor, delta, borderType );
+}
+
+
+/*
+   Direct correlation for small templates. Channels stay interleaved: a template row is
+   a flat run of templ.cols*cn taps and the output x reads the image from offset x*cn,
+   so the channel sum comes for free. 8-bit images are correlated exactly in 32-bit
+   integers, two taps per _mm_madd_epi16; float images sum every template row in float
+   and the rows in double. Eight outputs stay in registers while all taps are applied.
+*/
+
+static void directCorrRow_8u( const uchar** srows, const Mat& templ, const int* coeffs,
+                              int tcols, int n, int* acc, bool useSIMD )
+{
+    int trows = templ.rows, npairs = (tcols + 1)/2, x = 0;
+
+#if CV_SSE2
+    if( useSIMD )
     {
-        int x = (i%tileCountX)*blocksize.width;
-        int y = (i/tileCountX)*blocksize.height;
-
-        Size bsz(std::min(blocksize.width, corr.cols - x),
-                 std::min(blocksize.height, corr.rows - y));
-        Size dsz(bsz.width + templ.cols - 1, bsz.height + templ.rows - 1);
-        int x0 = x - anchor.x + roiofs.x, y0 = y - anchor.y + roiofs.y;
-        int x1 = std::max(0, x0), y1 = std::max(0, y0);
-        int x2 = std::min(img0.cols, x0 + dsz.width);
-        int y2 = std::min(img0.rows, y0 + dsz.height);
-        Mat src0(img0, Range(y1, y2), Range(x1, x2));
-        Mat dst(dftImg, Rect(0, 0, dsz.width, dsz.height));
-        Mat dst1(dftImg, Rect(x1-x0, y1-y0, x2-x1, y2-y1));
-        Mat cdst(corr, Rect(x, y, bsz.width, bsz.height));
-
-        for( k = 0; k < cn; k++ )
+        __m128i z = _mm_setzero_si128();
+        for( ; x <= n - 8; x += 8 )
         {
-            Mat src = src0;
-            dftImg = Scalar::all(0);
-
-            if( cn > 1 )
+            __m128i s0 = z, s1 = z;
+            for( int i = 0; i < trows; i++ )
             {
-                src = depth == maxDepth ? dst1 : Mat(y2-y1, x2-x1, depth, &buf[0]);
-                int pairs[] = {k, 0};
-                mixChannels(&src0, 1, &src, 1, pairs, 1);
-            }
+                const uchar* s = srows[i] + x;
+                const int* c = coeffs + i*npairs;
+                int j = 0;
 
-            if( dst1.data != src.data )
-                src.convertTo(dst1, dst1.depth());
+                for( ; j < tcols - 1; j += 2 )
+                {
+                    __m128i k = _mm_set1_epi32(c[j >> 1]);
+                    __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + j)), z);
+                    __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + j + 1)), z);
+                    s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), k));
+                    s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), k));
+                }
 
-            if( x2 - x1 < dsz.width || y2 - y1 < dsz.height )
-                copyMakeBorder(dst1, dst, y1-y0, dst.rows-dst1.rows-(y1-y0),
-                               x1-x0, dst.cols-dst1.cols-(x1-x0), borderType);
+                if( j < tcols )
+                {
+                    __m128i k = _mm_set1_epi32(c[j >> 1]);
+                    __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + j)), z);
+                    s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi16(a, z), k));
+                    s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi16(a, z), k));
+                }
+            }
+            _mm_storeu_si128((__m128i*)(acc + x), s0);
+            _mm_storeu_si128((__m128i*)(acc + x + 4), s1);
+        }
+    }
+#endif
 
-            dft( dftImg, dftImg, 0, dsz.height );
-            Mat dftTempl1(dftTempl, Rect(0, tcn > 1 ? k*dftsize.height : 0,
-                                         dftsize.width, dftsize.height));
-            mulSpectrums(dftImg, dftTempl1, dftImg, 0, true);
-            dft( dftImg, dftImg, DFT_INVERSE + DFT_SCALE, bsz.height );
+    for( ; x < n; x++ )
+    {
+        int s = 0;
+        for( int i = 0; i < trows; i++ )
+        {
+            const uchar* sr = srows[i] + x;
+            const uchar* t = templ.ptr(i);
+            for( int j = 0; j < tcols; j++ )
+                s += sr[j]*t[j];
+        }
+        acc[x] = s;
+    }
+}
 
-            src = dftImg(Rect(0, 0, bsz.width, bsz.height));
+static void directCorrRow_32f( const float** srows, const Mat& templ,
+                               int tcols, int n, float* acc, bool useSIMD )
+{
+    int trows = templ.rows, x = 0;
 
-            if( ccn > 1 )
+#if CV_SSE2
+    if( useSIMD )
+    {
+        for( ; x <= n - 8; x += 8 )
+        {
+            __m128d d0 = _mm_setzero_pd(), d1 = d0, d2 = d0, d3 = d0;
+            for( int i = 0; i < trows; i++ )
             {
-                if( cdepth != maxDepth )
+                const float* s = srows[i] + x;
+                const float* t = templ.ptr<float>(i);
+
+                for( int j = 0; j < tcols; j++ )
                 {
-                    Mat plane(bsz, cdepth, &buf[0]);
-                    src.convertTo(plane, cdepth, 1, delta);
-                    src = plane;
+                    __m128d k = _mm_set1_pd((double)t[j]);
+                    __m128 s0 = _mm_loadu_ps(s + j), s1 = _mm_loadu_ps(s + j + 4);
+                    d0 = _mm_add_pd(d0, _mm_mul_pd(k, _mm_cvtps_pd(s0)));
+                    d1 = _mm_add_pd(d1, _mm_mul_pd(k, _mm_cvtps_pd(_mm_movehl_ps(s0, s0))));
+                    d2 = _mm_add_pd(d2, _mm_mul_pd(k, _mm_cvtps_pd(s1)));
+                    d3 = _mm_add_pd(d3, _mm_mul_pd(k, _mm_cvtps_pd(_mm_movehl_ps(s1, s1))));
                 }
-                int pairs[] = {0, k};
-                mixChannels(&src, 1, &cdst, 1, pairs, 1);
             }
+            _mm_storeu_ps(acc + x, _mm_movelh_ps(_mm_cvtpd_ps(d0), _mm_cvtpd_ps(d1)));
+            _mm_storeu_ps(acc + x + 4, _mm_movelh_ps(_mm_cvtpd_ps(d2), _mm_cvtpd_ps(d3)));
+        }
+    }
+#endif
+
+    for( ; x < n; x++ )
+    {
+        double s = 0;
+        for( int i = 0; i < trows; i++ )
+        {
+            const float* sr = srows[i] + x;
+            const float* t = templ.ptr<float>(i);
+            for( int j = 0; j < tcols; j++ )
+                s += (double)t[j]*sr[j];
+        }
+        acc[x] = (float)s;
+    }
+}
+
+class MatchTemplateDirectInvoker : public ParallelLoopBody
+{
+public:
+    MatchTemplateDirectInvoker( const Mat& _img, const Mat& _templ, Mat& _result )
+        : img(&_img), templ(&_templ), result(&_result) {}
+
+    void operator()( const Range& range ) const
+    {
+        int cn = img->channels(), tcols = templ->cols*cn, trows = templ->rows;
+        int n = (result->cols - 1)*cn + 1, npairs = (tcols + 1)/2;
+        bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+        AutoBuffer<const uchar*> _srows(trows);
+        AutoBuffer<int> _acc(n), _coeffs(trows*npairs);
+        const uchar** srows = _srows;
+        int* acc = _acc;
+        int* coeffs = _coeffs;
+
+        if( img->depth() == CV_8U )
+            for( int i = 0; i < trows; i++ )
+            {
+                const uchar* t = templ->ptr(i);
+                for( int j = 0; j < tcols; j += 2 )
+                    coeffs[i*npairs + (j >> 1)] = t[j] | (j + 1 < tcols ? t[j + 1] << 16 : 0);
+            }
+
+        for( int y = range.start; y < range.end; y++ )
+        {
+            float* dst = (float*)result->ptr(y);
+
+            for( int i = 0; i < trows; i++ )
+                srows[i] = img->ptr(y + i);
+
+            if( img->depth() == CV_8U )
+            {
+                directCorrRow_8u( srows, *templ, coeffs, tcols, n, acc, useSIMD );
+                for( int x = 0; x < result->cols; x++ )
+                    dst[x] = (float)acc[x*cn];
+            }
+            else if( cn == 1 )
+                directCorrRow_32f( (const float**)srows, *templ, tcols, n, dst, useSIMD );
             else
             {
-                if( k == 0 )
-                    src.convertTo(cdst, cdepth, 1, delta);
-                else
-                {
-                    if( maxDepth != cdepth )
-                    {
-                        Mat plane(bsz, cdepth, &buf[0]);
-                        src.convertTo(plane, cdepth);
-                        src = plane;
-                    }
-                    add(src, cdst, cdst);
-                }
+                float* facc = (float*)acc;
+                directCorrRow_32f( (const float**)srows, *templ, tcols, n, facc, useSIMD );
+                for( int x = 0; x < result->cols; x++ )
+                    dst[x] = facc[x*cn];
             }
         }
     }
-}
 
-}
+private:
+    const Mat* img;
+    const Mat* templ;
+    Mat* result;
+};
+
+// picks the direct correlation when it is cheaper than the DFT-based one. Both costs are
+// in multiply-adds: the direct path computes all cn interleaved positions of every output
+// with templ.area()*cn taps plus a fixed per-position overhead, and the DFT path costs
+// about the same per image element for any template size
+static bool useDirectMatch( Size imgSize, Size templSize, int type )
+{
+    const double dftCostPerElem = 150, directOverhead = 12;
 
-/*****************************************************************************************/
+    if( templSize.width > 16 || templSize.height > 16 )
+        return false;
 
-void cv::matchTemplate( InputArray _img, InputArray _templ, OutputArray _result, int method )
+    int cn = CV_MAT_CN(type);
+    double corrArea = (double)(imgSize.width - templSize.width + 1)*(imgSize.height - templSize.height + 1);
+    double directCost = corrArea*cn*((double)templSize.area()*cn + directOverhead);
+    double dftCost = dftCostPerElem*imgSize.area()*cn;
+
+    return directCost <= dftCost;
+}
+
+static void matchTemplateDirect( const Mat& img, const Mat& templ, Mat& result )
 {
-    CV_Assert( CV_TM_SQDIFF <= method && method <= CV_TM_CCOEFF_NORMED );
+    parallel_for_( Range(0, result.rows), MatchTemplateDirectInvoker(img, templ, result) );
+}
 
+// template statistics used to normalize the correlation; returns false when the
+// template is flat and the normalized coefficient is 1 everywhere
+static bool templateMatchStats( const Mat& templ, int method, Scalar& templMean,
+                                double& templNorm, double& templSum2 )
+{
     int numType = method == CV_TM_CCORR || method == CV_TM_CCORR_NORMED ? 0 :
                   method == CV_TM_CCOEFF || method == CV_TM_CCOEFF_NORMED ? 1 : 2;
-    bool isNormed = method == CV_TM_CCORR_NORMED ||
-                    method == CV_TM_SQDIFF_NORMED ||
-                    method == CV_TM_CCOEFF_NORMED;
+    double invArea = 1./((double)templ.rows * templ.cols);
+    Scalar templSdv;
 
-    Mat img = _img.getMat(), templ = _templ.getMat();
-    if( img.rows < templ.rows || img.cols < templ.cols )
-        std::swap(img, templ);
+    templMean = Scalar::all(0);
+    templNorm = templSum2 = 0;
 
-    CV_Assert( (img.depth() == CV_8U || img.depth() == CV_32F) &&
-               img.type() == templ.type() );
+    if( method == CV_TM_CCORR )
+        return true;
 
-    CV_Assert( img.rows >= templ.rows && img.cols >= templ.cols);
+    if( method == CV_TM_CCOEFF )
+    {
+        templMean = mean(templ);
+        return true;
+    }
 
-    Size corrSize(img.cols - templ.cols + 1, img.rows - templ.rows + 1);
-    _result.create(corrSize, CV_32F);
-    Mat result = _result.getMat();
+    meanStdDev( templ, templMean, templSdv );
 
-#ifdef HAVE_TEGRA_OPTIMIZATION
-    if (tegra::matchTemplate(img, templ, result, method))
-        return;
-#endif
+    templNorm = CV_SQR(templSdv[0]) + CV_SQR(templSdv[1]) +
+                CV_SQR(templSdv[2]) + CV_SQR(templSdv[3]);
 
-    int cn = img.channels();
-    crossCorr( img, templ, result, result.size(), result.type(), Point(0,0), 0, 0);
+    if( templNorm < DBL_EPSILON && method == CV_TM_CCOEFF_NORMED )
+        return false;
 
+    templSum2 = templNorm +
+                 CV_SQR(templMean[0]) + CV_SQR(templMean[1]) +
+                 CV_SQR(templMean[2]) + CV_SQR(templMean[3]);
+
+    if( numType != 1 )
+    {
+        templMean = Scalar::all(0);
+        templNorm = templSum2;
+    }
+
+    templSum2 /= invArea;
+    templNorm = sqrt(templNorm);
+    templNorm /= sqrt(invArea); // care of accuracy here
+    return true;
+}
+
+// turns the raw cross-correlation in result into the score of the given method
+static void normalizeMatchResult( const Mat& img, Size templSize, Mat& result, int method,
+                                  const Scalar& templMean, double templNorm, double templSum2 )
+{
     if( method == CV_TM_CCORR )
         return;
 
-    double invArea = 1./((double)templ.rows * templ.cols);
+    int numType = method == CV_TM_CCORR || method == CV_TM_CCORR_NORMED ? 0 :
+                  method == CV_TM_CCOEFF || method == CV_TM_CCOEFF_NORMED ? 1 : 2;
+    bool isNormed = method == CV_TM_CCORR_NORMED ||
+                    method == CV_TM_SQDIFF_NORMED ||
+                    method == CV_TM_CCOEFF_NORMED;
+    int cn = img.channels();
+    double invArea = 1./((double)templSize.height * templSize.width);
 
     Mat sum, sqsum;
-    Scalar templMean, templSdv;
     double *q0 = 0, *q1 = 0, *q2 = 0, *q3 = 0;
-    double templNorm = 0, templSum2 = 0;
 
     if( method == CV_TM_CCOEFF )
-    {
         integral(img, sum, CV_64F);
-        templMean = mean(templ);
-    }
     else
     {
         integral(img, sum, sqsum, CV_64F);
-        meanStdDev( templ, templMean, templSdv );
-
-        templNorm = CV_SQR(templSdv[0]) + CV_SQR(templSdv[1]) +
-                    CV_SQR(templSdv[2]) + CV_SQR(templSdv[3]);
-
-        if( templNorm < DBL_EPSILON && method == CV_TM_CCOEFF_NORMED )
-        {
-            result = Scalar::all(1);
-            return;
-        }
-
-        templSum2 = templNorm +
-                     CV_SQR(templMean[0]) + CV_SQR(templMean[1]) +
-                     CV_SQR(templMean[2]) + CV_SQR(templMean[3]);
-
-        if( numType != 1 )
-        {
-            templMean = Scalar::all(0);
-            templNorm = templSum2;
-        }
-
-        templSum2 /= invArea;
-        templNorm = sqrt(templNorm);
-        templNorm /= sqrt(invArea); // care of accuracy here
 
         q0 = (double*)sqsum.data;
-        q1 = q0 + templ.cols*cn;
-        q2 = (double*)(sqsum.data + templ.rows*sqsum.step);
-        q3 = q2 + templ.cols*cn;
+        q1 = q0 + templSize.width*cn;
+        q2 = (double*)(sqsum.data + templSize.height*sqsum.step);
+        q3 = q2 + templSize.width*cn;
     }
 
     double* p0 = (double*)sum.data;
-    double* p1 = p0 + templ.cols*cn;
-    double* p2 = (double*)(sum.data + templ.rows*sum.step);
-    double* p3 = p2 + templ.cols*cn;
+    double* p1 = p0 + templSize.width*cn;
+    double* p2 = (double*)(sum.data + templSize.height*sum.step);
+    double* p3 = p2 + templSize.width*cn;
 
     int sumstep = sum.data ? (int)(sum.step / sizeof(double)) : 0;
     int sqstep = sqsum.data ? (int)(sqsum.step / sizeof(double)) : 0;
@@ -376,6 +606,190 @@ void cv::matchTemplate( InputArray _img, InputArray _templ, OutputArray _result,
 }
 
 
+class TemplateMatcher_Impl : public TemplateMatcher
+{
+public:
+    TemplateMatcher_Impl( const Mat& templ = Mat(), int method = TM_CCOEFF_NORMED, Size imageSize = Size() );
+
+    AlgorithmInfo* info() const;
+
+    void match( InputArray image, OutputArray result );
+
+    void setTemplate( InputArray templ );
+    Mat getTemplate() const;
+
+    void setMethod( int method );
+    int getMethod() const;
+
+    void setImageSize( Size imageSize );
+    Size getImageSize() const;
+
+    void collectGarbage();
+
+private:
+    void prepare( int imgType );
+
+    Mat templ_;
+    int method_;
+    Size imageSize_;
+
+    // state derived from the template for images of imageSize_ and preparedType_
+    CrossCorrPlan plan_;
+    int preparedType_;
+    bool flat_, direct_;
+    Scalar templMean_;
+    double templNorm_, templSum2_;
+};
+
+TemplateMatcher_Impl::TemplateMatcher_Impl( const Mat& templ, int method, Size imageSize ) :
+    templ_(templ), method_(method), imageSize_(imageSize), preparedType_(-1),
+    flat_(false), direct_(false), templNorm_(0), templSum2_(0)
+{
+    CV_Assert( CV_TM_SQDIFF <= method && method <= CV_TM_CCOEFF_NORMED );
+}
+
+// the setter resets the prepared state, so "method" must not be written to method_ directly
+CV_INIT_ALGORITHM(TemplateMatcher_Impl, "TemplateMatcher",
+    obj.info()->addParam(obj, "method", obj.method_, false,
+                         (int (Algorithm::*)())&TemplateMatcher_Impl::getMethod,
+                         (void (Algorithm::*)(int))&TemplateMatcher_Impl::setMethod))
+
+void TemplateMatcher_Impl::prepare( int imgType )
+{
+    CV_Assert( (CV_MAT_DEPTH(imgType) == CV_8U || CV_MAT_DEPTH(imgType) == CV_32F) &&
+               imgType == templ_.type() );
+    CV_Assert( imageSize_.width >= templ_.cols && imageSize_.height >= templ_.rows );
+
+    Size corrSize(imageSize_.width - templ_.cols + 1, imageSize_.height - templ_.rows + 1);
+
+    flat_ = !templateMatchStats( templ_, method_, templMean_, templNorm_, templSum2_ );
+    direct_ = useDirectMatch( imageSize_, templ_.size(), imgType );
+    if( flat_ || direct_ )
+        plan_ = CrossCorrPlan();
+    else
+        plan_.create( templ_, imgType, corrSize, CV_32F );
+    preparedType_ = imgType;
+}
+
+void TemplateMatcher_Impl::match( InputArray _img, OutputArray _result )
+{
+    Mat img = _img.getMat();
+
+    CV_Assert( !templ_.empty() && img.dims <= 2 );
+
+    if( img.size() != imageSize_ )
+    {
+        imageSize_ = img.size();
+        preparedType_ = -1;
+    }
+    if( img.type() != preparedType_ )
+        prepare( img.type() );
+
+    _result.create(imageSize_.height - templ_.rows + 1, imageSize_.width - templ_.cols + 1, CV_32F);
+    Mat result = _result.getMat();
+
+    if( flat_ )
+    {
+        result = Scalar::all(1);
+        return;
+    }
+
+    if( direct_ )
+        matchTemplateDirect( img, templ_, result );
+    else
+        plan_.apply( img, result, Point(0,0), 0, 0 );
+    normalizeMatchResult( img, templ_.size(), result, method_, templMean_, templNorm_, templSum2_ );
+}
+
+void TemplateMatcher_Impl::setTemplate( InputArray templ )
+{
+    templ_ = templ.getMat().clone();
+    preparedType_ = -1;
+}
+
+Mat TemplateMatcher_Impl::getTemplate() const
+{
+    // a shared header would let the caller change the template behind the cached spectra
+    return templ_.clone();
+}
+
+void TemplateMatcher_Impl::setMethod( int method )
+{
+    CV_Assert( CV_TM_SQDIFF <= method && method <= CV_TM_CCOEFF_NORMED );
+    method_ = method;
+    preparedType_ = -1;
+}
+
+int TemplateMatcher_Impl::getMethod() const
+{
+    return method_;
+}
+
+void TemplateMatcher_Impl::setImageSize( Size imageSize )
+{
+    imageSize_ = imageSize;
+    preparedType_ = -1;
+}
+
+Size TemplateMatcher_Impl::getImageSize() const
+{
+    return imageSize_;
+}
+
+void TemplateMatcher_Impl::collectGarbage()
+{
+    plan_ = CrossCorrPlan();
+    preparedType_ = -1;
+}
+
+}
+
+cv::Ptr<cv::TemplateMatcher> cv::createTemplateMatcher( InputArray templ, int method, Size imageSize )
+{
+    return new TemplateMatcher_Impl( templ.getMat().clone(), method, imageSize );
+}
+
+/*****************************************************************************************/
+
+void cv::matchTemplate( InputArray _img, InputArray _templ, OutputArray _result, int method )
+{
+    CV_Assert( CV_TM_SQDIFF <= method && method <= CV_TM_CCOEFF_NORMED );
+
+    Mat img = _img.getMat(), templ = _templ.getMat();
+    if( img.rows < templ.rows || img.cols < templ.cols )
+        std::swap(img, templ);
+
+    CV_Assert( (img.depth() == CV_8U || img.depth() == CV_32F) &&
+               img.type() == templ.type() );
+
+    CV_Assert( img.rows >= templ.rows && img.cols >= templ.cols);
+
+    Size corrSize(img.cols - templ.cols + 1, img.rows - templ.rows + 1);
+    _result.create(corrSize, CV_32F);
+    Mat result = _result.getMat();
+
+#ifdef HAVE_TEGRA_OPTIMIZATION
+    if (tegra::matchTemplate(img, templ, result, method))
+        return;
+#endif
+
+    Scalar templMean;
+    double templNorm = 0, templSum2 = 0;
+
+    if( !templateMatchStats( templ, method, templMean, templNorm, templSum2 ) )
+    {
+        result = Scalar::all(1);
+        return;
+    }
+
+    if( useDirectMatch( img.size(), templ.size(), img.type() ) )
+        matchTemplateDirect( img, templ, result );
+    else
+        crossCorr( img, templ, result, result.size(), result.type(), Point(0,0), 0, 0);
+    normalizeMatchResult( img, templ.size(), result, method, templMean, templNorm, templSum2 );
+}
+
+
 CV_IMPL void
 cvMatchTemplate( const CvArr* _img, const CvArr* _templ, CvArr* _result, int method )
 {
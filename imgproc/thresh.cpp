@@ -706,6 +706,100 @@ private:
     int thresholdType;
 };
 
+static void
+adaptiveThresholdRow( const uchar* src, const uchar* mean, uchar* dst, int width,
+                      const uchar* tab, uchar maxval, int idelta, int type )
+{
+    int j = 0;
+
+#if CV_SSE2
+    if( checkHardwareSupport(CV_CPU_SSE2) )
+    {
+        // src - mean lies in [-255, 255], so the clamped threshold gives the same comparison
+        __m128i z = _mm_setzero_si128();
+        __m128i thresh_ = _mm_set1_epi16((short)std::min(std::max(-idelta, -256), 256));
+        __m128i maxval_ = _mm_set1_epi8(maxval);
+        __m128i inv = type == THRESH_BINARY_INV ? _mm_set1_epi8(-1) : z;
+
+        for( ; j <= width - 16; j += 16 )
+        {
+            __m128i s = _mm_loadu_si128( (const __m128i*)(src + j) );
+            __m128i m = _mm_loadu_si128( (const __m128i*)(mean + j) );
+            __m128i d0 = _mm_sub_epi16( _mm_unpacklo_epi8(s, z), _mm_unpacklo_epi8(m, z) );
+            __m128i d1 = _mm_sub_epi16( _mm_unpackhi_epi8(s, z), _mm_unpackhi_epi8(m, z) );
+            d0 = _mm_packs_epi16( _mm_cmpgt_epi16(d0, thresh_), _mm_cmpgt_epi16(d1, thresh_) );
+            d0 = _mm_and_si128( _mm_xor_si128(d0, inv), maxval_ );
+            _mm_storeu_si128( (__m128i*)(dst + j), d0 );
+        }
+    }
+#else
+    (void)maxval; (void)idelta; (void)type;
+#endif
+
+    for( ; j < width; j++ )
+        dst[j] = tab[src[j] - mean[j] + 255];
+}
+
+// Computes the local mean of a stripe of rows with a streaming filter engine and thresholds
+// every chunk of mean rows while the corresponding source rows are still in cache, so the
+// full-size mean image is never materialized.
+class AdaptiveThresholdInvoker : public ParallelLoopBody
+{
+public:
+    enum { CHUNK_ROWS = 32 };
+
+    AdaptiveThresholdInvoker( const Mat& _src, Mat& _dst, int _method, int _blockSize,
+                              const uchar* _tab, uchar _maxval, int _idelta, int _type, int _nStripes )
+        : ParallelLoopBody(), src(&_src), dst(&_dst), method(_method), blockSize(_blockSize),
+          tab(_tab), maxval(_maxval), idelta(_idelta), type(_type), nStripes(_nStripes)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int row0 = src->rows*range.start/nStripes, row1 = src->rows*range.end/nStripes;
+        if( row0 >= row1 )
+            return;
+
+        Size ksize(blockSize, blockSize);
+        Ptr<FilterEngine> f = method == ADAPTIVE_THRESH_MEAN_C ?
+            createBoxFilter( CV_8UC1, CV_8UC1, ksize, Point(-1,-1), true, BORDER_REPLICATE ) :
+            createGaussianFilter( CV_8UC1, ksize, 0, 0, BORDER_REPLICATE );
+
+        int width = src->cols;
+        int y = f->start( *src, Rect(0, row0, width, row1 - row0) );
+        const uchar* sptr = src->data + (ptrdiff_t)y*src->step;
+        int remaining = f->remainingInputRows();
+
+        size_t mstep = alignSize(width, 16);
+        AutoBuffer<uchar> _mean(mstep*(CHUNK_ROWS + blockSize));
+        uchar* mean = _mean;
+
+        for( y = row0; remaining > 0; )
+        {
+            int count = std::min(remaining, (int)CHUNK_ROWS);
+            int n = f->proceed( sptr, (int)src->step, count, mean, (int)mstep );
+            sptr += count*src->step;
+            remaining -= count;
+
+            for( int i = 0; i < n; i++, y++ )
+                adaptiveThresholdRow( src->data + src->step*y, mean + mstep*i,
+                                      dst->data + dst->step*y, width, tab, maxval, idelta, type );
+        }
+    }
+
+private:
+    const Mat* src;
+    Mat* dst;
+    int method;
+    int blockSize;
+    const uchar* tab;
+    uchar maxval;
+    int idelta;
+    int type;
+    int nStripes;
+};
+
 }
 
 double cv::threshold( InputArray _src, OutputArray _dst, double thresh, double maxval, int type )
@@ -806,20 +900,10 @@ void cv::adaptiveThreshold( InputArray _src, OutputArray _dst, double maxValue,
         return;
     }
 
-    Mat mean;
-
-    if( src.data != dst.data )
-        mean = dst;
-
-    if( method == ADAPTIVE_THRESH_MEAN_C )
-        boxFilter( src, mean, src.type(), Size(blockSize, blockSize),
-                   Point(-1,-1), true, BORDER_REPLICATE );
-    else if( method == ADAPTIVE_THRESH_GAUSSIAN_C )
-        GaussianBlur( src, mean, Size(blockSize, blockSize), 0, 0, BORDER_REPLICATE );
-    else
+    if( method != ADAPTIVE_THRESH_MEAN_C && method != ADAPTIVE_THRESH_GAUSSIAN_C )
         CV_Error( CV_StsBadFlag, "Unknown/unsupported adaptive threshold method" );
 
-    int i, j;
+    int i;
     uchar imaxval = saturate_cast<uchar>(maxValue);
     int idelta = type == THRESH_BINARY ? cvCeil(delta) : cvFloor(delta);
     uchar tab[768];
@@ -833,21 +917,15 @@ void cv::adaptiveThreshold( InputArray _src, OutputArray _dst, double maxValue,
     else
         CV_Error( CV_StsBadFlag, "Unknown/unsupported threshold type" );
 
-    if( src.isContinuous() && mean.isContinuous() && dst.isContinuous() )
-    {
-        size.width *= size.height;
-        size.height = 1;
-    }
+    // every stripe re-filters blockSize-1 rows around its boundaries; in-place processing
+    // relies on the rows being consumed before they are overwritten, i.e. sequentially
+    int nStripes = 1, nthreads = getNumThreads();
+    if( nthreads > 1 && !(dst.datastart < src.dataend && src.datastart < dst.dataend) )
+        nStripes = std::max(std::min(std::min(nthreads*2, (int)(src.total() >> 15)),
+                                     src.rows/(blockSize*2)), 1);
 
-    for( i = 0; i < size.height; i++ )
-    {
-        const uchar* sdata = src.data + src.step*i;
-        const uchar* mdata = mean.data + mean.step*i;
-        uchar* ddata = dst.data + dst.step*i;
-
-        for( j = 0; j < size.width; j++ )
-            ddata[j] = tab[sdata[j] - mdata[j] + 255];
-    }
+    parallel_for_(Range(0, nStripes),
+                  AdaptiveThresholdInvoker(src, dst, method, blockSize, tab, imaxval, idelta, type, nStripes));
 }
 
 CV_IMPL double